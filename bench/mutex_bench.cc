@@ -0,0 +1,97 @@
+#include <benchmark/benchmark.h>
+#include <functional>
+#include <mutex>
+
+#include <utils/lock_profiler.h>
+#include <utils/mutex.h>
+
+using namespace ors;
+
+namespace {
+
+/**
+ * utils::mutex as it was before the policy template: a std::function tested
+ * on every lock and unlock, whether set or not.
+ */
+class legacy_mutex {
+public:
+  legacy_mutex() : mtx(), cb() {}
+
+  void lock() {
+    mtx.lock();
+    if (cb)
+      cb();
+  }
+
+  void unlock() {
+    if (cb)
+      cb();
+    mtx.unlock();
+  }
+
+private:
+  std::mutex mtx;
+
+public:
+  std::function<void()> cb;
+};
+
+using none_mutex = utils::basic_mutex<utils::mutex_policy::none>;
+using hook_mutex = utils::basic_mutex<utils::mutex_policy::test_hook>;
+using profiled_mutex = utils::basic_mutex<utils::mutex_policy::profiled>;
+using adaptive_none =
+    utils::basic_mutex<utils::mutex_policy::none, utils::adaptive_mutex>;
+
+/// Work done while holding the lock in the contended runs.
+constexpr int CRITICAL_SECTION = 20;
+
+template <typename lock_type> void uncontended(benchmark::State &state) {
+  lock_type m;
+  for (auto _ : state) {
+    m.lock();
+    m.unlock();
+  }
+}
+
+/// All threads share one mutex and do a short critical section under it.
+template <typename lock_type> void contended(benchmark::State &state) {
+  static lock_type m;
+  static uint64_t shared = 0;
+  for (auto _ : state) {
+    std::lock_guard<lock_type> lg(m);
+    for (int i = 0; i < CRITICAL_SECTION; ++i)
+      benchmark::DoNotOptimize(++shared);
+  }
+}
+
+void profiling_on(const benchmark::State &) {
+  utils::lock_profiler::enable(true);
+}
+
+void profiling_off(const benchmark::State &) {
+  utils::lock_profiler::enable(false);
+}
+
+} // namespace
+
+BENCHMARK_TEMPLATE(uncontended, std::mutex);
+BENCHMARK_TEMPLATE(uncontended, legacy_mutex);
+BENCHMARK_TEMPLATE(uncontended, none_mutex);
+BENCHMARK_TEMPLATE(uncontended, hook_mutex);
+BENCHMARK_TEMPLATE(uncontended, profiled_mutex);
+BENCHMARK_TEMPLATE(uncontended, profiled_mutex)
+    ->Name("uncontended<profiled_mutex>/profiling")
+    ->Setup(profiling_on)
+    ->Teardown(profiling_off);
+BENCHMARK_TEMPLATE(uncontended, utils::adaptive_mutex);
+BENCHMARK_TEMPLATE(uncontended, adaptive_none);
+
+BENCHMARK_TEMPLATE(contended, std::mutex)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(contended, legacy_mutex)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(contended, none_mutex)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(contended, profiled_mutex)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(contended, utils::adaptive_mutex)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
@@ -0,0 +1,44 @@
+#include <benchmark/benchmark.h>
+
+#include <sim/cluster.h>
+
+using namespace ors;
+
+namespace {
+
+const uint64_t SEC = 1000 * 1000 * 1000;
+
+/**
+ * Ten simulated seconds of closed-loop load on a fresh cluster. Wall time
+ * is the simulator's own cost; the counters are what the simulated cluster
+ * achieved, identical on every run with the same arguments.
+ */
+void cluster_workload(benchmark::State &state) {
+  sim::cluster_options opts;
+  opts.servers = size_t(state.range(0));
+  opts.net.drop_rate = double(state.range(2)) / 100;
+  opts.net.reorder_rate = opts.net.drop_rate;
+  sim::report r;
+  for (auto _ : state) {
+    sim::cluster c(opts);
+    c.wait_for_leader(10 * SEC);
+    r = c.run_workload(10 * SEC, size_t(state.range(1)), 128);
+    benchmark::DoNotOptimize(r.committed);
+  }
+  state.counters["commits_per_sim_sec"] = r.commits_per_sec;
+  state.counters["p50_us"] = double(r.p50_latency_nanos) / 1000;
+  state.counters["p99_us"] = double(r.p99_latency_nanos) / 1000;
+  state.counters["elections"] = double(r.elections);
+  state.counters["messages"] = double(r.messages_sent);
+}
+
+} // namespace
+
+BENCHMARK(cluster_workload)
+    ->ArgNames({"servers", "clients", "loss_pct"})
+    ->Args({3, 1, 0})
+    ->Args({3, 16, 0})
+    ->Args({5, 16, 0})
+    ->Args({5, 16, 5})
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(1);
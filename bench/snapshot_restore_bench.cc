@@ -0,0 +1,108 @@
+#include <benchmark/benchmark.h>
+#include <client.pb.h>
+#include <map>
+#include <set>
+#include <unistd.h>
+
+#include <state_machine/batch_applier.h>
+#include <storage/snapshot_file.h>
+#include <utils/common.h>
+
+using namespace ors;
+using write_request = proto::client::ReadWriteTree::Request::Write;
+
+namespace {
+
+/// Entries replayed from the log after loading the snapshot.
+constexpr uint64_t LOG_TAIL = 10000;
+
+std::string snapshot_path(uint64_t keys) {
+  return utils::string::fmt("/tmp/ors_restore_bench_%lu", keys);
+}
+
+/// Snapshot files written so far, removed when the benchmark exits.
+struct snapshots {
+  ~snapshots() {
+    for (auto &path : paths)
+      unlink(path.c_str());
+  }
+  std::set<std::string> paths;
+};
+
+/// Write a snapshot of `keys` files in path order, as the Tree dumps them.
+void make_snapshot(uint64_t keys) {
+  static snapshots made;
+  std::string path = snapshot_path(keys);
+  if (made.paths.count(path))
+    return;
+  // registered first, so a partly written file is removed too
+  made.paths.insert(path);
+  storage::snapshot_file::writer w(path);
+  write_request msg;
+  for (uint64_t i = 0; i < keys; ++i) {
+    msg.set_path(utils::string::fmt("/bench/%010lu", i));
+    msg.set_contents(utils::string::fmt("value-%026lu", i * 7919));
+    w.write_message(msg);
+  }
+  w.close();
+}
+
+/**
+ * Time-to-serve after a restart: load the snapshot (decoding runs of blocks
+ * on several threads and bulk-loading the sorted results), then replay the
+ * log tail through the batched applier.
+ */
+void restore(benchmark::State &state) {
+  uint64_t keys = uint64_t(state.range(0));
+  size_t threads = size_t(state.range(1));
+  make_snapshot(keys);
+  for (auto _ : state) {
+    std::map<std::string, std::string> tree;
+    {
+      storage::snapshot_file::reader r(snapshot_path(keys));
+      std::vector<std::vector<write_request>> parts(r.runs().size());
+      storage::snapshot_file::for_each_run(
+          r, threads, [&parts](size_t run, const std::string &raw) {
+            parts[run] = storage::snapshot_file::parse_messages<write_request>(
+                raw);
+          });
+      // runs hold disjoint, ascending key ranges: append at the end
+      for (auto &part : parts) {
+        for (auto &msg : part)
+          tree.emplace_hint(tree.end(), std::move(*msg.mutable_path()),
+                            std::move(*msg.mutable_contents()));
+        std::vector<write_request>().swap(part);
+      }
+    }
+
+    state_machine::batch_applier applier(
+        [&tree](const std::vector<state_machine::batch_applier::entry> &batch,
+                std::vector<std::string> &responses) {
+          for (auto &e : batch) {
+            tree[e.data] = "replayed";
+            responses.emplace_back();
+          }
+        });
+    applier.start();
+    for (uint64_t i = 1; i <= LOG_TAIL; ++i)
+      applier.commit(i, utils::string::fmt("/bench/%010lu", i * 13 % keys));
+    applier.wait_applied(LOG_TAIL);
+    applier.exit();
+    benchmark::DoNotOptimize(tree.size());
+  }
+  state.counters["keys"] = double(keys);
+  state.counters["keys_per_second"] = benchmark::Counter(
+      double(keys) * double(state.iterations()), benchmark::Counter::kIsRate);
+}
+
+} // namespace
+
+BENCHMARK(restore)
+    ->ArgNames({"keys", "threads"})
+    ->Args({1000000, 1})
+    ->Args({1000000, 0})
+    ->Args({10000000, 1})
+    ->Args({10000000, 0})
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(1)
+    ->UseRealTime();
@@ -0,0 +1,156 @@
+#include <benchmark/benchmark.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+#include <utils/thread_pool.h>
+
+using namespace ors;
+
+namespace {
+
+/**
+ * The baseline: every worker takes tasks from one mutex-protected queue,
+ * the way a pool is usually written first.
+ */
+class single_queue_pool {
+public:
+  explicit single_queue_pool(size_t threads)
+      : mtx(), work_available(), idle(), tasks(), outstanding(0),
+        exiting(false), workers() {
+    for (size_t i = 0; i < threads; ++i)
+      workers.emplace_back([this] { main(); });
+  }
+
+  ~single_queue_pool() {
+    {
+      std::lock_guard<std::mutex> lg(mtx);
+      exiting = true;
+    }
+    work_available.notify_all();
+    for (auto &w : workers)
+      w.join();
+  }
+
+  void submit(std::function<void()> fn) {
+    {
+      std::lock_guard<std::mutex> lg(mtx);
+      tasks.push_back(std::move(fn));
+      ++outstanding;
+    }
+    work_available.notify_one();
+  }
+
+  void wait_idle() {
+    std::unique_lock<std::mutex> ul(mtx);
+    while (outstanding != 0)
+      idle.wait(ul);
+  }
+
+private:
+  void main() {
+    std::unique_lock<std::mutex> ul(mtx);
+    for (;;) {
+      while (tasks.empty() && !exiting)
+        work_available.wait(ul);
+      if (tasks.empty())
+        return;
+      std::function<void()> fn = std::move(tasks.front());
+      tasks.pop_front();
+      ul.unlock();
+      fn();
+      ul.lock();
+      if (--outstanding == 0)
+        idle.notify_all();
+    }
+  }
+
+  std::mutex mtx;
+  std::condition_variable work_available;
+  std::condition_variable idle;
+  std::deque<std::function<void()>> tasks;
+  uint64_t outstanding;
+  bool exiting;
+  std::vector<std::thread> workers;
+};
+
+/// Size of each buffer checksummed by the fan-out benchmark.
+constexpr size_t BLOCK = 4096;
+
+/// Tasks per iteration of the fan-out benchmark.
+constexpr int BLOCKS = 256;
+
+/**
+ * Checksum BLOCKS independent 4KB blocks, all submitted from outside the
+ * pool, as when verifying the blocks of a snapshot.
+ */
+template <typename pool_type> void fan_out(benchmark::State &state) {
+  pool_type pool(size_t(state.range(0)));
+  std::vector<std::vector<uint8_t>> blocks(BLOCKS,
+                                           std::vector<uint8_t>(BLOCK));
+  for (size_t i = 0; i < blocks.size(); ++i)
+    for (size_t j = 0; j < BLOCK; ++j)
+      blocks[i][j] = uint8_t(i * 31 + j);
+  std::vector<uLong> sums(BLOCKS);
+  for (auto _ : state) {
+    for (int i = 0; i < BLOCKS; ++i) {
+      pool.submit([&blocks, &sums, i] {
+        sums[i] = crc32(0, blocks[i].data(), uInt(BLOCK));
+      });
+    }
+    pool.wait_idle();
+    benchmark::DoNotOptimize(sums.data());
+  }
+  state.SetItemsProcessed(state.iterations() * BLOCKS);
+  state.SetBytesProcessed(state.iterations() * BLOCKS * int64_t(BLOCK));
+}
+
+/**
+ * Binary divide and conquer: each task submits two children until depth
+ * 0, so nearly every task is submitted from a worker.
+ */
+template <typename pool_type>
+void spawn(pool_type &pool, int depth, std::atomic<uint64_t> &leaves) {
+  if (depth == 0) {
+    leaves.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  pool.submit([&pool, depth, &leaves] { spawn(pool, depth - 1, leaves); });
+  pool.submit([&pool, depth, &leaves] { spawn(pool, depth - 1, leaves); });
+}
+
+constexpr int DEPTH = 12;
+
+template <typename pool_type> void recursive(benchmark::State &state) {
+  pool_type pool(size_t(state.range(0)));
+  std::atomic<uint64_t> leaves(0);
+  for (auto _ : state) {
+    spawn(pool, DEPTH, leaves);
+    pool.wait_idle();
+  }
+  // 2^(DEPTH+1) - 1 tasks per iteration
+  state.SetItemsProcessed(state.iterations() * ((int64_t(2) << DEPTH) - 1));
+}
+
+} // namespace
+
+BENCHMARK_TEMPLATE(fan_out, single_queue_pool)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(fan_out, utils::thread_pool)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(recursive, single_queue_pool)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(recursive, utils::thread_pool)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime();
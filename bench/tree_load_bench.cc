@@ -0,0 +1,367 @@
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <client.pb.h>
+#include <cmath>
+#include <map>
+#include <sys/prctl.h>
+#include <thread>
+#include <vector>
+
+#include <state_machine/batch_applier.h>
+#include <tree/file.h>
+#include <utils/common.h>
+#include <utils/histogram.h>
+#include <utils/mutex.h>
+#include <utils/rand.h>
+#include <utils/time.h>
+
+using namespace ors;
+using read_request = proto::client::ReadOnlyTree::Request;
+using read_response = proto::client::ReadOnlyTree::Response;
+using write_request = proto::client::ReadWriteTree::Request;
+using write_response = proto::client::ReadWriteTree::Response;
+
+namespace {
+
+/// Files in the tree; every request targets one of them.
+constexpr uint64_t KEYS = 100000;
+
+/// Length of each measured run.
+constexpr int64_t RUN_NANOS = 1000 * 1000 * 1000;
+
+/// Client threads ("connections") the open-loop generator issues from.
+constexpr size_t OPEN_LOOP_CONNECTIONS = 64;
+
+/**
+ * The Tree as a server would run it, minus the network and Raft: writes are
+ * serialized ReadWriteTree requests appended to a log and applied through
+ * the batch_applier, reads are ReadOnlyTree queries served under the state
+ * machine lock.
+ */
+class tree_service {
+public:
+  tree_service()
+      : mtx("tree_service"), files(), conditions(), log_mtx("tree_log"),
+        next_index(1),
+        applier([this](const std::vector<state_machine::batch_applier::entry>
+                           &batch,
+                       std::vector<std::string> &responses) {
+          apply(batch, responses);
+        }) {
+    applier.start();
+  }
+
+  ~tree_service() { applier.exit(); }
+
+  write_response write(const write_request &req) {
+    std::string data = req.SerializeAsString();
+    uint64_t index;
+    {
+      std::lock_guard<utils::mutex> lg(log_mtx);
+      index = next_index++;
+      applier.commit(index, std::move(data));
+    }
+    write_response resp;
+    std::string raw;
+    if (!applier.wait_response(index, raw) || !resp.ParseFromString(raw))
+      resp.set_status(proto::client::TIMEOUT);
+    return resp;
+  }
+
+  read_response read(const read_request &req) {
+    read_response resp;
+    std::lock_guard<utils::mutex> lg(mtx);
+    if (req.has_condition() &&
+        !tree::check_condition(find(req.condition().path()),
+                               req.condition().contents(), conditions)) {
+      resp.set_status(proto::client::CONDITION_NOT_MET);
+      return resp;
+    }
+    const tree::file *f = find(req.read().path());
+    if (!f) {
+      resp.set_status(proto::client::LOOKUP_ERROR);
+      resp.set_error("no such file");
+      return resp;
+    }
+    resp.set_status(proto::client::OK);
+    resp.mutable_read()->set_contents(f->contents());
+    return resp;
+  }
+
+private:
+  const tree::file *find(const std::string &path) const {
+    auto it = files.find(path);
+    return it == files.end() ? nullptr : &it->second;
+  }
+
+  void apply(const std::vector<state_machine::batch_applier::entry> &batch,
+             std::vector<std::string> &responses) {
+    std::lock_guard<utils::mutex> lg(mtx);
+    write_request req;
+    write_response resp;
+    for (const auto &e : batch) {
+      resp.Clear();
+      if (!req.ParseFromString(e.data) || !req.has_write()) {
+        resp.set_status(proto::client::INVALID_ARGUMENT);
+      } else if (req.has_condition() &&
+                 !tree::check_condition(find(req.condition().path()),
+                                        req.condition().contents(),
+                                        conditions)) {
+        resp.set_status(proto::client::CONDITION_NOT_MET);
+      } else {
+        files[req.write().path()].write(req.write().contents());
+        resp.set_status(proto::client::OK);
+      }
+      responses.push_back(resp.SerializeAsString());
+    }
+  }
+
+  utils::mutex mtx;
+  std::map<std::string, tree::file> files;
+  tree::condition_stats conditions;
+
+  /// Orders index assignment with commit(), like appending to the log.
+  utils::mutex log_mtx;
+  uint64_t next_index;
+
+  state_machine::batch_applier applier;
+};
+
+/**
+ * Zipfian ranks in [0, n) as in YCSB (Gray et al., "Quickly Generating
+ * Billion-Record Synthetic Databases"): rank 0 is the most popular.
+ */
+class zipfian {
+public:
+  zipfian(uint64_t n, double theta)
+      : n(n), theta(theta), alpha(1 / (1 - theta)), zetan(zeta(n, theta)),
+        eta((1 - std::pow(2.0 / double(n), 1 - theta)) /
+            (1 - zeta(2, theta) / zetan)) {}
+
+  uint64_t operator()(utils::rand::xoshiro256 &rng) const {
+    double u = double(rng() >> 11) * 0x1.0p-53;
+    double uz = u * zetan;
+    if (uz < 1)
+      return 0;
+    if (uz < 1 + std::pow(0.5, theta))
+      return 1;
+    return std::min(n - 1, uint64_t(double(n) *
+                                    std::pow(eta * u - eta + 1, alpha)));
+  }
+
+private:
+  static double zeta(uint64_t n, double theta) {
+    double sum = 0;
+    for (uint64_t i = 1; i <= n; ++i)
+      sum += 1 / std::pow(double(i), theta);
+    return sum;
+  }
+
+  const uint64_t n;
+  const double theta;
+  const double alpha;
+  const double zetan;
+  const double eta;
+};
+
+enum distribution { UNIFORM = 0, ZIPFIAN = 1 };
+
+/// What to send: the request mix, key and value sizes, key distribution.
+struct workload {
+  int read_pct;
+  size_t key_bytes;
+  size_t value_bytes;
+  distribution keys;
+};
+
+std::string key(uint64_t rank, size_t bytes) {
+  std::string k = utils::string::fmt("/load/%010lu", rank);
+  if (k.size() < bytes)
+    k.resize(bytes, '_');
+  return k;
+}
+
+/// One client's request stream; each client thread owns one.
+class client {
+public:
+  client(tree_service &service, const workload &w, const zipfian &zipf,
+         uint64_t id)
+      : service(service), w(w), zipf(zipf), rng(id), id(id), rpc(0),
+        value(w.value_bytes, 'v') {}
+
+  /// Issue one request and wait for its response; false on an error status.
+  bool issue() {
+    uint64_t rank = w.keys == ZIPFIAN ? zipf(rng) : rng.bounded(KEYS);
+    if (int(rng.bounded(100)) < w.read_pct) {
+      read_request req;
+      req.mutable_read()->set_path(key(rank, w.key_bytes));
+      return service.read(req).status() == proto::client::OK;
+    }
+    write_request req;
+    auto *eo = req.mutable_exactly_once();
+    eo->set_client_id(id);
+    eo->set_rpc_number(++rpc);
+    eo->set_first_outstanding_rpc(rpc);
+    req.mutable_write()->set_path(key(rank, w.key_bytes));
+    req.mutable_write()->set_contents(value);
+    return service.write(req).status() == proto::client::OK;
+  }
+
+private:
+  tree_service &service;
+  const workload &w;
+  const zipfian &zipf;
+  utils::rand::xoshiro256 rng;
+  const uint64_t id;
+  uint64_t rpc;
+  const std::string value;
+};
+
+struct results {
+  results() : latency(), ok(0), errors(0) {}
+
+  utils::histogram latency;
+  std::atomic<uint64_t> ok;
+  std::atomic<uint64_t> errors;
+};
+
+void preload(tree_service &service, const workload &w) {
+  write_request req;
+  req.mutable_exactly_once()->set_client_id(1);
+  req.mutable_exactly_once()->set_first_outstanding_rpc(1);
+  req.mutable_exactly_once()->set_rpc_number(1);
+  req.mutable_write()->set_contents(std::string(w.value_bytes, 'p'));
+  for (uint64_t i = 0; i < KEYS; ++i) {
+    req.mutable_write()->set_path(key(i, w.key_bytes));
+    service.write(req);
+  }
+}
+
+/**
+ * Closed loop: each client keeps exactly one request outstanding, so the
+ * offered load adapts to the service; latency is send-to-response.
+ */
+void run_closed(tree_service &service, const workload &w, const zipfian &zipf,
+                size_t clients, results &out) {
+  int64_t end = utils::time::monotonic_nanos() + RUN_NANOS;
+  std::vector<std::thread> threads;
+  for (size_t c = 0; c < clients; ++c)
+    threads.emplace_back([&, c] {
+      client cl(service, w, zipf, c + 2);
+      for (;;) {
+        int64_t start = utils::time::monotonic_nanos();
+        if (start >= end)
+          break;
+        bool ok = cl.issue();
+        out.latency.record(uint64_t(utils::time::monotonic_nanos() - start));
+        ++(ok ? out.ok : out.errors);
+      }
+    });
+  for (auto &t : threads)
+    t.join();
+}
+
+/**
+ * Open loop: request i is due at start + i / rate whether or not earlier
+ * ones have finished. Latency runs from when a request was due, not from
+ * when a free connection got around to sending it, so a stall counts
+ * against every request it delays (no coordinated omission).
+ */
+void run_open(tree_service &service, const workload &w, const zipfian &zipf,
+              uint64_t rate, results &out) {
+  uint64_t total = uint64_t(double(rate) * RUN_NANOS / 1e9);
+  std::atomic<uint64_t> next(0);
+  int64_t start = utils::time::monotonic_nanos();
+  std::vector<std::thread> threads;
+  for (size_t c = 0; c < OPEN_LOOP_CONNECTIONS; ++c)
+    threads.emplace_back([&, c] {
+      // the default 50us timer slack would show up as latency
+      prctl(PR_SET_TIMERSLACK, 1UL);
+      client cl(service, w, zipf, c + 2);
+      for (;;) {
+        uint64_t i = next++;
+        if (i >= total)
+          break;
+        int64_t due = start + int64_t(double(i) * 1e9 / double(rate));
+        int64_t now = utils::time::monotonic_nanos();
+        if (due > now)
+          utils::time::sleep(std::chrono::nanoseconds(due - now));
+        bool ok = cl.issue();
+        out.latency.record(uint64_t(utils::time::monotonic_nanos() - due));
+        ++(ok ? out.ok : out.errors);
+      }
+    });
+  for (auto &t : threads)
+    t.join();
+}
+
+workload make_workload(const benchmark::State &state) {
+  return workload{int(state.range(1)), size_t(state.range(2)),
+                  size_t(state.range(3)), distribution(state.range(4))};
+}
+
+void report(benchmark::State &state, const results &r, int64_t nanos) {
+  state.counters["ops_per_sec"] = double(r.ok + r.errors) * 1e9 / double(nanos);
+  state.counters["errors"] = double(r.errors);
+  state.counters["p50_us"] = double(r.latency.quantile(0.5)) / 1000;
+  state.counters["p99_us"] = double(r.latency.quantile(0.99)) / 1000;
+  state.counters["p999_us"] = double(r.latency.quantile(0.999)) / 1000;
+  state.counters["max_us"] = double(r.latency.quantile(1)) / 1000;
+}
+
+/// Args: outstanding requests, read %, key bytes, value bytes, distribution.
+void closed_loop(benchmark::State &state) {
+  workload w = make_workload(state);
+  zipfian zipf(KEYS, 0.99);
+  tree_service service;
+  preload(service, w);
+  results r;
+  int64_t elapsed = 0;
+  for (auto _ : state) {
+    int64_t start = utils::time::monotonic_nanos();
+    run_closed(service, w, zipf, size_t(state.range(0)), r);
+    elapsed += utils::time::monotonic_nanos() - start;
+  }
+  report(state, r, elapsed);
+}
+
+/// Args: offered requests per second, read %, key bytes, value bytes,
+/// distribution. Compare ops_per_sec with the offered rate: when the
+/// service cannot keep up the run takes longer and latency climbs.
+void open_loop(benchmark::State &state) {
+  workload w = make_workload(state);
+  zipfian zipf(KEYS, 0.99);
+  tree_service service;
+  preload(service, w);
+  results r;
+  int64_t elapsed = 0;
+  for (auto _ : state) {
+    int64_t start = utils::time::monotonic_nanos();
+    run_open(service, w, zipf, uint64_t(state.range(0)), r);
+    elapsed += utils::time::monotonic_nanos() - start;
+  }
+  state.counters["offered_per_sec"] = double(state.range(0));
+  report(state, r, elapsed);
+}
+
+} // namespace
+
+BENCHMARK(closed_loop)
+    ->ArgNames({"outstanding", "read_pct", "key_bytes", "value_bytes", "zipf"})
+    ->Args({1, 95, 32, 128, UNIFORM})
+    ->Args({16, 95, 32, 128, UNIFORM})
+    ->Args({16, 95, 32, 128, ZIPFIAN})
+    ->Args({16, 50, 32, 128, UNIFORM})
+    ->Args({16, 50, 32, 4096, UNIFORM})
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(1)
+    ->UseRealTime();
+
+BENCHMARK(open_loop)
+    ->ArgNames({"rate", "read_pct", "key_bytes", "value_bytes", "zipf"})
+    ->Args({10000, 95, 32, 128, UNIFORM})
+    ->Args({10000, 50, 32, 128, ZIPFIAN})
+    ->Args({50000, 95, 32, 128, UNIFORM})
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(1)
+    ->UseRealTime();
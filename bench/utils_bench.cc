@@ -0,0 +1,306 @@
+#include <benchmark/benchmark.h>
+#include <client.pb.h>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <utils/buffer.h>
+#include <utils/common.h>
+#include <utils/cond.h>
+#include <utils/config.h>
+#include <utils/live_config.h>
+#include <utils/mutex.h>
+#include <utils/protobuf.h>
+#include <utils/rand.h>
+#include <utils/tid.h>
+
+using namespace ors;
+
+namespace {
+
+// string
+
+void string_fmt(benchmark::State &state) {
+  uint64_t i = 0;
+  for (auto _ : state)
+    benchmark::DoNotOptimize(utils::string::fmt("/bench/%010lu", ++i));
+}
+
+/// Arg: number of fields.
+void string_split(benchmark::State &state) {
+  std::vector<std::string> fields(size_t(state.range(0)), "field");
+  std::string line = utils::string::join(fields, ",");
+  for (auto _ : state)
+    benchmark::DoNotOptimize(utils::string::split(line, ','));
+  state.SetBytesProcessed(int64_t(state.iterations() * line.size()));
+}
+
+/// Arg: number of fields. The same walk as string_split, without copies.
+void string_split_view(benchmark::State &state) {
+  std::vector<std::string> fields(size_t(state.range(0)), "field");
+  std::string line = utils::string::join(fields, ",");
+  for (auto _ : state)
+    for (std::string_view part : utils::string::split_view(line, ','))
+      benchmark::DoNotOptimize(part);
+  state.SetBytesProcessed(int64_t(state.iterations() * line.size()));
+}
+
+void string_trim(benchmark::State &state) {
+  std::string line = "   key = value   ";
+  for (auto _ : state)
+    benchmark::DoNotOptimize(utils::string::trim(line));
+}
+
+void string_trim_view(benchmark::State &state) {
+  std::string line = "   key = value   ";
+  for (auto _ : state)
+    benchmark::DoNotOptimize(utils::string::trim_view(line));
+}
+
+/// Formatting into one reused string, as a request loop would.
+void string_append_fmt(benchmark::State &state) {
+  std::string out;
+  uint64_t i = 0;
+  for (auto _ : state) {
+    out.clear();
+    utils::string::append_fmt(out, "/bench/%010lu", ++i);
+    benchmark::DoNotOptimize(out.data());
+  }
+}
+
+void string_fmt_view(benchmark::State &state) {
+  uint64_t i = 0;
+  for (auto _ : state)
+    benchmark::DoNotOptimize(utils::string::fmt_view("/bench/%010lu", ++i));
+}
+
+/// What to_string() did for every type before it used to_chars.
+template <typename T> std::string stream_to_string(const T &t) {
+  std::stringstream ss;
+  ss << t;
+  return ss.str();
+}
+
+void string_to_string_int_stream(benchmark::State &state) {
+  uint64_t i = 1234567;
+  for (auto _ : state)
+    benchmark::DoNotOptimize(stream_to_string(++i));
+}
+
+void string_to_string_int(benchmark::State &state) {
+  uint64_t i = 1234567;
+  for (auto _ : state)
+    benchmark::DoNotOptimize(utils::string::to_string(++i));
+}
+
+void string_to_string_double(benchmark::State &state) {
+  double d = 0.125;
+  for (auto _ : state)
+    benchmark::DoNotOptimize(utils::string::to_string(d += 1.5));
+}
+
+/// Arg: string length, terminator included.
+void string_printable(benchmark::State &state) {
+  std::string s(size_t(state.range(0)) - 1, 'p');
+  for (auto _ : state)
+    benchmark::DoNotOptimize(utils::string::printable(s.c_str(), s.size() + 1));
+  state.SetBytesProcessed(int64_t(state.iterations() * s.size()));
+}
+
+/// Arg: number of fields.
+void string_join(benchmark::State &state) {
+  std::vector<std::string> fields(size_t(state.range(0)), "field");
+  for (auto _ : state)
+    benchmark::DoNotOptimize(utils::string::join(fields, ","));
+}
+
+// config
+
+/// Options in the generated config file.
+constexpr int CONFIG_KEYS = 100;
+
+const char *config_path() {
+  static const char *path = [] {
+    const char *p = "/tmp/ors_utils_bench.conf";
+    std::ofstream out(p);
+    out << "# generated by utils_bench\n";
+    for (int i = 0; i < CONFIG_KEYS; ++i)
+      out << "key" << i << " = " << i * 1000 << "  # comment\n";
+    return p;
+  }();
+  return path;
+}
+
+void config_read_file(benchmark::State &state) {
+  const char *path = config_path();
+  for (auto _ : state) {
+    utils::config c;
+    c.read_file(path);
+    benchmark::DoNotOptimize(c.has_key("key0"));
+  }
+  state.SetItemsProcessed(int64_t(state.iterations() * CONFIG_KEYS));
+}
+
+void config_read_string(benchmark::State &state) {
+  utils::config c;
+  c.read_file(config_path());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(c.read("key50"));
+}
+
+void config_read_int(benchmark::State &state) {
+  utils::config c;
+  c.read_file(config_path());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(c.read<int>("key50"));
+}
+
+/// The same lookup through a live_config handle: one relaxed load.
+void config_handle_get(benchmark::State &state) {
+  utils::live_config c(config_path());
+  auto h = c.integer("key50", 0);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(h.get());
+}
+
+// protobuf
+
+/// A Tree write with a value of the given size, the common log entry.
+proto::client::ReadWriteTree::Request tree_write(size_t value_bytes) {
+  proto::client::ReadWriteTree::Request req;
+  req.mutable_exactly_once()->set_client_id(7);
+  req.mutable_exactly_once()->set_first_outstanding_rpc(100);
+  req.mutable_exactly_once()->set_rpc_number(101);
+  req.mutable_write()->set_path("/bench/0000000042");
+  req.mutable_write()->set_contents(std::string(value_bytes, 'v'));
+  return req;
+}
+
+/// Arg: value bytes.
+void protobuf_serialize(benchmark::State &state) {
+  auto req = tree_write(size_t(state.range(0)));
+  for (auto _ : state) {
+    utils::buffer buf;
+    utils::protobuf::serialize(req, buf);
+    benchmark::DoNotOptimize(buf.data());
+  }
+  state.SetBytesProcessed(int64_t(state.iterations() * req.ByteSizeLong()));
+}
+
+/// Arg: value bytes.
+void protobuf_parse(benchmark::State &state) {
+  auto req = tree_write(size_t(state.range(0)));
+  utils::buffer buf;
+  utils::protobuf::serialize(req, buf);
+  proto::client::ReadWriteTree::Request out;
+  for (auto _ : state)
+    benchmark::DoNotOptimize(utils::protobuf::parse(buf, out));
+  state.SetBytesProcessed(int64_t(state.iterations() * req.ByteSizeLong()));
+}
+
+// mutex and condition_variable
+
+void mutex_lock_unlock(benchmark::State &state) {
+  utils::mutex m;
+  for (auto _ : state)
+    std::lock_guard<utils::mutex> lg(m);
+}
+
+/**
+ * One iteration is a full handoff between two threads: wake the echo
+ * thread through the condition variable and wait until it answers.
+ */
+void cond_round_trip(benchmark::State &state) {
+  utils::mutex m;
+  utils::condition_variable cv;
+  uint64_t turn = 0; // odd: the echo thread's move
+  bool done = false;
+  std::thread echo([&] {
+    std::unique_lock<utils::mutex> ul(m);
+    for (;;) {
+      while (turn % 2 == 0 && !done)
+        cv.wait(ul);
+      if (done)
+        return;
+      ++turn;
+      cv.notify_all();
+    }
+  });
+  {
+    std::unique_lock<utils::mutex> ul(m);
+    for (auto _ : state) {
+      ++turn;
+      cv.notify_all();
+      while (turn % 2 == 1)
+        cv.wait(ul);
+    }
+    done = true;
+    cv.notify_all();
+  }
+  echo.join();
+}
+
+// rand
+
+void rand_random64(benchmark::State &state) {
+  for (auto _ : state)
+    benchmark::DoNotOptimize(utils::rand::random64());
+}
+
+void rand_random_range(benchmark::State &state) {
+  for (auto _ : state)
+    benchmark::DoNotOptimize(utils::rand::random_range(uint64_t(0), 999));
+}
+
+void rand_random_decimal(benchmark::State &state) {
+  for (auto _ : state)
+    benchmark::DoNotOptimize(utils::rand::random_decimal());
+}
+
+// tid
+
+void tid_tid(benchmark::State &state) {
+  for (auto _ : state)
+    benchmark::DoNotOptimize(utils::tid::tid());
+}
+
+void tid_name(benchmark::State &state) {
+  utils::tid::set_name("bench-main");
+  for (auto _ : state)
+    benchmark::DoNotOptimize(utils::tid::name());
+}
+
+void tid_threads(benchmark::State &state) {
+  for (auto _ : state)
+    benchmark::DoNotOptimize(utils::tid::threads());
+}
+
+} // namespace
+
+BENCHMARK(string_fmt);
+BENCHMARK(string_split)->Arg(4)->Arg(64);
+BENCHMARK(string_split_view)->Arg(4)->Arg(64);
+BENCHMARK(string_join)->Arg(4)->Arg(64);
+BENCHMARK(string_trim);
+BENCHMARK(string_trim_view);
+BENCHMARK(string_append_fmt);
+BENCHMARK(string_fmt_view);
+BENCHMARK(string_to_string_int_stream);
+BENCHMARK(string_to_string_int);
+BENCHMARK(string_to_string_double);
+BENCHMARK(string_printable)->Arg(16)->Arg(256)->Arg(4096);
+BENCHMARK(config_read_file);
+BENCHMARK(config_read_string);
+BENCHMARK(config_read_int);
+BENCHMARK(config_handle_get);
+BENCHMARK(protobuf_serialize)->Arg(16)->Arg(4096);
+BENCHMARK(protobuf_parse)->Arg(16)->Arg(4096);
+BENCHMARK(mutex_lock_unlock);
+BENCHMARK(cond_round_trip)->UseRealTime();
+BENCHMARK(rand_random64);
+BENCHMARK(rand_random_range);
+BENCHMARK(rand_random_decimal);
+BENCHMARK(tid_tid);
+BENCHMARK(tid_name);
+BENCHMARK(tid_threads);
@@ -0,0 +1,39 @@
+-- xmake -g bench 构建所有benchmark, xmake run <name>_bench 运行
+set_group("bench")
+set_default(false)
+
+add_requires("benchmark","spdlog","protobuf","zlib")
+add_packages("benchmark","spdlog","protobuf","zlib")
+add_links("benchmark_main")
+add_syslinks("pthread")
+
+if not is_plat("macosx") then
+    add_ldflags("-lrt")
+end
+add_files("../src/utils/*.cc")
+add_files("../src/state_machine/*.cc")
+add_files("../src/storage/*.cc")
+add_files("../src/tree/*.cc")
+add_files("../src/sim/*.cc")
+add_files("../proto/server_stats.proto", {rules = "protobuf.cpp", proto_rootdir = "../proto"})
+add_files("../proto/client.proto", {rules = "protobuf.cpp", proto_rootdir = "../proto"})
+add_files("../proto/raft.proto", {rules = "protobuf.cpp", proto_rootdir = "../proto"})
+add_includedirs("../include")
+set_optimize("fastest")
+
+-- xmake run <name>_bench 也把结果写到 build/bench/<name>_bench.json,
+-- 用 benchmark 自带的 tools/compare.py 对比两个版本的结果
+for _, x in ipairs(os.files("*_bench.cc")) do
+    local name = path.basename(x)
+    target(name)
+        set_kind("binary")
+        add_files(x)
+        on_run(function (target)
+            import("core.base.option")
+            local out = path.join(os.projectdir(), "build", "bench", target:name() .. ".json")
+            os.mkdir(path.directory(out))
+            local argv = {"--benchmark_out=" .. out, "--benchmark_out_format=json"}
+            table.join2(argv, option.get("arguments") or {})
+            os.execv(target:targetfile(), argv)
+        end)
+end
@@ -0,0 +1,123 @@
+#ifndef __ORS_SIM_CLUSTER_H__
+#define __ORS_SIM_CLUSTER_H__
+
+#include <cinttypes>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sim/network.h>
+#include <sim/raft_server.h>
+#include <utils/noncopyable.h>
+#include <utils/rand.h>
+
+namespace ors {
+namespace sim {
+
+struct cluster_options {
+  size_t servers = 3;
+  /// Every random choice in the run derives from this seed.
+  uint64_t seed = 1;
+  network_options net;
+  raft_server::options raft;
+};
+
+/// What run_workload() measured, in simulated time.
+struct report {
+  uint64_t sim_nanos = 0;
+  uint64_t submitted = 0;
+  uint64_t committed = 0;
+  double commits_per_sec = 0;
+  /// Submit-to-commit latency of client requests.
+  uint64_t p50_latency_nanos = 0;
+  uint64_t p99_latency_nanos = 0;
+  uint64_t max_latency_nanos = 0;
+  uint64_t elections = 0;
+  uint64_t messages_sent = 0;
+  uint64_t messages_dropped = 0;
+
+  std::string to_string() const;
+};
+
+/**
+ * N raft_servers on one simulated network, all driven by a single seeded
+ * generator and the event_queue's clock. The same options, seed and calls
+ * always give the same run, so a failing seed can be replayed exactly.
+ *
+ * Servers have ids 1..N; server(i) is 0-based.
+ */
+class cluster : public utils::noncopyable {
+public:
+  explicit cluster(const cluster_options &opts);
+
+  event_queue &events() { return queue; }
+  network &net() { return transport; }
+  raft_server &server(size_t i) { return *servers[i]; }
+  size_t size() const { return servers.size(); }
+
+  /// The running leader with the highest term, or nullptr if none.
+  raft_server *leader();
+
+  /// Advance simulated time by nanos, running everything due.
+  void run_for(uint64_t nanos);
+
+  /// Run until some server is leader; false if none is within timeout.
+  bool wait_for_leader(uint64_t timeout_nanos);
+
+  /**
+   * Closed-loop load: each of clients keeps one request of bytes bytes
+   * outstanding, submitting the next as soon as the last commits. A request
+   * not committed within two election timeouts, or submitted while there is
+   * no leader, is retried.
+   */
+  report run_workload(uint64_t nanos, size_t clients, size_t bytes);
+
+  /**
+   * Check the Raft safety properties over everything run so far: at most
+   * one leader per term, and no two servers (nor two leaders over time)
+   * disagree on a committed entry.
+   * \return
+   *      A description of the first violation, or "" if none.
+   */
+  std::string check_safety() const;
+
+  void crash(size_t i) { servers[i]->crash(); }
+  void restart(size_t i) { servers[i]->restart(); }
+
+private:
+  struct client {
+    uint64_t seq;
+    uint64_t submit_nanos;
+    /// Pending retry timer, 0 if none.
+    uint64_t timer;
+  };
+
+  /// After each event: record leaders by term for check_safety().
+  void observe();
+  void committed(uint64_t index, const proto::raft::Entry &entry);
+  void submit(size_t c);
+
+  const cluster_options opts;
+  utils::rand::xoshiro256 rng;
+  event_queue queue;
+  network transport;
+  std::vector<std::unique_ptr<raft_server>> servers;
+
+  /// Leader of each term seen so far.
+  std::map<uint64_t, uint64_t> leaders;
+  /// Term of each entry any leader has reported committed, by index.
+  std::map<uint64_t, uint64_t> commits;
+  std::string violation;
+
+  // workload state, live only inside run_workload()
+  std::vector<client> clients;
+  size_t request_bytes;
+  std::vector<uint64_t> latencies;
+  uint64_t submitted;
+};
+
+} // namespace sim
+} // namespace ors
+
+#endif // !__ORS_SIM_CLUSTER_H__
@@ -0,0 +1,134 @@
+#ifndef __ORS_SIM_NETWORK_H__
+#define __ORS_SIM_NETWORK_H__
+
+#include <cinttypes>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include <raft.pb.h>
+#include <utils/noncopyable.h>
+#include <utils/rand.h>
+
+namespace ors {
+namespace sim {
+
+/**
+ * Discrete-event scheduler and the simulation's clock.
+ *
+ * Time only moves when events run: now() jumps straight to the next event,
+ * so simulated hours take as long as the work done in them. Events at the
+ * same time run in the order they were scheduled, which keeps runs with the
+ * same seed identical.
+ */
+class event_queue : public utils::noncopyable {
+public:
+  event_queue();
+
+  /// Nanoseconds of simulated time since the simulation started.
+  uint64_t now() const { return now_nanos; }
+
+  /// Run fn at now() + delay_nanos. Returns an id for cancel().
+  uint64_t schedule(uint64_t delay_nanos, std::function<void()> fn);
+
+  /// Forget the event with the given id, if it has not run yet.
+  void cancel(uint64_t id);
+
+  /// Run the earliest event; false if there is none.
+  bool step();
+
+  /// Run every event due up to nanos, then set now() to nanos.
+  void run_until(uint64_t nanos);
+
+  size_t pending() const { return events.size(); }
+
+  /// Time the earliest event is due; pending() must be nonzero.
+  uint64_t next_time() const { return events.begin()->first.first; }
+
+private:
+  /// Keyed by (time, id); ids increase, so ties run in schedule order.
+  std::map<std::pair<uint64_t, uint64_t>, std::function<void()>> events;
+  /// Time of each pending event, by id, for cancel().
+  std::unordered_map<uint64_t, uint64_t> times;
+  uint64_t now_nanos;
+  uint64_t next_id;
+};
+
+/// An RPC or reply between two simulated servers.
+using message = std::variant<proto::raft::RequestVote::Request,
+                             proto::raft::RequestVote::Response,
+                             proto::raft::AppendEntries::Request,
+                             proto::raft::AppendEntries::Response>;
+
+struct network_options {
+  /// Each message takes a uniformly random latency in [min, max].
+  uint64_t min_latency_nanos = 100 * 1000;
+  uint64_t max_latency_nanos = 1000 * 1000;
+  /// Probability that a message is lost.
+  double drop_rate = 0;
+  /// Probability that a message is held back up to reorder_nanos more, so
+  /// that later messages overtake it.
+  double reorder_rate = 0;
+  uint64_t reorder_nanos = 10 * 1000 * 1000;
+};
+
+/**
+ * In-memory transport between simulated servers, with latency, loss,
+ * reordering and partitions all drawn from the simulation's seeded
+ * generator.
+ */
+class network : public utils::noncopyable {
+public:
+  using handler = std::function<void(uint64_t from, const message &m)>;
+
+  network(event_queue &events, utils::rand::xoshiro256 &rng,
+          const network_options &options);
+
+  /// Deliver messages addressed to id to h.
+  void attach(uint64_t id, handler h);
+
+  /// Queue m for delivery; it may be delayed, reordered or lost.
+  void send(uint64_t from, uint64_t to, message m);
+
+  /**
+   * Split the servers: servers in different groups cannot reach each
+   * other, including messages already in flight. Servers in no group form
+   * one more group together.
+   */
+  void partition(const std::vector<std::vector<uint64_t>> &groups);
+
+  /// Cut id off from every other server.
+  void isolate(uint64_t id);
+
+  /// Undo partition() and isolate().
+  void heal();
+
+  bool connected(uint64_t from, uint64_t to) const;
+
+  void set_options(const network_options &options) { this->options = options; }
+
+  const network_options &get_options() const { return options; }
+
+  uint64_t num_sent() const { return sent; }
+  uint64_t num_delivered() const { return delivered; }
+  uint64_t num_dropped() const { return dropped; }
+
+private:
+  event_queue &events;
+  utils::rand::xoshiro256 &rng;
+  network_options options;
+  std::map<uint64_t, handler> handlers;
+  /// Partition group of each server; absent means group 0.
+  std::map<uint64_t, uint64_t> groups;
+  uint64_t next_group;
+  uint64_t sent;
+  uint64_t delivered;
+  uint64_t dropped;
+};
+
+} // namespace sim
+} // namespace ors
+
+#endif // !__ORS_SIM_NETWORK_H__
@@ -0,0 +1,133 @@
+#ifndef __ORS_SIM_RAFT_SERVER_H__
+#define __ORS_SIM_RAFT_SERVER_H__
+
+#include <cinttypes>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <raft.pb.h>
+#include <sim/network.h>
+#include <utils/noncopyable.h>
+#include <utils/rand.h>
+
+namespace ors {
+namespace sim {
+
+/**
+ * A Raft server reduced to what the simulator exercises: leader election
+ * and log replication over proto::raft RPCs, with the log, term and vote
+ * kept in memory as if on stable storage (they survive crash()). There are
+ * no snapshots or membership changes.
+ *
+ * Like the rest of the simulator it runs on the event_queue's thread only.
+ */
+class raft_server : public utils::noncopyable {
+public:
+  enum state { FOLLOWER, CANDIDATE, LEADER };
+
+  struct options {
+    /// Followers time out after a random time in [timeout, 2 * timeout).
+    uint64_t election_timeout_nanos = 150 * 1000 * 1000;
+    uint64_t heartbeat_nanos = 50 * 1000 * 1000;
+    /// Most entries per AppendEntries request.
+    size_t max_batch = 256;
+  };
+
+  /// Called on the leader for each entry it commits, in index order.
+  using commit_callback =
+      std::function<void(uint64_t index, const proto::raft::Entry &entry)>;
+
+  raft_server(uint64_t id, const std::vector<uint64_t> &servers,
+              event_queue &events, network &net, utils::rand::xoshiro256 &rng,
+              const options &opts);
+
+  /// Begin as a follower.
+  void start();
+
+  /// Stop responding and lose volatile state; the log, term and vote remain.
+  void crash();
+
+  /// Come back as a follower after crash().
+  void restart();
+
+  /**
+   * Append a DATA entry if this server is leader.
+   * \return
+   *      The entry's index, or 0 if this server is not leader.
+   */
+  uint64_t submit(std::string data);
+
+  void on_commit(commit_callback cb) { committed = std::move(cb); }
+
+  uint64_t get_id() const { return id; }
+  state get_state() const { return st; }
+  bool is_up() const { return up; }
+  uint64_t get_term() const { return term; }
+  uint64_t get_commit_index() const { return commit_index; }
+  uint64_t last_log_index() const { return log.size(); }
+
+  /// The entry at index, 1-based; index must be in the log.
+  const proto::raft::Entry &entry(uint64_t index) const {
+    return log[index - 1];
+  }
+
+  /// Elections this server has won.
+  uint64_t num_elections_won() const { return elections_won; }
+
+private:
+  struct peer {
+    uint64_t next_index;
+    uint64_t match_index;
+    /// Whether an AppendEntries to this peer awaits its reply.
+    bool in_flight;
+    /// When that request was sent; after a heartbeat without a reply it is
+    /// taken as lost.
+    uint64_t sent_nanos;
+    bool vote_granted;
+  };
+
+  void handle(uint64_t from, const message &m);
+  void handle(uint64_t from, const proto::raft::RequestVote::Request &req);
+  void handle(uint64_t from, const proto::raft::RequestVote::Response &resp);
+  void handle(uint64_t from, const proto::raft::AppendEntries::Request &req);
+  void handle(uint64_t from, const proto::raft::AppendEntries::Response &resp);
+
+  void step_down(uint64_t new_term);
+  void start_election();
+  void become_leader();
+  void reset_election_timer();
+  void heartbeat();
+  void replicate(uint64_t to);
+  void advance_commit(uint64_t index);
+  uint64_t term_at(uint64_t index) const;
+  void append(proto::raft::EntryType type, std::string data);
+
+  const uint64_t id;
+  const std::vector<uint64_t> servers;
+  event_queue &events;
+  network &net;
+  utils::rand::xoshiro256 &rng;
+  const options opts;
+
+  // "persistent" state
+  uint64_t term;
+  uint64_t voted_for;
+  std::vector<proto::raft::Entry> log;
+
+  // volatile state
+  bool up;
+  state st;
+  uint64_t commit_index;
+  std::map<uint64_t, peer> peers;
+  /// Pending election or heartbeat timer, 0 if none.
+  uint64_t timer;
+  uint64_t elections_won;
+  commit_callback committed;
+};
+
+} // namespace sim
+} // namespace ors
+
+#endif // !__ORS_SIM_RAFT_SERVER_H__
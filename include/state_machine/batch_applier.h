@@ -0,0 +1,146 @@
+#ifndef __ORS_STATE_MACHINE_BATCH_APPLIER_H__
+#define __ORS_STATE_MACHINE_BATCH_APPLIER_H__
+
+#include <cinttypes>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <server_stats.pb.h>
+#include <utils/cond.h>
+#include <utils/histogram.h>
+#include <utils/mutex.h>
+#include <utils/noncopyable.h>
+#include <utils/rolling_stat.h>
+#include <utils/time.h>
+
+namespace ors {
+namespace state_machine {
+
+/**
+ * Applies committed entries to the state machine in batches.
+ *
+ * Every call to commit() queues entries; the applier thread takes everything
+ * queued so far, hands it to the apply function in a single call (so the
+ * state machine enters its critical section once per batch rather than once
+ * per entry), then publishes all the responses and the new last_applied
+ * index under one lock acquisition followed by a single notify_all().
+ */
+class batch_applier : public utils::noncopyable {
+public:
+  struct entry {
+    uint64_t index;
+    std::string data;
+  };
+
+  /**
+   * Applies a batch of consecutive entries. It must push exactly one
+   * response per entry onto responses, in order.
+   */
+  using apply_fn = std::function<void(const std::vector<entry> &batch,
+                                      std::vector<std::string> &responses)>;
+
+  /**
+   * \param apply
+   *      Called from the applier thread for every batch.
+   * \param max_batch_size
+   *      Upper bound on entries passed to a single apply call (0 means no
+   *      limit).
+   * \param max_responses
+   *      Number of uncollected responses kept around for wait_response();
+   *      the oldest ones are dropped beyond this.
+   */
+  explicit batch_applier(apply_fn apply, size_t max_batch_size = 1024,
+                         size_t max_responses = 65536);
+
+  ~batch_applier();
+
+  /// Start the applier thread.
+  void start();
+
+  /// Stop the applier thread, waking up anyone blocked in wait_*().
+  void exit();
+
+  /// Queue newly committed entries, which must follow last queued index.
+  void commit(std::vector<entry> entries);
+
+  void commit(uint64_t index, std::string data);
+
+  /**
+   * Apply everything currently queued (up to max_batch_size entries) and
+   * publish the results. Used by the applier thread; tests call it directly.
+   * \return
+   *      Number of entries applied.
+   */
+  size_t apply_batch();
+
+  /**
+   * Block until the entry at index has been applied, then move its response
+   * out. Returns false on timeout, exit, or if the response was dropped.
+   */
+  bool wait_response(uint64_t index, std::string &response,
+                     utils::time::steady_clock::time_point deadline =
+                         utils::time::steady_clock::time_point::max());
+
+  /// Block until last_applied() >= index. Returns false on timeout or exit.
+  bool wait_applied(uint64_t index,
+                    utils::time::steady_clock::time_point deadline =
+                        utils::time::steady_clock::time_point::max());
+
+  uint64_t last_applied();
+
+  /// Change max_batch_size while running, e.g. from a config reload.
+  void set_max_batch_size(size_t n);
+
+  void update_server_stats(proto::ServerStats::StateMachine &stats);
+
+  void update_server_stats(proto::ServerStats::Latency &stats);
+
+private:
+  void applier_main();
+
+  const apply_fn apply;
+
+  /// Guarded by mtx.
+  size_t max_batch_size;
+
+  const size_t max_responses;
+
+  utils::mutex mtx;
+
+  /// Notified when entries are queued or on exit.
+  utils::condition_variable pending_changed;
+
+  /// Notified once per published batch or on exit.
+  utils::condition_variable applied_changed;
+
+  bool exiting;
+
+  std::deque<entry> pending;
+
+  /// Responses of applied entries that nobody has collected yet.
+  std::map<uint64_t, std::string> responses;
+
+  uint64_t last_applied_index;
+
+  uint64_t num_batches;
+
+  uint64_t num_entries;
+
+  uint64_t max_batch;
+
+  utils::rolling_stat batch_sizes;
+
+  /// Time spent in the apply function per batch.
+  utils::histogram apply_nanos;
+
+  std::thread thread;
+};
+
+} // namespace state_machine
+} // namespace ors
+
+#endif // !__ORS_STATE_MACHINE_BATCH_APPLIER_H__
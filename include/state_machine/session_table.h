@@ -0,0 +1,143 @@
+#ifndef __ORS_STATE_MACHINE_SESSION_TABLE_H__
+#define __ORS_STATE_MACHINE_SESSION_TABLE_H__
+
+#include <cinttypes>
+#include <list>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <client.pb.h>
+#include <server_stats.pb.h>
+#include <utils/noncopyable.h>
+
+namespace ors {
+namespace state_machine {
+
+/**
+ * Client sessions for exactly-once semantics.
+ *
+ * Each session caches the responses to its outstanding RPCs in a small ring
+ * indexed by rpc_number, so a duplicate is detected with one lookup and a
+ * compare. Responses below the client's first_outstanding_rpc are dropped as
+ * soon as the client reports it, the ring never grows past
+ * max_responses_per_session entries, a client may not have more than
+ * max_outstanding_rpcs RPCs outstanding, and sessions that have not been used
+ * for expiration_nanos of cluster time are removed oldest first.
+ *
+ * Not thread-safe: the state machine calls this under its own lock, in log
+ * order, so that every replica reaches the same decisions.
+ */
+class session_table : public utils::noncopyable {
+public:
+  enum status {
+    /// First time this RPC is seen: apply it, then call record().
+    NEW,
+    /// Already applied; the cached response has been returned.
+    DUPLICATE,
+    /// Below first_outstanding_rpc: the client already has the response.
+    STALE,
+    /**
+     * No such session, the response was evicted from a full ring, or the
+     * RPC is max_outstanding_rpcs or more past first_outstanding_rpc (which
+     * also closes the session).
+     */
+    EXPIRED,
+  };
+
+  explicit session_table(uint64_t expiration_nanos,
+                         size_t max_responses_per_session = 64,
+                         size_t max_outstanding_rpcs = 1024);
+
+  /// Open a session. client_id is normally the index of the log entry.
+  void open(uint64_t client_id, uint64_t cluster_time);
+
+  void close(uint64_t client_id);
+
+  /**
+   * Look up an RPC before applying it. Garbage-collects responses the
+   * client no longer needs and refreshes the session's expiry time.
+   */
+  status check(const proto::client::ExactlyOnceRPCInfo &rpc,
+               uint64_t cluster_time, std::string &response);
+
+  /// Cache the response to an RPC for which check() returned NEW.
+  void record(const proto::client::ExactlyOnceRPCInfo &rpc,
+              std::string response);
+
+  /**
+   * Remove sessions idle since before cluster_time - expiration_nanos.
+   * \return
+   *      Number of sessions removed.
+   */
+  size_t expire(uint64_t cluster_time);
+
+  size_t size() const;
+
+  bool has_session(uint64_t client_id) const;
+
+  void update_server_stats(proto::ServerStats::StateMachine &stats) const;
+
+private:
+  struct slot {
+    /// 0 when the slot is empty; valid rpc numbers start at 1.
+    uint64_t rpc_number;
+    std::string response;
+  };
+
+  struct session {
+    uint64_t client_id;
+    uint64_t last_modified;
+    uint64_t first_outstanding_rpc;
+    /// Highest rpc_number recorded; the ring is freed once all are collected.
+    uint64_t max_rpc_number;
+    /**
+     * RPCs at or above first_outstanding_rpc whose responses were evicted
+     * from a full ring; fewer than max_outstanding. Anything else missing from the ring has not been
+     * applied, even if it is below max_rpc_number: pipelined RPCs may arrive
+     * out of order.
+     */
+    std::set<uint64_t> evicted;
+    /// Power-of-two sized, indexed by rpc_number & (size - 1).
+    std::vector<slot> ring;
+  };
+
+  using lru_list = std::list<session>;
+
+  /// Drop cached responses below first_outstanding_rpc.
+  void collect(session &s, uint64_t first_outstanding_rpc);
+
+  /// Double the ring, rehashing the live responses.
+  void grow(session &s);
+
+  /// Drop the response in sl because the ring is full.
+  void evict(session &s, slot &sl);
+
+  void touch(lru_list::iterator it, uint64_t cluster_time);
+
+  const uint64_t expiration_nanos;
+
+  const size_t max_responses;
+
+  /// Bounds the span of rpc numbers a session tracks, and so its evicted set.
+  const uint64_t max_outstanding;
+
+  /// Sessions ordered by last_modified, least recently used first.
+  lru_list lru;
+
+  std::unordered_map<uint64_t, lru_list::iterator> sessions;
+
+  uint64_t num_responses;
+
+  uint64_t num_duplicates;
+
+  uint64_t num_evicted;
+
+  uint64_t num_expired;
+};
+
+} // namespace state_machine
+} // namespace ors
+
+#endif // !__ORS_STATE_MACHINE_SESSION_TABLE_H__
@@ -0,0 +1,110 @@
+#ifndef __ORS_STATE_MACHINE_SNAPSHOT_FORK_H__
+#define __ORS_STATE_MACHINE_SNAPSHOT_FORK_H__
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <functional>
+#include <sys/types.h>
+
+#include <server_stats.pb.h>
+#include <utils/mutex.h>
+#include <utils/noncopyable.h>
+
+namespace ors {
+namespace state_machine {
+
+/**
+ * Takes state machine snapshots in a forked child process.
+ *
+ * The child gets a copy-on-write image of the parent's memory, so it can
+ * serialize the state at the instant of the fork while the parent keeps
+ * applying commands. The parent pays for the fork() itself plus one page
+ * copy for each page it dirties while the child is still alive. Just before
+ * exiting, the child reads its own /proc/self/smaps_rollup: the pages it no
+ * longer shares with the parent are the ones that were copied, whichever
+ * side wrote them. That, the fork time and the pages the child faulted in
+ * are exported through ServerStats.StateMachine.
+ *
+ * The child flushes the log before exiting, so its records are written.
+ *
+ * The pthread_atfork() handlers installed by utils::rand run around the
+ * fork, so the child does not share the parent's random sequence.
+ */
+class snapshot_fork : public utils::noncopyable {
+public:
+  /**
+   * Runs in the child. Its return value becomes the child's exit status:
+   * 0 for success, anything else is reported as a failed snapshot.
+   */
+  using child_fn = std::function<int()>;
+
+  snapshot_fork();
+
+  /// Kills and reaps any snapshot still in progress.
+  ~snapshot_fork();
+
+  /**
+   * Fork a child that runs child_main and then exits. The caller should hold
+   * the state machine's lock so the child sees a consistent image; the lock
+   * may be released as soon as this returns.
+   * \return
+   *      False if a snapshot is already in progress or fork() failed.
+   */
+  bool start(child_fn child_main);
+
+  /// Whether a child is running. Reaps it without blocking if it exited.
+  bool in_progress();
+
+  /**
+   * Block until the current child exits.
+   * \return
+   *      True if the child exited with status 0.
+   */
+  bool wait();
+
+  /// Kill the current child, if any, and reap it (STOP_SNAPSHOT).
+  void stop();
+
+  pid_t child_pid();
+
+  void update_server_stats(proto::ServerStats::StateMachine &stats);
+
+private:
+  /// Record the outcome of a child reaped by wait4(). Caller holds mtx.
+  bool finish(int status, const struct rusage &child_usage);
+
+  /// Reap the child, blocking if requested. Caller holds mtx.
+  bool reap(bool block, bool &success);
+
+  utils::mutex mtx;
+
+  pid_t pid;
+
+  uint64_t num_attempted;
+
+  uint64_t num_failed;
+
+  std::chrono::nanoseconds last_fork_nanos;
+
+  /// Pages faulted in by the last child itself.
+  uint64_t last_child_pages;
+
+  /// Private memory of the last child when it finished; 0 if unknown.
+  uint64_t last_cow_bytes;
+
+  /**
+   * One shared page, mapped before any fork, where the child leaves its
+   * private memory size for the parent.
+   */
+  std::atomic<uint64_t> *child_private_bytes;
+
+  bool last_success;
+
+  const uint64_t page_size;
+};
+
+} // namespace state_machine
+} // namespace ors
+
+#endif // !__ORS_STATE_MACHINE_SNAPSHOT_FORK_H__
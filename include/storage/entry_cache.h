@@ -0,0 +1,100 @@
+#ifndef __ORS_STORAGE_ENTRY_CACHE_H__
+#define __ORS_STORAGE_ENTRY_CACHE_H__
+
+#include <cinttypes>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <raft.pb.h>
+#include <server_stats.pb.h>
+#include <utils/mutex.h>
+#include <utils/noncopyable.h>
+
+namespace ors {
+namespace storage {
+
+/**
+ * The most recently appended log entries, kept in memory so that followers
+ * that are only slightly behind can be sent AppendEntries without reading
+ * the log back from disk.
+ *
+ * Entries are shared, not copied: the append path hands over the same
+ * shared_ptr it writes to disk, and readers get it back. The cache holds a
+ * contiguous range of indexes and evicts from the oldest end once the
+ * entries' serialized size exceeds the byte budget.
+ *
+ * Safe to use from several threads; every call takes one short lock.
+ */
+class entry_cache : public utils::noncopyable {
+public:
+  using entry_ptr = std::shared_ptr<const proto::raft::Entry>;
+
+  explicit entry_cache(uint64_t max_bytes);
+
+  /**
+   * Add the entry at index. Appending at or below last_index() replaces
+   * that entry and drops everything after it, as a log truncation does; a
+   * gap after last_index() empties the cache first. An entry larger than
+   * the whole budget is not kept.
+   */
+  void append(uint64_t index, entry_ptr entry);
+
+  /// Drop the entries from index on, after the log was truncated there.
+  void truncate_suffix(uint64_t index);
+
+  /// Drop the entries before index, e.g. once they are in a snapshot.
+  void truncate_prefix(uint64_t index);
+
+  /// The entry at index, or nullptr if it is not cached.
+  entry_ptr get(uint64_t index);
+
+  /**
+   * Append to out the cached entries from first on, stopping after
+   * max_entries, before exceeding max_bytes (but always taking at least
+   * one), or at the end of the cache.
+   * \return
+   *      Number of entries appended; 0 means first is not cached.
+   */
+  size_t get_range(uint64_t first, size_t max_entries, uint64_t max_bytes,
+                   std::vector<entry_ptr> &out);
+
+  /// Index of the oldest cached entry; meaningless while empty().
+  uint64_t first_index();
+
+  /// Index of the newest cached entry; first_index() - 1 while empty().
+  uint64_t last_index();
+
+  bool empty();
+
+  uint64_t bytes();
+
+  void update_server_stats(proto::ServerStats::Storage &stats);
+
+private:
+  struct slot {
+    entry_ptr entry;
+    uint64_t bytes;
+  };
+
+  /// Evict the oldest entries until within budget. Requires mtx.
+  void evict();
+
+  const uint64_t max_bytes;
+
+  utils::mutex mtx;
+
+  /// slots[i] holds the entry at index first + i.
+  std::deque<slot> slots;
+  uint64_t first;
+  uint64_t total_bytes;
+
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+};
+
+} // namespace storage
+} // namespace ors
+
+#endif // !__ORS_STORAGE_ENTRY_CACHE_H__
@@ -0,0 +1,213 @@
+#ifndef __ORS_STORAGE_SNAPSHOT_FILE_H__
+#define __ORS_STORAGE_SNAPSHOT_FILE_H__
+
+#include <cinttypes>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <utils/noncopyable.h>
+#include <utils/protobuf.h>
+
+namespace ors {
+namespace storage {
+namespace snapshot_file {
+
+/**
+ * On-disk layout, all integers little-endian:
+ *
+ *   header:  magic[8] version:u32 block_size:u32
+ *   blocks:  stored bytes of block 0, block 1, ...
+ *   index:   one block_info per block (see below)
+ *   footer:  index_offset:u64 num_blocks:u32 index_crc:u32 magic[8]
+ *
+ * Each block holds up to block_size bytes of the logical stream, compressed
+ * independently. Messages are length-prefixed (u32) and never straddle a
+ * block boundary unless a single message is larger than a block; blocks that
+ * begin in the middle of such a message are marked as continued. A run of
+ * blocks starting at a block that is not continued can therefore be decoded
+ * and parsed without looking at any other block.
+ */
+
+enum codec : uint8_t {
+  /// Stored as-is; used when compression does not pay off.
+  NONE = 0,
+  ZLIB = 1,
+};
+
+struct block_info {
+  uint64_t offset;
+  uint32_t stored_length;
+  uint32_t raw_length;
+  /// CRC32 of the raw (uncompressed) bytes.
+  uint32_t crc;
+  codec type;
+  /// Block starts in the middle of a write begun in an earlier block.
+  bool continued;
+};
+
+struct exception : public std::runtime_error {
+  explicit exception(const std::string &error);
+};
+
+constexpr uint32_t VERSION = 2;
+
+constexpr uint32_t DEFAULT_BLOCK_SIZE = 1024 * 1024;
+
+class writer : public utils::protobuf::ostream, public utils::noncopyable {
+public:
+  /**
+   * Create (or truncate) path. Throws exception on I/O errors or if
+   * block_size is 0.
+   * \param level
+   *      zlib compression level; 0 stores every block uncompressed.
+   */
+  explicit writer(const std::string &path,
+                  uint32_t block_size = DEFAULT_BLOCK_SIZE, int level = 1);
+
+  /// Calls close() if it has not been called; errors are only logged.
+  ~writer();
+
+  size_t get_bytes_writen() const override;
+
+  void write_message(const google::protobuf::Message &msg) override;
+
+  void write_raw(const void *data, size_t length) override;
+
+  /// End the current block early, e.g. at a subtree boundary.
+  void flush_block();
+
+  /// Write the index and footer, then fsync and close the file.
+  void close();
+
+  /// Size of the file so far, which is what gets shipped.
+  uint64_t file_bytes() const;
+
+  const std::vector<block_info> &blocks() const { return index; }
+
+private:
+  void write_fully(const void *data, size_t length);
+
+  int fd;
+
+  const std::string path;
+
+  const uint32_t block_size;
+
+  const int level;
+
+  std::string current;
+
+  /// Whether the block being filled continues an earlier write.
+  bool continued;
+
+  std::vector<block_info> index;
+
+  uint64_t offset;
+
+  size_t bytes_written;
+};
+
+class reader : public utils::protobuf::istream, public utils::noncopyable {
+public:
+  /// Open path and load its index. Throws exception if it is malformed.
+  explicit reader(const std::string &path);
+
+  ~reader();
+
+  size_t get_bytes_read() const override;
+
+  /**
+   * Read the next length-prefixed message.
+   * \return
+   *      Empty string on success, otherwise a description of the error.
+   */
+  std::string readMessage(google::protobuf::Message &msg) override;
+
+  size_t readRaw(void *data, size_t length) override;
+
+  size_t num_blocks() const { return index.size(); }
+
+  const std::vector<block_info> &blocks() const { return index; }
+
+  /// Total bytes of the logical stream.
+  uint64_t raw_bytes() const;
+
+  /**
+   * Read, verify and decompress one block. Safe to call from several
+   * threads at once. Throws exception on corruption.
+   */
+  std::string decode_block(size_t i) const;
+
+  /**
+   * Group blocks into runs that start on a message boundary. Each entry is
+   * the index of the first block of a run; a run extends up to the next
+   * entry (or the end of the file).
+   */
+  std::vector<size_t> runs() const;
+
+private:
+  /// Make sure pos points into a block with data left, if any remain.
+  bool fill();
+
+  int fd;
+
+  const std::string path;
+
+  uint32_t block_size;
+
+  std::vector<block_info> index;
+
+  /// Next block to decode for sequential reads.
+  size_t next_block;
+
+  std::string current;
+
+  size_t pos;
+
+  size_t bytes_read;
+};
+
+/**
+ * Decode a snapshot on up to `threads` threads (0 means one per core). Each
+ * run of blocks is decompressed by one worker, which then calls
+ * visit(run, raw) with the run's bytes, so visit is called concurrently for
+ * different runs and should build independent pieces of state that the
+ * caller merges in run order afterwards. The first exception thrown by a
+ * worker is rethrown once all workers have stopped.
+ */
+void for_each_run(const reader &r, size_t threads,
+                  const std::function<void(size_t run, const std::string &raw)>
+                      &visit);
+
+/**
+ * Split the raw bytes of a run into its length-prefixed messages and parse
+ * them. Throws exception if the bytes are malformed.
+ */
+template <typename M> std::vector<M> parse_messages(const std::string &raw) {
+  std::vector<M> msgs;
+  size_t pos = 0;
+  while (pos < raw.size()) {
+    if (raw.size() - pos < 4)
+      throw exception("Truncated message length in snapshot run");
+    uint32_t length = 0;
+    for (int i = 3; i >= 0; --i)
+      length = (length << 8) | uint8_t(raw[pos + size_t(i)]);
+    pos += 4;
+    if (raw.size() - pos < length)
+      throw exception("Truncated message in snapshot run");
+    msgs.emplace_back();
+    if (!msgs.back().ParseFromArray(raw.data() + pos, int(length)))
+      throw exception("Failed to parse message of type " +
+                      msgs.back().GetTypeName());
+    pos += length;
+  }
+  return msgs;
+}
+
+} // namespace snapshot_file
+} // namespace storage
+} // namespace ors
+
+#endif // !__ORS_STORAGE_SNAPSHOT_FILE_H__
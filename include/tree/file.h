@@ -0,0 +1,82 @@
+#ifndef __ORS_TREE_FILE_H__
+#define __ORS_TREE_FILE_H__
+
+#include <cinttypes>
+#include <string>
+#include <string_view>
+
+#include <server_stats.pb.h>
+
+namespace ors {
+namespace tree {
+
+/**
+ * Length and hash of a file's contents. Kept next to the contents so that
+ * TreeCondition checks can usually be decided without reading them.
+ * The hash is only used in memory and is recomputed after a restore, so it
+ * need not be stable across builds.
+ */
+struct digest {
+  uint64_t length;
+  uint64_t hash;
+
+  static digest of(std::string_view contents);
+
+  bool operator==(const digest &other) const {
+    return length == other.length && hash == other.hash;
+  }
+  bool operator!=(const digest &other) const { return !(*this == other); }
+};
+
+/**
+ * A file in the Tree.
+ */
+class file {
+public:
+  file();
+
+  explicit file(std::string contents);
+
+  void write(std::string contents);
+
+  const std::string &contents() const { return data; }
+
+  const struct digest &digest() const { return sum; }
+
+private:
+  std::string data;
+
+  struct digest sum;
+};
+
+/**
+ * Counters for TreeCondition checks, see ServerStats.Tree.
+ */
+struct condition_stats {
+  uint64_t num_checked = 0;
+  uint64_t num_failed = 0;
+  /// Decided by comparing lengths only.
+  uint64_t num_length_rejected = 0;
+  /// Decided by comparing hashes without reading the contents.
+  uint64_t num_hash_rejected = 0;
+  /// Needed a byte-by-byte comparison (the digests matched).
+  uint64_t num_full_compares = 0;
+
+  void update_server_stats(proto::ServerStats::Tree &stats) const;
+};
+
+/**
+ * Check whether f has exactly the contents `expected`, whose digest the
+ * caller may have computed before taking the state machine lock. A missing
+ * file (f == nullptr) only matches empty contents.
+ */
+bool check_condition(const file *f, std::string_view expected,
+                     const digest &expected_digest, condition_stats &stats);
+
+bool check_condition(const file *f, std::string_view expected,
+                     condition_stats &stats);
+
+} // namespace tree
+} // namespace ors
+
+#endif // !__ORS_TREE_FILE_H__
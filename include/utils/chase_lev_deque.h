@@ -0,0 +1,128 @@
+#ifndef __ORS_UTILS_CHASE_LEV_DEQUE_H__
+#define __ORS_UTILS_CHASE_LEV_DEQUE_H__
+
+#include <atomic>
+#include <cinttypes>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <utils/noncopyable.h>
+
+namespace ors {
+namespace utils {
+
+/**
+ * Lock-free work-stealing deque (Chase and Lev, with the memory orderings
+ * of Le et al., "Correct and Efficient Work-Stealing for Weak Memory
+ * Models", PPoPP 2013).
+ *
+ * One owner thread push()es and pop()s at the bottom, LIFO; any number of
+ * other threads steal() from the top, FIFO. The buffer doubles when full;
+ * old buffers are kept until destruction since a thief may still be reading
+ * one. T must be trivially copyable, typically a pointer.
+ */
+template <typename T> class chase_lev_deque : public noncopyable {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "chase_lev_deque holds trivially copyable values");
+
+public:
+  explicit chase_lev_deque(size_t capacity = 256)
+      : top(0), bottom(0), buffer(nullptr), buffers() {
+    size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+    buffers.emplace_back(new ring(int64_t(size)));
+    buffer.store(buffers.back().get(), std::memory_order_relaxed);
+  }
+
+  /// Owner only.
+  void push(T value) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    ring *r = buffer.load(std::memory_order_relaxed);
+    if (b - t > r->size - 1)
+      r = grow(r, t, b);
+    r->put(b, value);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+  }
+
+  /// Owner only. Takes the most recently pushed value.
+  bool pop(T &out) {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    ring *r = buffer.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+    if (t > b) { // empty
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+    out = r->get(b);
+    if (t == b) {
+      // last element: race thieves for it
+      bool won = top.compare_exchange_strong(t, t + 1,
+                                             std::memory_order_seq_cst,
+                                             std::memory_order_relaxed);
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return won;
+    }
+    return true;
+  }
+
+  /// Any thread. Takes the oldest value; may fail spuriously under races.
+  bool steal(T &out) {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b)
+      return false;
+    ring *r = buffer.load(std::memory_order_acquire);
+    T value = r->get(t);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed))
+      return false;
+    out = value;
+    return true;
+  }
+
+  /// Approximate when called concurrently with other operations.
+  bool empty() const {
+    return bottom.load(std::memory_order_relaxed) <=
+           top.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct ring {
+    explicit ring(int64_t size) : size(size), slots(new std::atomic<T>[size]) {}
+    T get(int64_t i) const {
+      return slots[i & (size - 1)].load(std::memory_order_relaxed);
+    }
+    void put(int64_t i, T v) {
+      slots[i & (size - 1)].store(v, std::memory_order_relaxed);
+    }
+    const int64_t size;
+    std::unique_ptr<std::atomic<T>[]> slots;
+  };
+
+  ring *grow(ring *old, int64_t t, int64_t b) {
+    buffers.emplace_back(new ring(old->size * 2));
+    ring *r = buffers.back().get();
+    for (int64_t i = t; i < b; ++i)
+      r->put(i, old->get(i));
+    buffer.store(r, std::memory_order_release);
+    return r;
+  }
+
+  alignas(64) std::atomic<int64_t> top;
+  alignas(64) std::atomic<int64_t> bottom;
+  std::atomic<ring *> buffer;
+  /// Every buffer ever used, current last. Owner only.
+  std::vector<std::unique_ptr<ring>> buffers;
+};
+
+} // namespace utils
+} // namespace ors
+
+#endif // !__ORS_UTILS_CHASE_LEV_DEQUE_H__
@@ -2,41 +2,183 @@
 #define __ORS_UTILS_STRINGUTIL_H__
 #pragma once
 #include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <iterator>
 #include <mutex>
 #include <random>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 namespace ors {
 namespace utils {
 namespace string {
+/// Whether str is all displayable ASCII (32 to 126).
 bool printable(const char *str);
 
+/**
+ * Whether data is length - 1 displayable ASCII characters followed by a
+ * '\0'. Checks 16 bytes at a time where SSE2 is available.
+ */
 bool printable(const void *data, size_t length);
 
 std::string fmt(const char *format, ...) __attribute__((format(printf, 1, 2)));
 
+/**
+ * Like fmt(), but append to out. Once out has the capacity, this allocates
+ * nothing, so a buffer reused across calls costs no allocation at all.
+ */
+void append_fmt(std::string &out, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * Like fmt(), but format into a buffer owned by the calling thread. The
+ * result stays valid until the same thread calls fmt_view() again.
+ */
+std::string_view fmt_view(const char *format, ...)
+    __attribute__((format(printf, 1, 2)));
+
 std::string flags(int value,
                   std::initializer_list<std::pair<int, const char *>> flags);
 
-std::string trim(const std::string &s);
+std::string trim(std::string_view s);
+
+/// s without leading and trailing whitespace, without copying.
+std::string_view trim_view(std::string_view s);
 
 std::string join(const std::vector<std::string> &components,
                  const std::string &glue);
 
-std::vector<std::string> split(const std::string &subject, char delimiter);
+/**
+ * The pieces of a string between delimiters, as views into it, found one
+ * at a time as the loop advances:
+ *
+ *   for (std::string_view part : split_view(path, '/'))
+ *
+ * Same rules as split(): an empty string has no pieces, and a trailing
+ * delimiter does not start another one.
+ */
+class split_view {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string_view *;
+    using reference = const std::string_view &;
+
+    /// The end iterator.
+    iterator() : rest(), piece(), delimiter(0), done(true) {}
+
+    reference operator*() const { return piece; }
+    pointer operator->() const { return &piece; }
+
+    iterator &operator++() {
+      next();
+      return *this;
+    }
+
+    iterator operator++(int) {
+      iterator old = *this;
+      next();
+      return old;
+    }
+
+    bool operator==(const iterator &other) const {
+      return done == other.done && (done || piece.data() == other.piece.data());
+    }
+    bool operator!=(const iterator &other) const { return !(*this == other); }
+
+  private:
+    friend class split_view;
+
+    iterator(std::string_view s, char delimiter)
+        : rest(s), piece(), delimiter(delimiter), done(false) {
+      next();
+    }
+
+    void next() {
+      if (rest.empty()) {
+        done = true;
+        return;
+      }
+      size_t pos = rest.find(delimiter);
+      piece = rest.substr(0, pos);
+      rest.remove_prefix(pos == rest.npos ? rest.size() : pos + 1);
+    }
+
+    std::string_view rest;
+    std::string_view piece;
+    char delimiter;
+    bool done;
+  };
+
+  split_view(std::string_view subject, char delimiter)
+      : subject(subject), delimiter(delimiter) {}
+
+  iterator begin() const { return iterator(subject, delimiter); }
+  iterator end() const { return iterator(); }
+
+private:
+  std::string_view subject;
+  char delimiter;
+};
+
+std::vector<std::string> split(std::string_view subject, char delimiter);
 
 void replace_all(std::string &haystack, const std::string &needle,
                  const std::string &replacement);
 
-bool starts_with(const std::string &haystack, const std::string &needle);
+inline bool starts_with(std::string_view haystack, std::string_view needle) {
+  return haystack.substr(0, needle.size()) == needle;
+}
 
-bool ends_with(const std::string &haystack, const std::string &needle);
+inline bool ends_with(std::string_view haystack, std::string_view needle) {
+  return haystack.size() >= needle.size() &&
+         haystack.substr(haystack.size() - needle.size()) == needle;
+}
+
+namespace detail {
+/// Arithmetic types a stream prints as numbers: not bool, not characters.
+template <typename T>
+constexpr bool is_number =
+    std::is_arithmetic<T>::value && !std::is_same<T, bool>::value &&
+    !std::is_same<T, char>::value && !std::is_same<T, signed char>::value &&
+    !std::is_same<T, unsigned char>::value &&
+    !std::is_same<T, wchar_t>::value && !std::is_same<T, char16_t>::value &&
+    !std::is_same<T, char32_t>::value;
+} // namespace detail
+
+/**
+ * Append value to out with std::to_chars, in the form a default-formatted
+ * stream would print it (floating point as %g).
+ */
+template <typename T> void append_number(std::string &out, T value) {
+  static_assert(detail::is_number<T>, "append_number takes numbers only");
+  char buf[64];
+  std::to_chars_result r;
+  if constexpr (std::is_floating_point<T>::value)
+    r = std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::general,
+                      6);
+  else
+    r = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, r.ptr);
+}
 
+/// Numbers go through append_number(), anything else through a stream.
 template <typename T> std::string to_string(const T &t) {
-  std::stringstream ss;
-  ss << t;
-  return std::move(ss.str());
+  if constexpr (detail::is_number<T>) {
+    std::string s;
+    append_number(s, t);
+    return s;
+  } else {
+    std::stringstream ss;
+    ss << t;
+    return std::move(ss.str());
+  }
 }
 
 } // namespace string
@@ -2,14 +2,25 @@
 #define __ORS_UTILS_COND_H__
 
 #include <atomic>
+#include <cassert>
 #include <functional>
 #include <memory>
-#include <pthread.h>
 
 #include <utils/mutex.h>
 #include <utils/time.h>
 namespace ors {
 namespace utils {
+/**
+ * Condition variable on a futex, usable with std::mutex and any
+ * basic_mutex.
+ *
+ * Waiters register in a counter before sleeping, so notifying a condition
+ * variable nobody waits on makes no system call. notify_all() on waiters of
+ * an adaptive_mutex-based basic_mutex wakes one of them and requeues the
+ * rest onto the mutex, so they are released one unlock at a time instead of
+ * all racing for the lock; with std::mutex, whose futex word is private to
+ * libc, it wakes them all.
+ */
 class condition_variable {
 public:
   enum notify_type{ ONE, ALL };
@@ -21,7 +32,15 @@ public:
   void notify_one();
   void notify_all();
   void wait(std::unique_lock<std::mutex> &ul);
-  void wait(std::unique_lock<mutex> &ul);
+
+  template <typename policy, typename lockable>
+  void wait(std::unique_lock<basic_mutex<policy, lockable>> &ul) {
+    basic_mutex<policy, lockable> &mtx(*ul.mutex());
+    assert(ul);
+    mtx.wait_begin();
+    block(mtx.mtx, nullptr);
+    mtx.wait_end();
+  }
 
   // std::mutex and SteadyClock
   void wait_until(std::unique_lock<std::mutex> &ul,
@@ -31,6 +50,27 @@ public:
   template <typename clock, typename duration>
   void wait_until(std::unique_lock<std::mutex> &ul,
                   const std::chrono::time_point<clock, duration> &abs_time) {
+    wait_until(ul, to_steady(abs_time));
+  }
+
+  // basic_mutex and any clock
+  template <typename policy, typename lockable, typename clock,
+            typename duration>
+  void wait_until(std::unique_lock<basic_mutex<policy, lockable>> &ul,
+                  const std::chrono::time_point<clock, duration> &abs_time) {
+    basic_mutex<policy, lockable> &mtx(*ul.mutex());
+    assert(ul);
+    time::steady_clock::time_point wake = to_steady(abs_time);
+    last_wu = wake;
+    mtx.wait_begin();
+    block(mtx.mtx, &wake);
+    mtx.wait_end();
+  }
+
+private:
+  template <typename clock, typename duration>
+  static time::steady_clock::time_point
+  to_steady(const std::chrono::time_point<clock, duration> &abs_time) {
     std::chrono::time_point<clock, duration> now = clock::now();
     std::chrono::time_point<clock, duration> wake = abs_time;
     if (abs_time < now)
@@ -38,35 +78,35 @@ public:
     else if (abs_time > now + std::chrono::hours(1))
       wake = now + std::chrono::hours(1);
     time::steady_clock::time_point steadyNow = time::steady_clock::now();
-    time::steady_clock::time_point steadyWake = steadyNow + (wake - now);
-    wait_until(ul, steadyWake);
+    return steadyNow + (wake - now);
   }
 
-  // Core::Mutex and any clock: calls std::mutex and any clock variant
-  template <typename clock, typename duration>
-  void wait_until(std::unique_lock<mutex> &ul,
-                  const std::chrono::time_point<clock, duration> &abs_time) {
-    mutex &mtx(*ul.mutex());
-    if (mtx.cb)
-      mtx.cb();
-    assert(ul);
-    std::unique_lock<std::mutex> stdLockGuard(mtx.mtx, std::adopt_lock_t());
-    ul.release();
-    wait_until(stdLockGuard, abs_time);
-    assert(stdLockGuard);
-    ul = std::unique_lock<mutex>(mtx, std::adopt_lock_t());
-    stdLockGuard.release();
-    if (mtx.cb)
-      mtx.cb();
-  }
+  /**
+   * Release m, sleep until notified (or until *deadline, if given) and
+   * reacquire m. Instantiated for std::mutex and adaptive_mutex.
+   */
+  template <typename lockable>
+  void block(lockable &m, const time::steady_clock::time_point *deadline);
 
-private:
-  void init();
+  /// Where notify_all() may requeue waiters that hold m.
+  static std::atomic<uint32_t> *requeue_word(std::mutex &m);
+  static std::atomic<uint32_t> *requeue_word(adaptive_mutex &m);
+
+  /// Reacquire m after waking, possibly from the mutex's own queue.
+  static void relock(std::mutex &m);
+  static void relock(adaptive_mutex &m);
+
+  /// Futex word; bumped by every notify that finds waiters.
+  std::atomic<uint32_t> seq;
+
+  /// Threads between registering in block() and reacquiring their mutex.
+  std::atomic<uint32_t> waiters;
+
+  /// Lock word of the adaptive_mutex the waiters use, or nullptr.
+  std::atomic<std::atomic<uint32_t> *> requeue_to;
 
   // private:
 public:
-  pthread_cond_t cv;
-
   std::function<void()> cb;
 
 public:
@@ -77,4 +117,4 @@ public:
 } // namespace utils
 } // namespace ors
 
-#endif //!__ORS_UTILS_COND_H__
\ No newline at end of file
+#endif //!__ORS_UTILS_COND_H__
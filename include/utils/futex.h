@@ -0,0 +1,68 @@
+#ifndef __ORS_UTILS_FUTEX_H__
+#define __ORS_UTILS_FUTEX_H__
+
+#include <atomic>
+#include <cinttypes>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace ors {
+namespace utils {
+
+/**
+ * Thin wrappers around the futex(2) system call for process-private words.
+ */
+namespace futex {
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "futex words must be plain 32-bit integers");
+
+/**
+ * Sleep while *word == expected, until woken, interrupted, or timeout (a
+ * relative interval; nullptr waits forever) passes. Spurious wakeups are
+ * possible, so callers re-check their condition.
+ * \return
+ *      0 on wakeup, or -1 with errno set (EAGAIN if *word != expected,
+ *      ETIMEDOUT, EINTR).
+ */
+inline int wait(std::atomic<uint32_t> *word, uint32_t expected,
+                const struct timespec *timeout = nullptr) {
+  return int(syscall(SYS_futex, reinterpret_cast<uint32_t *>(word),
+                     FUTEX_WAIT_PRIVATE, expected, timeout, nullptr, 0));
+}
+
+/// Like wait(), with deadline absolute on CLOCK_MONOTONIC.
+inline int wait_until(std::atomic<uint32_t> *word, uint32_t expected,
+                      const struct timespec *deadline) {
+  return int(syscall(SYS_futex, reinterpret_cast<uint32_t *>(word),
+                     FUTEX_WAIT_BITSET_PRIVATE, expected, deadline, nullptr,
+                     FUTEX_BITSET_MATCH_ANY));
+}
+
+/**
+ * If *word == expected, wake up to wake waiters on word and move up to
+ * requeue more of them to wait on target instead, without waking them.
+ * \return
+ *      Waiters woken plus requeued, or -1 with errno EAGAIN if *word changed.
+ */
+inline int cmp_requeue(std::atomic<uint32_t> *word, int wake, int requeue,
+                       std::atomic<uint32_t> *target, uint32_t expected) {
+  return int(syscall(SYS_futex, reinterpret_cast<uint32_t *>(word),
+                     FUTEX_CMP_REQUEUE_PRIVATE, wake,
+                     reinterpret_cast<void *>(intptr_t(requeue)),
+                     reinterpret_cast<uint32_t *>(target), expected));
+}
+
+/// Wake up to count waiters on word; returns how many were woken.
+inline int wake(std::atomic<uint32_t> *word, int count) {
+  return int(syscall(SYS_futex, reinterpret_cast<uint32_t *>(word),
+                     FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0));
+}
+
+} // namespace futex
+} // namespace utils
+} // namespace ors
+
+#endif // !__ORS_UTILS_FUTEX_H__
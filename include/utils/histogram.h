@@ -0,0 +1,120 @@
+#ifndef __ORS_UTILS_HISTOGRAM_H__
+#define __ORS_UTILS_HISTOGRAM_H__
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <memory>
+
+#include <server_stats.pb.h>
+#include <utils/noncopyable.h>
+#include <utils/time.h>
+
+namespace ors {
+namespace utils {
+
+/**
+ * Fixed-size log-linear histogram in the style of HdrHistogram: values below
+ * 2^SUB_BITS get a bucket each, above that every power of two is split into
+ * 2^SUB_BITS equal buckets, so any uint64_t is recorded with a relative
+ * error under 1/2^SUB_BITS (about 3%) with COUNT (1920) counters, 15 KB.
+ */
+class log_linear_buckets {
+public:
+  static constexpr unsigned SUB_BITS = 5;
+
+  static constexpr size_t SUB_COUNT = size_t(1) << SUB_BITS;
+
+  static constexpr size_t COUNT = SUB_COUNT + (64 - SUB_BITS) * SUB_COUNT;
+
+  static size_t index(uint64_t value) {
+    if (value < SUB_COUNT)
+      return size_t(value);
+    unsigned msb = 63 - unsigned(__builtin_clzll(value));
+    unsigned shift = msb - SUB_BITS;
+    return SUB_COUNT + size_t(shift) * SUB_COUNT +
+           size_t((value >> shift) - SUB_COUNT);
+  }
+
+  /// Largest value that maps to bucket i.
+  static uint64_t upper_bound(size_t i) {
+    if (i < SUB_COUNT)
+      return uint64_t(i);
+    size_t shift = (i - SUB_COUNT) / SUB_COUNT;
+    uint64_t sub = (i - SUB_COUNT) % SUB_COUNT + SUB_COUNT;
+    return ((sub + 1) << shift) - 1;
+  }
+};
+
+/**
+ * Latency histogram with lock-free recording (one relaxed fetch_add per
+ * sample, plus a rare reset when a window slot is reused).
+ *
+ * Besides the counts since startup it keeps WINDOW_SLOTS slots of
+ * slot_nanos each, so update_proto() can also report the distribution over
+ * roughly the last WINDOW_SLOTS * slot_nanos. When a slot is reused,
+ * samples recorded concurrently with its reset may be lost.
+ *
+ * That is WINDOW_SLOTS + 1 sets of counters, about 170 KB per histogram:
+ * keep one per operation type, not one per client or connection.
+ *
+ * record(value) timestamps the sample with coarse_clock, which is cheaper
+ * than steady_clock and precise enough to pick a slot; callers that already
+ * have the time should pass it in.
+ */
+class histogram : public noncopyable {
+public:
+  static constexpr size_t WINDOW_SLOTS = 10;
+
+  explicit histogram(std::chrono::nanoseconds slot_nanos =
+                         std::chrono::seconds(1));
+
+  ~histogram();
+
+  void record(uint64_t value);
+
+  void record(uint64_t value, time::steady_clock::time_point now);
+
+  void record(std::chrono::nanoseconds value) {
+    record(uint64_t(std::max<int64_t>(value.count(), 0)));
+  }
+
+  /// Fill in both the total and the windowed distribution.
+  void update_proto(proto::LatencyStat &out) const;
+
+  uint64_t count() const;
+
+  /// Value at quantile q (0..1) of everything recorded, within bucket error.
+  uint64_t quantile(double q) const;
+
+private:
+  struct counts {
+    counts();
+    void clear();
+    std::array<std::atomic<uint64_t>, log_linear_buckets::COUNT> buckets;
+  };
+
+  struct slot {
+    slot();
+    /// Which slot_nanos-sized interval since the epoch this slot holds.
+    std::atomic<uint64_t> epoch;
+    counts data;
+  };
+
+  const int64_t slot_nanos;
+
+  counts total;
+
+  std::unique_ptr<slot[]> window;
+};
+
+/// Fill out from merged bucket counts; window_nanos 0 means since startup.
+void fill_histogram(const uint64_t *buckets, int64_t window_nanos,
+                    proto::Histogram &out);
+
+} // namespace utils
+} // namespace ors
+
+#endif // !__ORS_UTILS_HISTOGRAM_H__
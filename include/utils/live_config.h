@@ -0,0 +1,165 @@
+#ifndef __ORS_UTILS_LIVE_CONFIG_H__
+#define __ORS_UTILS_LIVE_CONFIG_H__
+
+#include <atomic>
+#include <cinttypes>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <utils/config.h>
+#include <utils/mutex.h>
+#include <utils/noncopyable.h>
+
+namespace ors {
+namespace utils {
+
+/**
+ * A config file parsed once into typed values that hot paths read with a
+ * single relaxed atomic load, instead of config::read<T>()'s map lookup and
+ * stream parse on every call. reload() re-reads the file and republishes
+ * the values; watch() does so whenever the file changes, so operators can
+ * retune a running server by editing its config.
+ *
+ *   live_config cfg("/etc/ors.conf");
+ *   auto max_batch = cfg.integer("max_batch", 1024);
+ *   auto timeout = cfg.duration("election_timeout", "150ms");
+ *   cfg.watch();
+ *   ...
+ *   if (n > max_batch.get()) ...
+ *
+ * A reload that fails to read the file or to parse any registered key
+ * changes nothing: a typo never leaves half the new values in effect.
+ * Values are published one by one, so a reader may briefly see a mix of
+ * old and new values for different keys.
+ */
+class live_config : public noncopyable {
+  struct entry;
+
+public:
+  enum type { INTEGER, DURATION, BOOLEAN };
+
+  /// A registered key. Cheap to copy; valid as long as its live_config.
+  template <typename T> class handle {
+  public:
+    handle() : e(nullptr) {}
+
+    T get() const { return T(e->value.load(std::memory_order_relaxed)); }
+
+  private:
+    friend class live_config;
+    explicit handle(const entry *e) : e(e) {}
+    const entry *e;
+  };
+
+  /// Durations in nanoseconds.
+  class duration_handle : public handle<uint64_t> {
+  public:
+    duration_handle() : handle() {}
+    uint64_t nanos() const { return get(); }
+    std::chrono::nanoseconds chrono() const {
+      return std::chrono::nanoseconds(get());
+    }
+
+  private:
+    friend class live_config;
+    explicit duration_handle(handle<uint64_t> h) : handle(h) {}
+  };
+
+  /**
+   * Read filename. Throws config::file_not_found if it cannot be opened.
+   */
+  explicit live_config(const std::string &filename);
+
+  /// Stops the watcher, if any.
+  ~live_config();
+
+  /**
+   * Register key and parse its current value, or use default_value if the
+   * file does not set it. Registering a key again returns the same handle;
+   * registering it as a different type throws config::exception, and a
+   * value that does not parse throws config::conversion_error.
+   */
+  handle<int64_t> integer(const std::string &key, int64_t default_value);
+
+  /// As integer(); values are utils::time::parse() descriptions ("10ms").
+  duration_handle duration(const std::string &key,
+                           const std::string &default_value);
+
+  /// As integer(); values as config::read<bool>() accepts them.
+  handle<bool> boolean(const std::string &key, bool default_value);
+
+  /**
+   * Re-read the file and republish every registered value, then run the
+   * on_reload() callbacks.
+   * \return
+   *      "" on success, or why nothing was changed.
+   */
+  std::string reload();
+
+  /**
+   * Call fn after every successful reload, on the reloading thread; for
+   * components that take settings through a setter rather than a handle.
+   */
+  void on_reload(std::function<void()> fn);
+
+  /**
+   * Start a thread that reloads whenever the file is written or replaced
+   * (editors often save by renaming a new file over the old one, so it
+   * watches the directory with inotify). Throws config::exception if
+   * inotify is unavailable.
+   */
+  void watch();
+
+  /// Stop the watcher thread started by watch().
+  void stop();
+
+  /// Successful and failed reloads since construction.
+  uint64_t num_reloads() const { return reloads.load(); }
+  uint64_t num_failed_reloads() const { return failed_reloads.load(); }
+
+private:
+  struct entry {
+    type t;
+    std::string default_value;
+    std::atomic<uint64_t> value;
+  };
+
+  /// Register key or check that it was registered with type t.
+  const entry *add(const std::string &key, type t,
+                   const std::string &default_value);
+
+  /// Parse the value for e from c, or throw config::exception.
+  static uint64_t parse(const config &c, const std::string &key,
+                        const entry &e);
+
+  void watcher_main(int inotify_fd);
+
+  const std::string filename;
+
+  /// Serializes registration and reloads; readers never take it.
+  utils::mutex mtx;
+
+  /// The file as last read successfully.
+  config current;
+
+  /// Entries never move or go away while the live_config exists.
+  std::map<std::string, std::unique_ptr<entry>> entries;
+
+  std::vector<std::function<void()>> callbacks;
+
+  std::atomic<uint64_t> reloads;
+  std::atomic<uint64_t> failed_reloads;
+
+  /// Written to wake the watcher so that it exits; -1 when not watching.
+  int stop_fd;
+  std::thread watcher;
+};
+
+} // namespace utils
+} // namespace ors
+
+#endif // !__ORS_UTILS_LIVE_CONFIG_H__
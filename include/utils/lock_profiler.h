@@ -0,0 +1,53 @@
+#ifndef __ORS_UTILS_LOCK_PROFILER_H__
+#define __ORS_UTILS_LOCK_PROFILER_H__
+
+#include <atomic>
+#include <cinttypes>
+
+#include <server_stats.pb.h>
+
+namespace ors {
+namespace utils {
+
+/**
+ * Contention profiling for utils::mutex.
+ *
+ * Mutexes are grouped into sites by the name given to their constructor
+ * (unnamed ones share one site). While profiling is enabled, each
+ * lock()/unlock() pair reads rdtsc() twice or three times and adds its wait
+ * time, hold time and whether it had to wait to the calling thread's
+ * counters for that site; no shared cache line is written. Disabled, the
+ * cost is one relaxed load per lock().
+ *
+ * Results are merged on demand into ServerStats.locks and are switched on
+ * and off with the LockProfileSet control RPC.
+ */
+namespace lock_profiler {
+
+namespace detail {
+extern std::atomic<bool> _enabled;
+} // namespace detail
+
+inline bool enabled() {
+  return detail::_enabled.load(std::memory_order_relaxed);
+}
+
+void enable(bool on);
+
+/// Drop all counts collected so far.
+void reset();
+
+/// Dense id for a site name; the same name always gets the same id.
+uint32_t site_id(const char *name);
+
+/// Called by utils::mutex on release of a profiled acquisition.
+void record(uint32_t site, uint64_t wait_ticks, uint64_t hold_ticks,
+            bool contended);
+
+void update_server_stats(proto::ServerStats::Locks &locks);
+
+} // namespace lock_profiler
+} // namespace utils
+} // namespace ors
+
+#endif // !__ORS_UTILS_LOCK_PROFILER_H__
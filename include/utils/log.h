@@ -0,0 +1,274 @@
+#ifndef __ORS_UTILS_LOG_H__
+#define __ORS_UTILS_LOG_H__
+
+#include <atomic>
+#include <cinttypes>
+#include <iosfwd>
+#include <new>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <spdlog/fmt/fmt.h>
+#include <utils/tid.h>
+#include <utils/time.h>
+
+/**
+ * \file
+ * Project logging facade.
+ *
+ * ORS_ERROR("could not open {}: {}", path, strerror(errno));
+ *
+ * Formats use fmt syntax ("{}"). A call site whose level is disabled costs
+ * one relaxed load. An enabled one copies its arguments into a ring owned by
+ * the calling thread; a background thread formats the records and writes
+ * them to the log file (stderr by default), so the caller never formats,
+ * takes a lock, or makes a system call. If a thread's ring is full, its
+ * records are dropped and counted rather than blocking the caller.
+ *
+ * With encoding::BINARY the writer does not format at all: each call site's
+ * file, line, level and format string are written once per log file, and
+ * each record is just the site's id, an rdtsc() timestamp, the thread id and
+ * the raw arguments. decode() (and the log_decode tool) renders such a file
+ * as the same text the TEXT encoding would have produced.
+ *
+ * Verbosity is set per source file with a policy string such as
+ * "src/storage@VERBOSE,src/utils/cond.cc@ERROR,NOTICE": the first pattern
+ * that is a prefix of a file's path (relative to src/) decides its level,
+ * and a trailing level without a pattern is the default. This is the format
+ * used by the DebugPolicyGet/DebugPolicySet control RPCs.
+ */
+
+namespace ors {
+namespace utils {
+namespace log {
+
+enum class level : uint8_t {
+  SILENT = 0,
+  ERROR = 10,
+  WARNING = 20,
+  NOTICE = 30,
+  VERBOSE = 40,
+};
+
+const char *level_name(level l);
+
+/// Throws std::invalid_argument for unknown names.
+level level_from_string(const std::string &name);
+
+/// Current verbosity of one source file; read by every call site in it.
+using module_level = std::atomic<uint8_t>;
+
+/// Look up (registering on first use) the verbosity of a source file.
+module_level &module(const char *file);
+
+void set_policy(const std::string &policy);
+
+std::string policy();
+
+/// Log to the given file (appending), or to stderr if empty.
+void set_filename(const std::string &filename);
+
+std::string filename();
+
+/// Reopen the log file, e.g. after it was moved by logrotate.
+void reopen();
+
+/// Block until every record logged before the call has been written.
+void flush();
+
+/// Records dropped because a thread's ring was full.
+uint64_t num_dropped();
+
+enum class encoding {
+  TEXT,
+  BINARY,
+};
+
+/// Takes effect for records written after the call; flushes first.
+void set_encoding(encoding e);
+
+encoding current_encoding();
+
+/**
+ * Render a log written with encoding::BINARY as text.
+ * \return
+ *      An error message, or the empty string on success.
+ */
+std::string decode(std::istream &in, std::ostream &out);
+
+namespace detail {
+
+/// Static description of one call site, registered the first time it runs.
+struct site {
+  site(level lvl, const char *file, uint32_t line, const char *function,
+       const char *format);
+  const level lvl;
+  const char *const file;
+  const uint32_t line;
+  const char *const function;
+  const char *const format;
+  /// Verbosity of the site's source file.
+  module_level &enabled;
+  /// Dense, process-wide; identifies the site in binary logs.
+  const uint32_t id;
+};
+
+struct record {
+  /// Bytes taken in the ring, including this header and the arguments.
+  uint32_t size;
+  const site *where;
+  uint64_t tsc;
+  uint64_t tid;
+  /**
+   * Formats (TEXT) or serializes (BINARY) the arguments stored after this
+   * header into out and destroys them. nullptr marks padding at the end of
+   * the ring.
+   */
+  void (*render)(record *r, encoding e, fmt::memory_buffer &out);
+};
+
+constexpr size_t ALIGN = 16;
+
+constexpr size_t header_bytes() {
+  return (sizeof(record) + ALIGN - 1) & ~(ALIGN - 1);
+}
+
+/// Space for size bytes in this thread's ring, or nullptr if it is full.
+record *reserve(size_t size);
+
+/// Publish the record returned by the last reserve().
+void commit(record *r);
+
+/// Argument types in binary logs.
+enum arg_tag : uint8_t {
+  ARG_INT = 1,
+  ARG_UINT = 2,
+  ARG_DOUBLE = 3,
+  ARG_BOOL = 4,
+  ARG_CHAR = 5,
+  ARG_STRING = 6,
+};
+
+void put_varint(fmt::memory_buffer &out, uint64_t v);
+
+void put_string(fmt::memory_buffer &out, std::string_view s);
+
+template <typename T> void encode(fmt::memory_buffer &out, const T &v) {
+  if constexpr (std::is_same<T, bool>::value) {
+    out.push_back(char(ARG_BOOL));
+    out.push_back(char(v));
+  } else if constexpr (std::is_same<T, char>::value) {
+    out.push_back(char(ARG_CHAR));
+    out.push_back(v);
+  } else if constexpr (std::is_integral<T>::value &&
+                       std::is_signed<T>::value) {
+    out.push_back(char(ARG_INT));
+    int64_t i = int64_t(v);
+    put_varint(out, (uint64_t(i) << 1) ^ uint64_t(i >> 63)); // zigzag
+  } else if constexpr (std::is_integral<T>::value) {
+    out.push_back(char(ARG_UINT));
+    put_varint(out, uint64_t(v));
+  } else if constexpr (std::is_floating_point<T>::value) {
+    out.push_back(char(ARG_DOUBLE));
+    double d = double(v);
+    out.append(reinterpret_cast<const char *>(&d),
+               reinterpret_cast<const char *>(&d) + sizeof(d));
+  } else if constexpr (std::is_convertible<const T &,
+                                           std::string_view>::value) {
+    out.push_back(char(ARG_STRING));
+    put_string(out, std::string_view(v));
+  } else {
+    // no raw form: ship the text
+    out.push_back(char(ARG_STRING));
+    put_string(out, fmt::format("{}", v));
+  }
+}
+
+/**
+ * Strings are copied: pointers and views (string_view, fmt_view(), char
+ * arrays) may not outlive the call, and arguments are formatted later on
+ * the writer thread.
+ */
+template <typename T> struct stored {
+  using decayed = typename std::decay<T>::type;
+  using type = typename std::conditional<
+      std::is_convertible<const decayed &, std::string_view>::value &&
+          !std::is_same<decayed, std::string>::value,
+      std::string, decayed>::type;
+};
+
+template <typename Tuple, size_t... I>
+void format_tuple(const char *format, Tuple &args, fmt::memory_buffer &out,
+                  std::index_sequence<I...>) {
+  fmt::vformat_to(std::back_inserter(out), format,
+                  fmt::make_format_args(std::get<I>(args)...));
+}
+
+template <typename Tuple, size_t... I>
+void encode_tuple(const Tuple &args, fmt::memory_buffer &out,
+                  std::index_sequence<I...>) {
+  put_varint(out, sizeof...(I));
+  (encode(out, std::get<I>(args)), ...);
+}
+
+template <typename Tuple>
+void render(record *r, encoding e, fmt::memory_buffer &out) {
+  Tuple *args = reinterpret_cast<Tuple *>(reinterpret_cast<char *>(r) +
+                                          header_bytes());
+  auto indices = std::make_index_sequence<std::tuple_size<Tuple>::value>();
+  if (e == encoding::BINARY) {
+    encode_tuple(*args, out, indices);
+  } else {
+    try {
+      format_tuple(r->where->format, *args, out, indices);
+    } catch (const std::exception &ex) {
+      out.append(std::string("<bad log format: ") + ex.what() + ">");
+    }
+  }
+  args->~Tuple();
+}
+
+template <typename... Args> void write(const site &where, Args &&...args) {
+  using tuple = std::tuple<typename stored<Args>::type...>;
+  static_assert(alignof(tuple) <= ALIGN, "over-aligned log argument");
+  record *r = reserve(header_bytes() + sizeof(tuple));
+  if (r == nullptr)
+    return;
+  r->where = &where;
+  r->tsc = time::rdtsc();
+  r->tid = tid::tid();
+  r->render = &render<tuple>;
+  new (reinterpret_cast<char *>(r) + header_bytes())
+      tuple(std::forward<Args>(args)...);
+  commit(r);
+}
+
+} // namespace detail
+} // namespace log
+} // namespace utils
+} // namespace ors
+
+#define ORS_LOG(lvl, format, ...)                                              \
+  do {                                                                         \
+    static const ::ors::utils::log::detail::site _ors_log_site(                \
+        lvl, __FILE__, __LINE__, __func__, format);                            \
+    if (_ors_log_site.enabled.load(std::memory_order_relaxed) >= uint8_t(lvl)) \
+      ::ors::utils::log::detail::write(_ors_log_site, ##__VA_ARGS__);          \
+  } while (0)
+
+#define ORS_ERROR(format, ...)                                                 \
+  ORS_LOG(::ors::utils::log::level::ERROR, format, ##__VA_ARGS__)
+
+#define ORS_WARNING(format, ...)                                               \
+  ORS_LOG(::ors::utils::log::level::WARNING, format, ##__VA_ARGS__)
+
+#define ORS_NOTICE(format, ...)                                                \
+  ORS_LOG(::ors::utils::log::level::NOTICE, format, ##__VA_ARGS__)
+
+#define ORS_VERBOSE(format, ...)                                               \
+  ORS_LOG(::ors::utils::log::level::VERBOSE, format, ##__VA_ARGS__)
+
+#endif // !__ORS_UTILS_LOG_H__
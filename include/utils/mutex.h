@@ -1,55 +1,247 @@
 #ifndef __ORS_MUTEX_H__
 #define __ORS_MUTEX_H__
 
+#include <atomic>
 #include <cassert>
+#include <cinttypes>
 #include <functional>
 #include <mutex>
+
+#include <utils/lock_profiler.h>
+#include <utils/noncopyable.h>
+#include <utils/time.h>
 namespace ors {
 namespace utils {
-class mutex {
-public:
-// 
-  mutex() : mtx(), cb() {}
+/**
+ * Hooks run by basic_mutex, chosen at compile time so that a mutex pays only
+ * for what it uses. A policy wraps acquisition and release of the underlying
+ * lock and is told when a condition_variable wait releases and reacquires
+ * it. Every policy can be constructed from a site name (see lock_profiler),
+ * which the others ignore, so a mutex's policy can change without touching
+ * its owners.
+ */
+namespace mutex_policy {
 
-  void lock() {
-    mtx.lock();
+/// No hooks: basic_mutex<none> is just the underlying lock.
+struct none {
+  none() {}
+  explicit none(const char *) {}
+
+  template <typename lockable> void acquire(lockable &m) { m.lock(); }
+  template <typename lockable> bool try_acquire(lockable &m) {
+    return m.try_lock();
+  }
+  template <typename lockable> void release(lockable &m) { m.unlock(); }
+  void wait_begin() {}
+  void wait_end() {}
+};
+
+/**
+ * Calls cb with the lock held after every acquisition and before every
+ * release, including those done by condition_variable waits. For tests.
+ */
+struct test_hook {
+  test_hook() : cb() {}
+  explicit test_hook(const char *) : cb() {}
+
+  template <typename lockable> void acquire(lockable &m) {
+    m.lock();
     if (cb)
       cb();
   }
-
-  bool try_lock() {
-    bool l = mtx.try_lock();
-    if (l) {
-      if (cb)
-        cb();
-    }
+  template <typename lockable> bool try_acquire(lockable &m) {
+    bool l = m.try_lock();
+    if (l && cb)
+      cb();
     return l;
   }
-
-  void unlock() {
+  template <typename lockable> void release(lockable &m) {
     // TODO(ongardie): apparently try_lock->false...unlock is allowed, but
     // this will then call the callback without the lock, which is unsafe.
     if (cb)
       cb();
-    mtx.unlock();
+    m.unlock();
+  }
+  void wait_begin() {
+    if (cb)
+      cb();
+  }
+  void wait_end() {
+    if (cb)
+      cb();
   }
-    // HANDLE(windows) or pthread_mutex_t(Linux)
-  std::mutex::native_handle_type native_handle() { return mtx.native_handle(); }
 
-private:
-  /// Underlying mutex.
-  ::std::mutex mtx;
+  std::function<void()> cb;
+};
+
+/**
+ * Reports wait and hold times to lock_profiler while it is enabled; one
+ * relaxed load per acquisition otherwise.
+ */
+struct profiled {
+  profiled() : site(0), locked_tsc(0), wait_ticks(0), contended(false) {}
+  /// name groups mutexes for lock_profiler, e.g. "batch_applier".
+  explicit profiled(const char *name)
+      : site(lock_profiler::site_id(name)), locked_tsc(0), wait_ticks(0),
+        contended(false) {}
+
+  template <typename lockable> void acquire(lockable &m) {
+    if (!lock_profiler::enabled()) {
+      m.lock();
+      return;
+    }
+    uint64_t start = time::rdtsc();
+    bool waited = !m.try_lock();
+    if (waited)
+      m.lock();
+    // the members are only written once the lock is held
+    locked_tsc = time::rdtsc();
+    wait_ticks = locked_tsc - start;
+    contended = waited;
+  }
+  template <typename lockable> bool try_acquire(lockable &m) {
+    bool l = m.try_lock();
+    if (l && lock_profiler::enabled())
+      wait_end();
+    return l;
+  }
+  template <typename lockable> void release(lockable &m) {
+    wait_begin();
+    m.unlock();
+  }
+  /// End the current hold.
+  void wait_begin() {
+    // zero if profiling was off when the lock was taken
+    if (locked_tsc != 0) {
+      lock_profiler::record(site, wait_ticks, time::rdtsc() - locked_tsc,
+                            contended);
+      locked_tsc = 0;
+    }
+  }
+  /// Start a hold that did not wait.
+  void wait_end() {
+    if (!lock_profiler::enabled())
+      return;
+    locked_tsc = time::rdtsc();
+    wait_ticks = 0;
+    contended = false;
+  }
+
+  /// lock_profiler site; 0 for unnamed mutexes.
+  uint32_t site;
+  // State of the current profiled hold; guarded by the mutex itself.
+  uint64_t locked_tsc;
+  uint64_t wait_ticks;
+  bool contended;
+};
 
+} // namespace mutex_policy
+
+/**
+ * Futex-based mutex that spins briefly before sleeping. The spin budget
+ * adapts to how long recent acquisitions took to succeed, as glibc's
+ * PTHREAD_MUTEX_ADAPTIVE_NP does, and is skipped on single-CPU machines where
+ * the holder cannot run while we spin. Only 4 bytes of lock word (plus the
+ * estimate), versus 40 for std::mutex.
+ */
+class adaptive_mutex : public noncopyable {
 public:
+  /// Upper bound on spin iterations before parking.
+  static constexpr int16_t MAX_SPINS = 100;
+
+  adaptive_mutex() : state(UNLOCKED), spins(0) {}
+
+  void lock() {
+    uint32_t c = UNLOCKED;
+    if (!state.compare_exchange_strong(c, LOCKED, std::memory_order_acquire,
+                                       std::memory_order_relaxed))
+      lock_slow();
+  }
+
+  bool try_lock() {
+    uint32_t c = UNLOCKED;
+    return state.compare_exchange_strong(c, LOCKED, std::memory_order_acquire,
+                                         std::memory_order_relaxed);
+  }
+
+  void unlock() {
+    if (state.exchange(UNLOCKED, std::memory_order_release) == CONTENDED)
+      wake();
+  }
+
+private:
+  enum : uint32_t {
+    UNLOCKED = 0,
+    LOCKED = 1,
+    /// Locked, and a thread may be sleeping on the futex.
+    CONTENDED = 2,
+  };
+
+  void lock_slow();
+
+  /// Sleep until the lock is ours, leaving it marked CONTENDED.
+  void lock_contended();
+
+  void wake();
+
+  std::atomic<uint32_t> state;
+
   /**
-   * This function will be called with the lock held after the lock is
-   * acquired and before it is released.
+   * Moving estimate of spins needed. Only a hint: threads read and update
+   * it with relaxed accesses, with or without the lock, and lost updates
+   * are fine.
    */
-  std::function<void()> cb;
+  std::atomic<int16_t> spins;
 
+  /// Requeues waiters onto state and relocks with lock_contended().
   friend class condition_variable;
 };
 
+/**
+ * Mutex whose instrumentation is a compile-time policy (see mutex_policy)
+ * wrapping an underlying lockable, std::mutex by default. Meets the standard
+ * Lockable requirements; with std::mutex underneath it also works with
+ * utils::condition_variable.
+ */
+template <typename policy, typename lockable = std::mutex>
+class basic_mutex : public policy {
+public:
+  basic_mutex() : policy(), mtx() {}
+
+  explicit basic_mutex(const char *name) : policy(name), mtx() {}
+
+  basic_mutex(const basic_mutex &) = delete;
+  basic_mutex &operator=(const basic_mutex &) = delete;
+
+  void lock() { policy::acquire(mtx); }
+
+  bool try_lock() { return policy::try_acquire(mtx); }
+
+  void unlock() { policy::release(mtx); }
+
+  // HANDLE(windows) or pthread_mutex_t(Linux)
+  template <typename l = lockable>
+  typename l::native_handle_type native_handle() {
+    return mtx.native_handle();
+  }
+
+private:
+  /// Underlying mutex.
+  lockable mtx;
+
+  friend class condition_variable;
+};
+
+/**
+ * The project's mutex: profiled unless built with ORS_MUTEX_NO_PROFILING.
+ * Tests that need the old cb hook use basic_mutex<mutex_policy::test_hook>.
+ */
+#ifdef ORS_MUTEX_NO_PROFILING
+using mutex = basic_mutex<mutex_policy::none>;
+#else
+using mutex = basic_mutex<mutex_policy::profiled>;
+#endif
+
 /**
  * Release a mutex upon construction, reacquires it upon destruction.
  * \tparam mutex
@@ -1,71 +1,132 @@
 #ifndef __ORS_UTILS_RAND_H__
 #define __ORS_UTILS_RAND_H__
 #include <cinttypes>
-#include <mutex>
-#include <random>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <utility>
 
 namespace ors {
 namespace utils {
 namespace rand {
 
+/**
+ * Fork handlers, installed by pthread_atfork: acquire_mutex() in the
+ * prepare stage, release_mutex() in the parent and reset_random_state() in
+ * the child, which gives every thread of the child a fresh seed.
+ */
 void acquire_mutex();
 void release_mutex();
 void reset_random_state();
 
-class prng {
+/**
+ * xoshiro256** (Blackman and Vigna): 256 bits of state, period 2^256 - 1,
+ * and a few cycles per number. Not cryptographic. Satisfies
+ * UniformRandomBitGenerator, so it also works with <random> and
+ * std::shuffle.
+ */
+class xoshiro256 {
 public:
-  prng();
-
-  ~prng();
-
-  void set_distribution(uint64_t begin, uint64_t end);
-
-  void reset_seed();
-
-  uint64_t random64();
-
-  std::mutex &mutex();
-
-  friend void acquire_mutex();
-  friend void acquire_mutex();
-  friend void reset_random_state();
+  using result_type = uint64_t;
+
+  xoshiro256() : s{1, 0, 0, 0} {}
+  explicit xoshiro256(uint64_t seed) : s() { this->seed(seed); }
+
+  /// Expand seed into the full state with splitmix64, as the authors advise.
+  void seed(uint64_t seed) {
+    for (auto &w : s) {
+      uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      w = z ^ (z >> 31);
+    }
+  }
+
+  uint64_t operator()() {
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+  }
+
+  /**
+   * Uniform in [0, n), n > 0, without modulo bias (Lemire, "Fast Random
+   * Integer Generation in an Interval", 2019): one multiply, and a division
+   * only on the rare draws that land in the biased zone.
+   */
+  uint64_t bounded(uint64_t n) {
+    __uint128_t m = __uint128_t((*this)()) * n;
+    uint64_t low = uint64_t(m);
+    if (low < n) {
+      uint64_t threshold = -n % n;
+      while (low < threshold) {
+        m = __uint128_t((*this)()) * n;
+        low = uint64_t(m);
+      }
+    }
+    return uint64_t(m >> 64);
+  }
+
+  static constexpr uint64_t min() { return 0; }
+  static constexpr uint64_t max() {
+    return std::numeric_limits<uint64_t>::max();
+  }
 
 private:
-  std::mutex mtx;
-
-  std::mt19937_64 mt64;
+  static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
 
-  std::uniform_int_distribution<uint64_t> distribution;
+  uint64_t s[4];
 };
 
-uint8_t random8();
+/**
+ * The calling thread's generator, seeded from /dev/urandom on first use
+ * and again after fork(). Callers on different threads share nothing.
+ */
+xoshiro256 &generator();
 
-uint16_t random16();
+inline uint64_t random64() { return generator()(); }
 
-uint32_t random32();
+inline uint8_t random8() { return uint8_t(random64() >> 56); }
 
-uint64_t random64();
+inline uint16_t random16() { return uint16_t(random64() >> 48); }
 
-double random_decimal();
+inline uint32_t random32() { return uint32_t(random64() >> 32); }
 
-uint64_t random_range(uint64_t begin, uint64_t end);
+/// Uniform in [0, 1), with 53 random bits.
+inline double random_decimal() { return double(random64() >> 11) * 0x1.0p-53; }
+
+/// Uniform in [min(begin, end), max(begin, end)], both ends included.
+inline uint64_t random_range(uint64_t begin, uint64_t end) {
+  if (end < begin)
+    std::swap(begin, end);
+  uint64_t span = end - begin + 1;
+  if (span == 0) // the whole 64-bit range
+    return random64();
+  return begin + generator().bounded(span);
+}
 
 #ifndef __ORS_COMMON_RAND__
 #define __ORS_COMMON_RAND__
+/// Integers: inclusive and unbiased. Floating point: in [begin, end).
 template <typename T> T random_range(T begin, T end) {
-  return T(lround(begin + random_decimal() * (end - begin)));
-}
-
-template <> inline double random_range(double begin, double end) {
-  return begin + random_decimal() * (end - begin);
-}
-
-template <> inline float random_range(float begin, float end) {
-  return begin + random_decimal() * (end - begin);
+  if constexpr (std::is_integral<T>::value) {
+    using U = typename std::make_unsigned<T>::type;
+    if (end < begin)
+      std::swap(begin, end);
+    U span = U(U(end) - U(begin));
+    return T(U(begin) + U(random_range(uint64_t(0), uint64_t(span))));
+  } else {
+    return T(begin + random_decimal() * (end - begin));
+  }
 }
 #endif
 } // namespace rand
 } // namespace utils
 } // namespace ors
 
-#endif
\ No newline at end of file
+#endif
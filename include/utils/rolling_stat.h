@@ -0,0 +1,108 @@
+#ifndef __ORS_UTILS_ROLLING_STAT_H__
+#define __ORS_UTILS_ROLLING_STAT_H__
+
+#include <atomic>
+#include <cinttypes>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <server_stats.pb.h>
+#include <utils/noncopyable.h>
+#include <utils/time.h>
+
+namespace ors {
+namespace utils {
+
+/**
+ * Collects count, sum, min, max, mean, standard deviation and exponentially
+ * weighted moving averages of a stream of samples, serialized as
+ * proto::RollingStat.
+ *
+ * push() only touches a shard owned by the calling thread, padded to its
+ * own cache line: no lock, no read-modify-write on shared memory. Shards
+ * are merged when update_proto() is called, e.g. for ServerStatsGet. Since
+ * shards are read while their owners keep writing, a merged snapshot may be
+ * off by the samples in flight, which is fine for statistics.
+ *
+ * The moving averages are kept per thread and merged weighted by each
+ * thread's sample count.
+ */
+class rolling_stat : public noncopyable {
+public:
+  /// Number of exceptional samples reported in last_exceptional.
+  static constexpr size_t MAX_EXCEPTIONAL = 5;
+
+  rolling_stat();
+
+  ~rolling_stat();
+
+  /// Record a sample. Hot path.
+  void push(uint64_t value);
+
+  /**
+   * Record a sample that is noteworthy on its own, e.g. an fsync that took
+   * seconds. It is also pushed as a regular sample. Takes a lock.
+   */
+  void note_exceptional(time::system_clock::time_point when, uint64_t value);
+
+  /// Merge all threads' samples into out.
+  void update_proto(proto::RollingStat &out) const;
+
+  /// Number of samples so far, summed across threads.
+  uint64_t count() const;
+
+private:
+  struct alignas(64) shard {
+    shard();
+    // Written only by the owning thread; relaxed atomics just make the
+    // concurrent reads in update_proto() well-defined.
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<double> sum_squares;
+    std::atomic<uint64_t> min;
+    std::atomic<uint64_t> max;
+    std::atomic<uint64_t> last;
+    /// rdtsc() of the last sample, to pick the most recent across threads.
+    std::atomic<uint64_t> last_tsc;
+    std::atomic<double> ewma2;
+    std::atomic<double> ewma4;
+  };
+
+  struct exceptional {
+    int64_t when;
+    uint64_t value;
+  };
+
+  /// This thread's shard, registering one on first use.
+  shard &local();
+
+  shard &register_thread();
+
+  /**
+   * Index into each thread's shard cache. Recycled when the instance is
+   * destroyed, so the caches stay as small as the number of live stats.
+   */
+  const uint64_t id;
+
+  /// Unique per instance: tells this stat's cache entries from those left
+  /// behind by an earlier instance with the same id.
+  const uint64_t generation;
+
+  mutable std::mutex mtx;
+
+  /// All shards ever registered, owned here. Guarded by mtx.
+  std::vector<std::unique_ptr<shard>> shards;
+
+  /// Most recent exceptional samples, oldest first. Guarded by mtx.
+  std::deque<exceptional> last_exceptional;
+
+  /// Guarded by mtx.
+  uint64_t exceptional_count;
+};
+
+} // namespace utils
+} // namespace ors
+
+#endif // !__ORS_UTILS_ROLLING_STAT_H__
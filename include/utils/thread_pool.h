@@ -0,0 +1,130 @@
+#ifndef __ORS_UTILS_THREAD_POOL_H__
+#define __ORS_UTILS_THREAD_POOL_H__
+
+#include <atomic>
+#include <cinttypes>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <utils/chase_lev_deque.h>
+#include <utils/cond.h>
+#include <utils/mutex.h>
+#include <utils/noncopyable.h>
+
+namespace ors {
+namespace utils {
+
+/**
+ * Work-stealing executor for CPU-bound tasks such as parsing AppendEntries,
+ * checksumming or serializing snapshot blocks.
+ *
+ * Each worker owns a chase_lev_deque. Tasks submitted from a worker go onto
+ * its own deque and are run LIFO, which keeps recursive fan-out cache-warm;
+ * tasks submitted from other threads go onto a shared injection queue. An
+ * idle worker takes from its deque, then the injection queue, then steals
+ * the oldest task of another worker, and parks only when all are empty.
+ * Submitting costs no syscall unless a worker is parked.
+ *
+ * Workers are named "<name>-<i>" (see utils::tid) and can optionally be
+ * pinned to CPU i modulo the number of CPUs.
+ */
+class thread_pool : public noncopyable {
+public:
+  /**
+   * \param threads
+   *      Number of workers; 0 means one per CPU.
+   */
+  explicit thread_pool(size_t threads = 0, const std::string &name = "pool",
+                       bool pin = false);
+
+  /// Runs every task already submitted, then joins the workers.
+  ~thread_pool();
+
+  /// Run fn on some worker. Exceptions it throws are logged and dropped.
+  void submit(std::function<void()> fn);
+
+  /// Run fn on some worker; its result or exception goes to the future.
+  template <typename F> auto async(F &&fn) -> std::future<decltype(fn())> {
+    using result = decltype(fn());
+    auto task =
+        std::make_shared<std::packaged_task<result()>>(std::forward<F>(fn));
+    std::future<result> f = task->get_future();
+    submit([task] { (*task)(); });
+    return f;
+  }
+
+  /**
+   * Block until every submitted task, including those submitted by tasks,
+   * has finished. Must not be called from a worker.
+   */
+  void wait_idle();
+
+  size_t size() const { return workers.size(); }
+
+  /// Index of the calling thread in this pool, or -1 if it is not a worker.
+  int current_worker() const;
+
+  uint64_t num_steals() const { return steals.load(std::memory_order_relaxed); }
+
+private:
+  using task = std::function<void()>;
+
+  struct worker {
+    worker() : deque(), thread() {}
+    chase_lev_deque<task *> deque;
+    std::thread thread;
+  };
+
+  void main(size_t index, bool pin);
+
+  /**
+   * Next task for worker index, or nullptr if every queue looks empty.
+   * \param locked
+   *      Whether the caller already holds mtx.
+   */
+  task *find_task(size_t index, uint64_t &rng, bool locked);
+
+  void run(task *t);
+
+  /// Wake one parked worker, if any.
+  void wake_one();
+
+  const std::string name;
+
+  std::vector<std::unique_ptr<worker>> workers;
+
+  /// Guards injected, exiting and the parking protocol.
+  utils::mutex mtx;
+
+  /// Signalled when work arrives for parked workers.
+  utils::condition_variable work_available;
+
+  /// Signalled when outstanding drops to zero.
+  utils::condition_variable idle;
+
+  /// Tasks submitted from outside the pool.
+  std::deque<task *> injected;
+
+  /// Size of injected, readable without mtx.
+  std::atomic<size_t> num_injected;
+
+  /// Workers parked, or about to park, in main().
+  std::atomic<size_t> sleepers;
+
+  /// Tasks submitted and not yet finished.
+  std::atomic<uint64_t> outstanding;
+
+  std::atomic<uint64_t> steals;
+
+  bool exiting;
+};
+
+} // namespace utils
+} // namespace ors
+
+#endif // !__ORS_UTILS_THREAD_POOL_H__
@@ -1,11 +1,24 @@
 #ifndef __ORS_UTILS_TID_H__
 #define __ORS_UTILS_TID_H__
 
+#include <atomic>
 #include <cinttypes>
 #include <exception>
 #include <string>
+#include <vector>
 namespace ors {
 namespace utils {
+
+/**
+ * Small dense thread ids and thread names.
+ *
+ * Both live in thread-local storage, so tid() and c_name() cost a TLS read
+ * once the thread has been registered (on its first call to any function
+ * here). Registered threads are also listed in a lock-free global registry
+ * that threads() enumerates; a thread's slot in it is recycled when the
+ * thread exits. Names are pushed to the kernel too (pthread_setname_np,
+ * truncated to 15 bytes), so they show up in top, gdb and /proc.
+ */
 namespace tid {
 
 struct thread_name_alredy_exist : public std::exception {
@@ -15,14 +28,45 @@ struct thread_name_alredy_exist : public std::exception {
   std::string thread_name;
 };
 
-uint64_t tid();
+/// Longest name kept, in bytes; longer names are truncated.
+constexpr size_t MAX_NAME = 31;
+
+extern __thread uint64_t _tid;
+extern __thread char _name[MAX_NAME + 1];
+
+/// Assign the calling thread an id and register it.
+uint64_t assign();
+
+/// The calling thread's id: 1 for the first thread to ask, then 2, ...
+inline uint64_t tid() { return _tid != 0 ? _tid : assign(); }
 
+/**
+ * Name the calling thread. Surrounding whitespace is trimmed. An empty name,
+ * or one used by another live thread, gives the default "Thread <tid>".
+ */
 void set_name(std::string name);
 
+/// The calling thread's name; valid until its next set_name().
+inline const char *c_name() {
+  tid();
+  return _name;
+}
+
 std::string name();
 
+struct thread_info {
+  uint64_t tid;
+  std::string name;
+};
+
+/**
+ * Every live registered thread. Lock-free, so it may miss a thread that
+ * registers, or show the old name of one that renames itself, concurrently.
+ */
+std::vector<thread_info> threads();
+
 } // namespace tid
 } // namespace utils
 } // namespace ors
 
-#endif // !__ORS_UTILS_TID_H__
\ No newline at end of file
+#endif // !__ORS_UTILS_TID_H__
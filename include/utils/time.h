@@ -1,6 +1,7 @@
 #ifndef __ORS_UTILS_TIME_H__
 #define __ORS_UTILS_TIME_H__
 
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <exception>
@@ -65,6 +66,25 @@ struct sys_clock {
   static time_point now();
 };
 
+namespace detail {
+/**
+ * Futex words to bump and wake whenever mocked time changes, so threads
+ * sleeping until a mocked deadline re-check it. See mock_clock.
+ */
+void add_mock_sleeper(std::atomic<uint32_t> *word);
+void remove_mock_sleeper(std::atomic<uint32_t> *word);
+void wake_mock_sleepers();
+} // namespace detail
+
+/**
+ * baseclock, unless a test mocks it. Mocked time stands still until a test
+ * advance()s or set()s it, and may be read and changed from any thread.
+ * Changing it (including mocking and unmocking) wakes threads in
+ * time::sleep() and condition_variable::wait_until() on steady_clock, which
+ * while mocked sleep until mocked time reaches their deadline rather than
+ * real time, so a simulation can fast-forward through hours of timeouts.
+ * Threads already sleeping when the mock is installed keep real time.
+ */
 template <typename baseclock> struct mock_clock {
   // typedef clock clock;
   // typedef typename clock::duration duration;
@@ -82,27 +102,49 @@ template <typename baseclock> struct mock_clock {
   // it's ok to just assume is_steady is present.
   static constexpr bool is_steady = clock::is_steady;
 
-  static bool is_mock_value;
+  static std::atomic<bool> is_mock_value;
 
-  static time_point mock_value;
+  static std::atomic<time_point> mock_value;
 
-  static time_point now() { return is_mock_value ? mock_value : clock::now(); }
+  static time_point now() {
+    return is_mock_value.load() ? mock_value.load() : clock::now();
+  }
+
+  /// Move mocked time forward by d.
+  static void advance(duration d) {
+    time_point t = mock_value.load();
+    while (!mock_value.compare_exchange_weak(t, t + d))
+      ;
+    detail::wake_mock_sleepers();
+  }
+
+  /// Set mocked time to t.
+  static void set(time_point t) {
+    mock_value.store(t);
+    detail::wake_mock_sleepers();
+  }
 
   /// RAII class to mock out the clock and then restore it.
   struct mocker {
     explicit mocker(time_point value = now()) {
       assert(!is_mock_value);
-      is_mock_value = true;
-      mock_value = value;
+      mock_value.store(value);
+      is_mock_value.store(true);
+      detail::wake_mock_sleepers();
+    }
+    ~mocker() {
+      is_mock_value.store(false);
+      detail::wake_mock_sleepers();
     }
-    ~mocker() { is_mock_value = false; }
   };
 };
 
-template <typename baseclock> bool mock_clock<baseclock>::is_mock_value = false;
+template <typename baseclock>
+std::atomic<bool> mock_clock<baseclock>::is_mock_value(false);
 
 template <typename baseclock>
-typename mock_clock<baseclock>::time_point mock_clock<baseclock>::mock_value;
+std::atomic<typename mock_clock<baseclock>::time_point>
+    mock_clock<baseclock>::mock_value;
 
 int64_t parse(const std::string &description);
 
@@ -147,6 +189,192 @@ static __inline __attribute__((always_inline)) uint64_t rdtsc() {
 #endif
 }
 
+/// CLOCK_MONOTONIC in nanoseconds, never mocked.
+inline int64_t monotonic_nanos() {
+  struct timespec ts;
+  clock_gettime(STEADY_CLOCK_ID, &ts);
+  return int64_t(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
+namespace detail {
+/**
+ * The line mapping rdtsc() readings to CLOCK_MONOTONIC nanoseconds,
+ * published under a seqlock by whichever thread recalibrates.
+ */
+struct tsc_calibration {
+  std::atomic<uint32_t> seq;
+  /// nanos = anchor_nanos + (tsc - anchor_tsc) * mult / 2^32.
+  std::atomic<uint64_t> anchor_tsc;
+  std::atomic<int64_t> anchor_nanos;
+  std::atomic<uint64_t> mult;
+  /// rdtsc() value after which the next reader recalibrates.
+  std::atomic<uint64_t> due;
+  /// Measured rate since the first calibration.
+  std::atomic<double> ticks_per_nano;
+  /// Whether tsc_clock::now() reads the TSC rather than clock_gettime.
+  std::atomic<bool> use_tsc;
+  /// Set once tsc_init() has decided use_tsc.
+  std::atomic<bool> ready;
+};
+extern tsc_calibration _tsc;
+
+/// coarse_clock's cached reading in steady_clock nanoseconds; 0 if unset.
+extern std::atomic<int64_t> _coarse_nanos;
+
+/// coarse_clock's source, as an int.
+extern std::atomic<int> _coarse_source;
+
+/**
+ * Recalibrate unless another thread is already doing so; the first call
+ * (or any call racing with it) returns only once a calibration exists.
+ */
+void tsc_recalibrate();
+
+/**
+ * Decide use_tsc on first use rather than during static initialization,
+ * so binaries that never read tsc_clock do not pay for it.
+ */
+void tsc_init();
+} // namespace detail
+
+/**
+ * A steady clock read from the CPU's timestamp counter: an rdtsc() and a
+ * multiply, against ~20ns for clock_gettime(), for instrumentation and
+ * logging that timestamp millions of events per second.
+ *
+ * The tick rate is measured against CLOCK_MONOTONIC on first use (a 200us
+ * spin) and again at growing intervals up to a second; each recalibration steers the clock
+ * back onto CLOCK_MONOTONIC without ever stepping it backwards, so readings
+ * stay within microseconds of it. On CPUs without an invariant TSC (one
+ * that ticks at a constant rate through frequency changes and sleep
+ * states) now() falls back to clock_gettime().
+ *
+ * Time points are steady_clock's, so they can be compared with deadlines or
+ * passed to steady_converter; unlike steady_clock, tsc_clock is never
+ * mocked.
+ */
+struct tsc_clock {
+  using duration = std::chrono::nanoseconds;
+  using rep = typename duration::rep;
+  using period = typename duration::period;
+  using time_point = typename steady_clock::time_point;
+  static constexpr bool is_steady = true;
+
+  static time_point now() {
+    if (__builtin_expect(!detail::_tsc.ready.load(std::memory_order_acquire),
+                         0))
+      detail::tsc_init();
+    if (!detail::_tsc.use_tsc.load(std::memory_order_relaxed))
+      return time_point(duration(monotonic_nanos()));
+    return time_point(duration(nanos(rdtsc())));
+  }
+
+  /**
+   * CLOCK_MONOTONIC nanoseconds at which rdtsc() returned tsc, for
+   * converting stored raw readings. tsc need not be recent.
+   */
+  static int64_t nanos(uint64_t tsc) {
+    if (__builtin_expect(
+            tsc >= detail::_tsc.due.load(std::memory_order_relaxed), 0))
+      detail::tsc_recalibrate();
+    const detail::tsc_calibration &c = detail::_tsc;
+    uint64_t anchor, mult;
+    int64_t base;
+    for (;;) {
+      uint32_t s = c.seq.load(std::memory_order_acquire);
+      anchor = c.anchor_tsc.load(std::memory_order_relaxed);
+      base = c.anchor_nanos.load(std::memory_order_relaxed);
+      mult = c.mult.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if ((s & 1) == 0 && c.seq.load(std::memory_order_relaxed) == s)
+        break;
+    }
+    __int128 delta = int64_t(tsc - anchor);
+    return base + int64_t((delta * mult) >> 32);
+  }
+
+  /// Nanoseconds in a span of ticks (a difference of rdtsc() readings).
+  static int64_t to_nanos(uint64_t ticks) {
+    return int64_t(double(ticks) / ticks_per_nano());
+  }
+
+  static double ticks_per_nano() {
+    double r = detail::_tsc.ticks_per_nano.load(std::memory_order_relaxed);
+    if (__builtin_expect(r == 0, 0)) {
+      detail::tsc_recalibrate();
+      r = detail::_tsc.ticks_per_nano.load(std::memory_order_relaxed);
+    }
+    return r;
+  }
+
+  /// Whether this CPU advertises an invariant TSC.
+  static bool invariant();
+
+  /// Use the TSC for now() if on and the TSC is invariant; else clock_gettime.
+  static void set_enabled(bool on);
+
+  static bool enabled() {
+    detail::tsc_init();
+    return detail::_tsc.use_tsc.load(std::memory_order_relaxed);
+  }
+};
+
+/**
+ * A steady clock that returns a cached reading, for deadline checks that run
+ * on every request (session expiry, heartbeats, RPC timeouts) and can
+ * tolerate being a little late.
+ *
+ * With source::KERNEL (the default) now() reads CLOCK_MONOTONIC_COARSE,
+ * which the kernel updates every tick (1-4ms) and which costs a vDSO call
+ * but no TSC read. With source::CACHED now() is one relaxed load of the
+ * time stored by the last update(); the reading is then as stale as the
+ * interval between update() calls, and frozen if nobody calls it. Switch to
+ * CACHED only in a process whose event loop calls update() every
+ * iteration.
+ *
+ * When steady_clock is mocked, now() and update() return the mock value,
+ * so tests that mock steady_clock control this clock too.
+ */
+struct coarse_clock {
+  using duration = std::chrono::nanoseconds;
+  using rep = typename duration::rep;
+  using period = typename duration::period;
+  using time_point = typename steady_clock::time_point;
+  static constexpr bool is_steady = true;
+
+  enum class source { CACHED, KERNEL };
+
+  static time_point now() {
+    if (steady_clock::is_mock_value.load())
+      return steady_clock::mock_value.load();
+    if (detail::_coarse_source.load(std::memory_order_relaxed) ==
+        int(source::KERNEL)) {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+      return time_point(
+          duration(int64_t(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec));
+    }
+    int64_t nanos = detail::_coarse_nanos.load(std::memory_order_relaxed);
+    if (__builtin_expect(nanos == 0, 0))
+      return update();
+    return time_point(duration(nanos));
+  }
+
+  /**
+   * Refresh the cached reading from steady_clock and return it. Safe to
+   * call from several threads; the cache never moves backwards.
+   */
+  static time_point update();
+
+  static void set_source(source s) {
+    detail::_coarse_source.store(int(s), std::memory_order_relaxed);
+  }
+
+  static source get_source() {
+    return source(detail::_coarse_source.load(std::memory_order_relaxed));
+  }
+};
+
 } // namespace time
 } // namespace utils
 } // namespace ors
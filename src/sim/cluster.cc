@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <cstdio>
+
+#include <fmt/format.h>
+#include <sim/cluster.h>
+
+namespace ors {
+namespace sim {
+
+std::string report::to_string() const {
+  return fmt::format(
+      "{:.3f}s simulated: {} submitted, {} committed ({:.0f}/s), latency "
+      "p50 {}us p99 {}us max {}us, {} elections, {} messages ({} dropped)",
+      sim_nanos / 1e9, submitted, committed, commits_per_sec,
+      p50_latency_nanos / 1000, p99_latency_nanos / 1000,
+      max_latency_nanos / 1000, elections, messages_sent, messages_dropped);
+}
+
+cluster::cluster(const cluster_options &opts)
+    : opts(opts), rng(opts.seed), queue(), transport(queue, rng, opts.net),
+      servers(), leaders(), commits(), violation(), clients(),
+      request_bytes(0), latencies(), submitted(0) {
+  std::vector<uint64_t> ids;
+  for (size_t i = 0; i < opts.servers; ++i)
+    ids.push_back(i + 1);
+  for (uint64_t id : ids) {
+    servers.emplace_back(
+        new raft_server(id, ids, queue, transport, rng, opts.raft));
+    servers.back()->on_commit(
+        [this](uint64_t index, const proto::raft::Entry &entry) {
+          committed(index, entry);
+        });
+  }
+  for (auto &s : servers)
+    s->start();
+}
+
+raft_server *cluster::leader() {
+  raft_server *l = nullptr;
+  for (auto &s : servers)
+    if (s->is_up() && s->get_state() == raft_server::LEADER &&
+        (!l || s->get_term() > l->get_term()))
+      l = s.get();
+  return l;
+}
+
+void cluster::run_for(uint64_t nanos) {
+  uint64_t deadline = queue.now() + nanos;
+  while (queue.pending() && queue.next_time() <= deadline) {
+    queue.step();
+    observe();
+  }
+  queue.run_until(deadline);
+}
+
+bool cluster::wait_for_leader(uint64_t timeout_nanos) {
+  uint64_t deadline = queue.now() + timeout_nanos;
+  while (!leader() && queue.pending() && queue.next_time() <= deadline) {
+    queue.step();
+    observe();
+  }
+  return leader() != nullptr;
+}
+
+report cluster::run_workload(uint64_t nanos, size_t n, size_t bytes) {
+  uint64_t start = queue.now();
+  uint64_t elections = 0;
+  for (auto &s : servers)
+    elections += s->num_elections_won();
+  uint64_t sent = transport.num_sent();
+  uint64_t dropped = transport.num_dropped();
+
+  clients.assign(n, client{0, start, 0});
+  request_bytes = bytes;
+  latencies.clear();
+  submitted = 0;
+  for (size_t c = 0; c < n; ++c)
+    clients[c].timer = queue.schedule(0, [this, c] { submit(c); });
+  run_for(nanos);
+  for (const client &c : clients)
+    queue.cancel(c.timer);
+  clients.clear();
+
+  report r;
+  r.sim_nanos = nanos;
+  r.submitted = submitted;
+  r.committed = latencies.size();
+  r.commits_per_sec = nanos ? r.committed * 1e9 / nanos : 0;
+  if (!latencies.empty()) {
+    std::sort(latencies.begin(), latencies.end());
+    r.p50_latency_nanos = latencies[(latencies.size() - 1) / 2];
+    r.p99_latency_nanos = latencies[(latencies.size() - 1) * 99 / 100];
+    r.max_latency_nanos = latencies.back();
+  }
+  for (auto &s : servers)
+    r.elections += s->num_elections_won();
+  r.elections -= elections;
+  r.messages_sent = transport.num_sent() - sent;
+  r.messages_dropped = transport.num_dropped() - dropped;
+  return r;
+}
+
+std::string cluster::check_safety() const {
+  if (!violation.empty())
+    return violation;
+  for (size_t i = 0; i < servers.size(); ++i) {
+    const raft_server &a = *servers[i];
+    for (uint64_t k = 1; k <= a.get_commit_index(); ++k) {
+      auto it = commits.find(k);
+      if (it != commits.end() && it->second != a.entry(k).term())
+        return fmt::format("server {} committed term {} at index {}, a "
+                           "leader committed term {}",
+                           a.get_id(), a.entry(k).term(), k, it->second);
+    }
+    for (size_t j = i + 1; j < servers.size(); ++j) {
+      const raft_server &b = *servers[j];
+      uint64_t upto = std::min(a.get_commit_index(), b.get_commit_index());
+      for (uint64_t k = 1; k <= upto; ++k)
+        if (a.entry(k).term() != b.entry(k).term())
+          return fmt::format("servers {} and {} committed terms {} and {} at "
+                             "index {}",
+                             a.get_id(), b.get_id(), a.entry(k).term(),
+                             b.entry(k).term(), k);
+    }
+  }
+  return "";
+}
+
+void cluster::observe() {
+  for (auto &s : servers) {
+    if (!s->is_up() || s->get_state() != raft_server::LEADER)
+      continue;
+    auto it = leaders.emplace(s->get_term(), s->get_id()).first;
+    if (it->second != s->get_id() && violation.empty())
+      violation = fmt::format("servers {} and {} both led term {}",
+                              it->second, s->get_id(), s->get_term());
+  }
+}
+
+void cluster::committed(uint64_t index, const proto::raft::Entry &entry) {
+  auto it = commits.emplace(index, entry.term()).first;
+  if (it->second != entry.term() && violation.empty())
+    violation = fmt::format("index {} committed with terms {} and {}", index,
+                            it->second, entry.term());
+  if (entry.type() != proto::raft::DATA || clients.empty())
+    return;
+  size_t c = 0;
+  uint64_t seq = 0;
+  if (sscanf(entry.data().c_str(), "c%zu:%" SCNu64, &c, &seq) != 2 ||
+      c >= clients.size() || clients[c].seq != seq)
+    return; // a retried request that already committed once
+  client &cl = clients[c];
+  latencies.push_back(queue.now() - cl.submit_nanos);
+  ++cl.seq;
+  cl.submit_nanos = queue.now();
+  queue.cancel(cl.timer);
+  cl.timer = queue.schedule(0, [this, c] { submit(c); });
+}
+
+void cluster::submit(size_t c) {
+  client &cl = clients[c];
+  uint64_t retry = 2 * opts.raft.election_timeout_nanos;
+  // clients find the leader instantly; only the servers' view is simulated
+  raft_server *l = leader();
+  if (l) {
+    std::string data = fmt::format("c{}:{}", c, cl.seq);
+    if (data.size() < request_bytes)
+      data.resize(request_bytes, 'x');
+    l->submit(std::move(data));
+    ++submitted;
+  } else {
+    retry = opts.raft.heartbeat_nanos;
+  }
+  cl.timer = queue.schedule(retry, [this, c] { submit(c); });
+}
+
+} // namespace sim
+} // namespace ors
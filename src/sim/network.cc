@@ -0,0 +1,102 @@
+#include <sim/network.h>
+
+namespace ors {
+namespace sim {
+
+namespace {
+/// True with probability p.
+bool chance(utils::rand::xoshiro256 &rng, double p) {
+  return p > 0 && double(rng() >> 11) * 0x1.0p-53 < p;
+}
+} // namespace
+
+event_queue::event_queue() : events(), times(), now_nanos(0), next_id(1) {}
+
+uint64_t event_queue::schedule(uint64_t delay_nanos, std::function<void()> fn) {
+  uint64_t id = next_id++;
+  uint64_t when = now_nanos + delay_nanos;
+  events.emplace(std::make_pair(when, id), std::move(fn));
+  times.emplace(id, when);
+  return id;
+}
+
+void event_queue::cancel(uint64_t id) {
+  auto it = times.find(id);
+  if (it == times.end())
+    return;
+  events.erase(std::make_pair(it->second, id));
+  times.erase(it);
+}
+
+bool event_queue::step() {
+  if (events.empty())
+    return false;
+  auto it = events.begin();
+  now_nanos = it->first.first;
+  times.erase(it->first.second);
+  std::function<void()> fn = std::move(it->second);
+  events.erase(it);
+  fn();
+  return true;
+}
+
+void event_queue::run_until(uint64_t nanos) {
+  while (!events.empty() && events.begin()->first.first <= nanos)
+    step();
+  if (nanos > now_nanos)
+    now_nanos = nanos;
+}
+
+network::network(event_queue &events, utils::rand::xoshiro256 &rng,
+                 const network_options &options)
+    : events(events), rng(rng), options(options), handlers(), groups(),
+      next_group(1), sent(0), delivered(0), dropped(0) {}
+
+void network::attach(uint64_t id, handler h) { handlers[id] = std::move(h); }
+
+void network::send(uint64_t from, uint64_t to, message m) {
+  ++sent;
+  if (!connected(from, to) || chance(rng, options.drop_rate)) {
+    ++dropped;
+    return;
+  }
+  uint64_t latency = options.min_latency_nanos;
+  if (options.max_latency_nanos > options.min_latency_nanos)
+    latency += rng.bounded(options.max_latency_nanos -
+                           options.min_latency_nanos + 1);
+  if (chance(rng, options.reorder_rate) && options.reorder_nanos > 0)
+    latency += rng.bounded(options.reorder_nanos) + 1;
+  events.schedule(latency, [this, from, to, m = std::move(m)] {
+    auto it = handlers.find(to);
+    // a partition made while the message was in flight also loses it
+    if (it == handlers.end() || !connected(from, to)) {
+      ++dropped;
+      return;
+    }
+    ++delivered;
+    it->second(from, m);
+  });
+}
+
+void network::partition(const std::vector<std::vector<uint64_t>> &groups) {
+  this->groups.clear();
+  for (const auto &group : groups) {
+    uint64_t g = next_group++;
+    for (uint64_t id : group)
+      this->groups[id] = g;
+  }
+}
+
+void network::isolate(uint64_t id) { groups[id] = next_group++; }
+
+void network::heal() { groups.clear(); }
+
+bool network::connected(uint64_t from, uint64_t to) const {
+  auto a = groups.find(from);
+  auto b = groups.find(to);
+  return (a == groups.end() ? 0 : a->second) ==
+         (b == groups.end() ? 0 : b->second);
+}
+
+} // namespace sim
+} // namespace ors
@@ -0,0 +1,276 @@
+#include <algorithm>
+
+#include <sim/raft_server.h>
+
+namespace ors {
+namespace sim {
+
+raft_server::raft_server(uint64_t id, const std::vector<uint64_t> &servers,
+                         event_queue &events, network &net,
+                         utils::rand::xoshiro256 &rng, const options &opts)
+    : id(id), servers(servers), events(events), net(net), rng(rng),
+      opts(opts), term(0), voted_for(0), log(), up(false), st(FOLLOWER),
+      commit_index(0), peers(), timer(0), elections_won(0), committed() {
+  for (uint64_t s : servers)
+    if (s != id)
+      peers[s] = peer{1, 0, false, 0, false};
+}
+
+void raft_server::start() {
+  net.attach(id, [this](uint64_t from, const message &m) { handle(from, m); });
+  restart();
+}
+
+void raft_server::crash() {
+  up = false;
+  events.cancel(timer);
+  timer = 0;
+  st = FOLLOWER;
+  commit_index = 0;
+}
+
+void raft_server::restart() {
+  up = true;
+  st = FOLLOWER;
+  reset_election_timer();
+}
+
+uint64_t raft_server::submit(std::string data) {
+  if (!up || st != LEADER)
+    return 0;
+  append(proto::raft::DATA, std::move(data));
+  for (auto &p : peers)
+    replicate(p.first);
+  advance_commit(last_log_index());
+  return last_log_index();
+}
+
+void raft_server::handle(uint64_t from, const message &m) {
+  if (!up)
+    return;
+  std::visit([this, from](const auto &msg) { handle(from, msg); }, m);
+}
+
+void raft_server::handle(uint64_t from,
+                         const proto::raft::RequestVote::Request &req) {
+  if (req.term() > term)
+    step_down(req.term());
+  uint64_t last_term = term_at(last_log_index());
+  bool log_ok = req.last_log_term() > last_term ||
+                (req.last_log_term() == last_term &&
+                 req.last_log_index() >= last_log_index());
+  bool granted = req.term() == term && log_ok &&
+                 (voted_for == 0 || voted_for == req.server_id());
+  if (granted) {
+    voted_for = req.server_id();
+    reset_election_timer();
+  }
+  proto::raft::RequestVote::Response resp;
+  resp.set_term(term);
+  resp.set_granted(granted);
+  resp.set_log_ok(log_ok);
+  net.send(id, from, resp);
+}
+
+void raft_server::handle(uint64_t from,
+                         const proto::raft::RequestVote::Response &resp) {
+  if (resp.term() > term) {
+    step_down(resp.term());
+    return;
+  }
+  if (st != CANDIDATE || resp.term() != term || !resp.granted())
+    return;
+  peers[from].vote_granted = true;
+  size_t votes = 1;
+  for (const auto &p : peers)
+    votes += p.second.vote_granted;
+  if (votes > servers.size() / 2)
+    become_leader();
+}
+
+void raft_server::handle(uint64_t from,
+                         const proto::raft::AppendEntries::Request &req) {
+  proto::raft::AppendEntries::Response resp;
+  resp.set_success(false);
+  if (req.term() < term) {
+    resp.set_term(term);
+    resp.set_last_log_index(last_log_index());
+    net.send(id, from, resp);
+    return;
+  }
+  if (req.term() > term)
+    step_down(req.term());
+  st = FOLLOWER;
+  reset_election_timer();
+  resp.set_term(term);
+
+  uint64_t prev = req.prev_log_index();
+  if (prev > last_log_index() || term_at(prev) != req.prev_log_term()) {
+    resp.set_last_log_index(std::min(last_log_index(), prev - 1));
+    net.send(id, from, resp);
+    return;
+  }
+  uint64_t index = prev;
+  for (const proto::raft::Entry &e : req.entries()) {
+    ++index;
+    if (index <= last_log_index()) {
+      // a delayed, duplicate request must not truncate entries that match
+      if (term_at(index) == e.term())
+        continue;
+      log.resize(index - 1);
+    }
+    log.push_back(e);
+  }
+  if (req.commit_index() > commit_index)
+    commit_index = std::min(req.commit_index(), index);
+  resp.set_success(true);
+  resp.set_last_log_index(index);
+  net.send(id, from, resp);
+}
+
+void raft_server::handle(uint64_t from,
+                         const proto::raft::AppendEntries::Response &resp) {
+  if (resp.term() > term) {
+    step_down(resp.term());
+    return;
+  }
+  if (st != LEADER || resp.term() != term)
+    return;
+  peer &p = peers[from];
+  p.in_flight = false;
+  if (resp.success()) {
+    if (resp.last_log_index() > p.match_index) {
+      p.match_index = resp.last_log_index();
+      advance_commit(p.match_index);
+    }
+    p.next_index = std::max(p.next_index, p.match_index + 1);
+  } else {
+    p.next_index = std::max<uint64_t>(
+        1, std::min(p.next_index - 1, resp.last_log_index() + 1));
+  }
+  if (p.next_index <= last_log_index())
+    replicate(from);
+}
+
+void raft_server::step_down(uint64_t new_term) {
+  if (new_term > term) {
+    term = new_term;
+    voted_for = 0;
+  }
+  if (st != FOLLOWER) {
+    st = FOLLOWER;
+    reset_election_timer();
+  }
+}
+
+void raft_server::start_election() {
+  ++term;
+  st = CANDIDATE;
+  voted_for = id;
+  for (auto &p : peers)
+    p.second.vote_granted = false;
+  reset_election_timer();
+  if (peers.empty()) {
+    become_leader();
+    return;
+  }
+  proto::raft::RequestVote::Request req;
+  req.set_server_id(id);
+  req.set_term(term);
+  req.set_last_log_term(term_at(last_log_index()));
+  req.set_last_log_index(last_log_index());
+  for (const auto &p : peers)
+    net.send(id, p.first, req);
+}
+
+void raft_server::become_leader() {
+  st = LEADER;
+  ++elections_won;
+  for (auto &p : peers)
+    p.second = peer{last_log_index() + 1, 0, false, 0, false};
+  // entries from earlier terms commit once one from this term does
+  append(proto::raft::NOOP, "");
+  advance_commit(last_log_index());
+  heartbeat();
+}
+
+void raft_server::reset_election_timer() {
+  events.cancel(timer);
+  uint64_t t = opts.election_timeout_nanos;
+  timer = events.schedule(t + rng.bounded(t), [this] {
+    timer = 0;
+    start_election();
+  });
+}
+
+void raft_server::heartbeat() {
+  events.cancel(timer);
+  for (auto &p : peers) {
+    // a request still awaiting its reply doubles as the heartbeat, unless it
+    // has waited so long that it or the reply was probably lost
+    if (events.now() - p.second.sent_nanos >= opts.heartbeat_nanos)
+      p.second.in_flight = false;
+    replicate(p.first);
+  }
+  timer = events.schedule(opts.heartbeat_nanos, [this] {
+    timer = 0;
+    heartbeat();
+  });
+}
+
+void raft_server::replicate(uint64_t to) {
+  peer &p = peers[to];
+  if (p.in_flight)
+    return;
+  proto::raft::AppendEntries::Request req;
+  req.set_server_id(id);
+  req.set_term(term);
+  req.set_prev_log_index(p.next_index - 1);
+  req.set_prev_log_term(term_at(p.next_index - 1));
+  uint64_t last =
+      std::min<uint64_t>(last_log_index(), p.next_index + opts.max_batch - 1);
+  for (uint64_t i = p.next_index; i <= last; ++i)
+    *req.add_entries() = log[i - 1];
+  req.set_commit_index(commit_index);
+  p.in_flight = true;
+  p.sent_nanos = events.now();
+  net.send(id, to, req);
+}
+
+void raft_server::advance_commit(uint64_t index) {
+  if (st != LEADER || index <= commit_index)
+    return;
+  // the highest index stored on a majority, counting this server
+  std::vector<uint64_t> match{last_log_index()};
+  for (const auto &p : peers)
+    match.push_back(p.second.match_index);
+  std::sort(match.begin(), match.end(), std::greater<uint64_t>());
+  uint64_t quorum = match[servers.size() / 2];
+  if (quorum <= commit_index || term_at(quorum) != term)
+    return;
+  uint64_t first = commit_index + 1;
+  commit_index = quorum;
+  if (committed)
+    for (uint64_t i = first; i <= quorum; ++i)
+      committed(i, log[i - 1]);
+}
+
+uint64_t raft_server::term_at(uint64_t index) const {
+  if (index == 0 || index > log.size())
+    return 0;
+  return log[index - 1].term();
+}
+
+void raft_server::append(proto::raft::EntryType type, std::string data) {
+  proto::raft::Entry e;
+  e.set_term(term);
+  e.set_index(last_log_index() + 1);
+  e.set_cluster_time(events.now());
+  e.set_type(type);
+  if (type == proto::raft::DATA)
+    e.set_data(std::move(data));
+  log.push_back(std::move(e));
+}
+
+} // namespace sim
+} // namespace ors
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <cassert>
+
+#include <state_machine/batch_applier.h>
+#include <utils/log.h>
+#include <utils/tid.h>
+
+namespace ors {
+namespace state_machine {
+
+batch_applier::batch_applier(apply_fn apply, size_t max_batch_size,
+                             size_t max_responses)
+    : apply(std::move(apply)), max_batch_size(max_batch_size),
+      max_responses(max_responses), mtx("batch_applier"), pending_changed(),
+      applied_changed(), exiting(false), pending(), responses(),
+      last_applied_index(0), num_batches(0), num_entries(0), max_batch(0),
+      batch_sizes(), apply_nanos(), thread() {}
+
+batch_applier::~batch_applier() { exit(); }
+
+void batch_applier::start() {
+  std::lock_guard<utils::mutex> lg(mtx);
+  if (!thread.joinable() && !exiting)
+    thread = std::thread(&batch_applier::applier_main, this);
+}
+
+void batch_applier::exit() {
+  {
+    std::lock_guard<utils::mutex> lg(mtx);
+    exiting = true;
+    pending_changed.notify_all();
+    applied_changed.notify_all();
+  }
+  if (thread.joinable())
+    thread.join();
+}
+
+void batch_applier::commit(std::vector<entry> entries) {
+  if (entries.empty())
+    return;
+  std::lock_guard<utils::mutex> lg(mtx);
+  for (auto &e : entries) {
+    assert(pending.empty() ? e.index > last_applied_index
+                           : e.index == pending.back().index + 1);
+    pending.push_back(std::move(e));
+  }
+  pending_changed.notify_one();
+}
+
+void batch_applier::commit(uint64_t index, std::string data) {
+  std::vector<entry> entries;
+  entries.push_back({index, std::move(data)});
+  commit(std::move(entries));
+}
+
+size_t batch_applier::apply_batch() {
+  std::vector<entry> batch;
+  {
+    std::lock_guard<utils::mutex> lg(mtx);
+    size_t n = pending.size();
+    if (max_batch_size > 0)
+      n = std::min(n, max_batch_size);
+    batch.reserve(n);
+    std::move(pending.begin(), pending.begin() + n, std::back_inserter(batch));
+    pending.erase(pending.begin(), pending.begin() + n);
+  }
+  if (batch.empty())
+    return 0;
+
+  std::vector<std::string> results;
+  results.reserve(batch.size());
+  auto start = utils::time::steady_clock::now();
+  apply(batch, results);
+  apply_nanos.record(utils::time::steady_clock::now() - start);
+  if (results.size() != batch.size()) {
+    ORS_ERROR("apply function returned {} responses for {} entries",
+              results.size(), batch.size());
+    results.resize(batch.size());
+  }
+
+  std::lock_guard<utils::mutex> lg(mtx);
+  for (size_t i = 0; i < batch.size(); ++i)
+    responses.emplace_hint(responses.end(), batch[i].index,
+                           std::move(results[i]));
+  while (responses.size() > max_responses)
+    responses.erase(responses.begin());
+  last_applied_index = batch.back().index;
+  ++num_batches;
+  num_entries += batch.size();
+  max_batch = std::max<uint64_t>(max_batch, batch.size());
+  batch_sizes.push(batch.size());
+  applied_changed.notify_all();
+  return batch.size();
+}
+
+bool batch_applier::wait_response(
+    uint64_t index, std::string &response,
+    utils::time::steady_clock::time_point deadline) {
+  std::unique_lock<utils::mutex> ul(mtx);
+  while (!exiting && last_applied_index < index) {
+    if (utils::time::steady_clock::now() >= deadline)
+      return false;
+    applied_changed.wait_until(ul, deadline);
+  }
+  auto it = responses.find(index);
+  if (last_applied_index < index || it == responses.end())
+    return false;
+  response = std::move(it->second);
+  responses.erase(it);
+  return true;
+}
+
+bool batch_applier::wait_applied(
+    uint64_t index, utils::time::steady_clock::time_point deadline) {
+  std::unique_lock<utils::mutex> ul(mtx);
+  while (!exiting && last_applied_index < index) {
+    if (utils::time::steady_clock::now() >= deadline)
+      return false;
+    applied_changed.wait_until(ul, deadline);
+  }
+  return last_applied_index >= index;
+}
+
+uint64_t batch_applier::last_applied() {
+  std::lock_guard<utils::mutex> lg(mtx);
+  return last_applied_index;
+}
+
+void batch_applier::set_max_batch_size(size_t n) {
+  std::lock_guard<utils::mutex> lg(mtx);
+  max_batch_size = n;
+}
+
+void batch_applier::update_server_stats(
+    proto::ServerStats::StateMachine &stats) {
+  std::lock_guard<utils::mutex> lg(mtx);
+  stats.set_last_applied(last_applied_index);
+  stats.set_num_apply_batches(num_batches);
+  stats.set_num_applied_entries(num_entries);
+  stats.set_max_apply_batch_size(max_batch);
+  batch_sizes.update_proto(*stats.mutable_apply_batch_size());
+}
+
+void batch_applier::update_server_stats(proto::ServerStats::Latency &stats) {
+  apply_nanos.update_proto(*stats.mutable_apply_nanos());
+}
+
+void batch_applier::applier_main() {
+  utils::tid::set_name("applier");
+  while (true) {
+    {
+      std::unique_lock<utils::mutex> ul(mtx);
+      while (!exiting && pending.empty())
+        pending_changed.wait(ul);
+      if (exiting)
+        return;
+    }
+    apply_batch();
+  }
+}
+
+} // namespace state_machine
+} // namespace ors
@@ -0,0 +1,209 @@
+#include <algorithm>
+
+#include <state_machine/session_table.h>
+
+namespace ors {
+namespace state_machine {
+
+namespace {
+constexpr size_t INITIAL_RING = 4;
+
+size_t round_up_pow2(size_t n) {
+  size_t r = 1;
+  while (r < n)
+    r <<= 1;
+  return r;
+}
+} // namespace
+
+session_table::session_table(uint64_t expiration_nanos,
+                             size_t max_responses_per_session,
+                             size_t max_outstanding_rpcs)
+    : expiration_nanos(expiration_nanos),
+      max_responses(round_up_pow2(std::max<size_t>(
+          max_responses_per_session, INITIAL_RING))),
+      max_outstanding(std::max<uint64_t>(max_outstanding_rpcs, 1)),
+      lru(), sessions(), num_responses(0), num_duplicates(0), num_evicted(0),
+      num_expired(0) {}
+
+void session_table::open(uint64_t client_id, uint64_t cluster_time) {
+  auto it = sessions.find(client_id);
+  if (it != sessions.end()) {
+    touch(it->second, cluster_time);
+    return;
+  }
+  lru.push_back({client_id, cluster_time, 1, 0, {}, {}});
+  sessions.emplace(client_id, std::prev(lru.end()));
+}
+
+void session_table::close(uint64_t client_id) {
+  auto it = sessions.find(client_id);
+  if (it == sessions.end())
+    return;
+  collect(*it->second, UINT64_MAX);
+  lru.erase(it->second);
+  sessions.erase(it);
+}
+
+session_table::status
+session_table::check(const proto::client::ExactlyOnceRPCInfo &rpc,
+                     uint64_t cluster_time, std::string &response) {
+  auto it = sessions.find(rpc.client_id());
+  if (it == sessions.end())
+    return EXPIRED;
+  session &s = *it->second;
+  touch(it->second, cluster_time);
+  collect(s, rpc.first_outstanding_rpc());
+  uint64_t n = rpc.rpc_number();
+  if (n < s.first_outstanding_rpc)
+    return STALE;
+  if (!s.ring.empty()) {
+    slot &sl = s.ring[n & (s.ring.size() - 1)];
+    if (sl.rpc_number == n) {
+      ++num_duplicates;
+      response = sl.response;
+      return DUPLICATE;
+    }
+  }
+  if (s.evicted.count(n) > 0)
+    return EXPIRED;
+  if (n - s.first_outstanding_rpc >= max_outstanding) {
+    // a client this far ahead of its acknowledgements would make the
+    // session track an unbounded number of rpc numbers
+    close(rpc.client_id());
+    ++num_expired;
+    return EXPIRED;
+  }
+  return NEW;
+}
+
+void session_table::record(const proto::client::ExactlyOnceRPCInfo &rpc,
+                           std::string response) {
+  auto it = sessions.find(rpc.client_id());
+  if (it == sessions.end())
+    return;
+  session &s = *it->second;
+  uint64_t n = rpc.rpc_number();
+  if (n < s.first_outstanding_rpc || n == 0)
+    return;
+  if (s.ring.empty())
+    s.ring.resize(INITIAL_RING);
+  while (true) {
+    slot &sl = s.ring[n & (s.ring.size() - 1)];
+    if (sl.rpc_number == 0 || sl.rpc_number == n)
+      break;
+    if (s.ring.size() < max_responses) {
+      grow(s);
+      continue;
+    }
+    // full: the oldest outstanding response in this slot is lost
+    evict(s, sl);
+    break;
+  }
+  slot &sl = s.ring[n & (s.ring.size() - 1)];
+  if (sl.rpc_number == 0)
+    ++num_responses;
+  sl.rpc_number = n;
+  sl.response = std::move(response);
+  s.max_rpc_number = std::max(s.max_rpc_number, n);
+  s.evicted.erase(n);
+}
+
+size_t session_table::expire(uint64_t cluster_time) {
+  if (cluster_time < expiration_nanos)
+    return 0;
+  uint64_t cutoff = cluster_time - expiration_nanos;
+  size_t removed = 0;
+  while (!lru.empty() && lru.front().last_modified < cutoff) {
+    collect(lru.front(), UINT64_MAX);
+    sessions.erase(lru.front().client_id);
+    lru.pop_front();
+    ++removed;
+  }
+  num_expired += removed;
+  return removed;
+}
+
+size_t session_table::size() const { return sessions.size(); }
+
+bool session_table::has_session(uint64_t client_id) const {
+  return sessions.count(client_id) > 0;
+}
+
+void session_table::update_server_stats(
+    proto::ServerStats::StateMachine &stats) const {
+  stats.set_num_sessions(sessions.size());
+  stats.set_num_cached_responses(num_responses);
+  stats.set_num_duplicate_rpcs(num_duplicates);
+  stats.set_num_evicted_responses(num_evicted);
+  stats.set_num_expired_sessions(num_expired);
+}
+
+void session_table::collect(session &s, uint64_t first_outstanding_rpc) {
+  if (first_outstanding_rpc <= s.first_outstanding_rpc)
+    return;
+  uint64_t old = s.first_outstanding_rpc;
+  s.first_outstanding_rpc = first_outstanding_rpc;
+  s.evicted.erase(s.evicted.begin(),
+                  s.evicted.lower_bound(first_outstanding_rpc));
+  if (s.ring.empty())
+    return;
+  uint64_t mask = s.ring.size() - 1;
+  if (first_outstanding_rpc - old < s.ring.size()) {
+    for (uint64_t n = old; n < first_outstanding_rpc; ++n) {
+      slot &sl = s.ring[n & mask];
+      if (sl.rpc_number != 0 && sl.rpc_number < first_outstanding_rpc) {
+        sl.rpc_number = 0;
+        std::string().swap(sl.response);
+        --num_responses;
+      }
+    }
+  } else {
+    for (auto &sl : s.ring) {
+      if (sl.rpc_number != 0 && sl.rpc_number < first_outstanding_rpc) {
+        sl.rpc_number = 0;
+        std::string().swap(sl.response);
+        --num_responses;
+      }
+    }
+  }
+  // everything has been collected: give the memory back until the next RPC
+  if (first_outstanding_rpc > s.max_rpc_number)
+    std::vector<slot>().swap(s.ring);
+}
+
+void session_table::grow(session &s) {
+  std::vector<slot> bigger(s.ring.size() * 2);
+  uint64_t mask = bigger.size() - 1;
+  for (auto &sl : s.ring) {
+    if (sl.rpc_number == 0)
+      continue;
+    slot &dst = bigger[sl.rpc_number & mask];
+    if (dst.rpc_number != 0) {
+      // outstanding RPCs spread further apart than the ring: keep the newer
+      if (dst.rpc_number > sl.rpc_number) {
+        evict(s, sl);
+        continue;
+      }
+      evict(s, dst);
+    }
+    dst = std::move(sl);
+  }
+  s.ring.swap(bigger);
+}
+
+void session_table::evict(session &s, slot &sl) {
+  ++num_evicted;
+  --num_responses;
+  s.evicted.insert(sl.rpc_number);
+  sl.rpc_number = 0;
+  std::string().swap(sl.response);
+}
+
+void session_table::touch(lru_list::iterator it, uint64_t cluster_time) {
+  it->last_modified = std::max(it->last_modified, cluster_time);
+  lru.splice(lru.end(), lru, it);
+}
+
+} // namespace state_machine
+} // namespace ors
@@ -0,0 +1,206 @@
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <state_machine/snapshot_fork.h>
+#include <utils/log.h>
+#include <utils/time.h>
+
+namespace ors {
+namespace state_machine {
+
+namespace {
+/**
+ * Private_Clean + Private_Dirty of the calling process in bytes, or 0 if
+ * smaps_rollup (Linux 4.14) is unavailable. Uses only read(2) and no
+ * allocation, as it runs in a forked child.
+ */
+uint64_t private_bytes() {
+  int fd = open("/proc/self/smaps_rollup", O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return 0;
+  char buf[4096];
+  size_t n = 0;
+  ssize_t r;
+  while (n < sizeof(buf) - 1 &&
+         (r = read(fd, buf + n, sizeof(buf) - 1 - n)) != 0) {
+    if (r < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    n += size_t(r);
+  }
+  close(fd);
+  buf[n] = '\0';
+  uint64_t kb = 0;
+  for (const char *key : {"\nPrivate_Clean:", "\nPrivate_Dirty:"}) {
+    const char *p = strstr(buf, key);
+    if (p != nullptr)
+      kb += strtoull(p + strlen(key), nullptr, 10);
+  }
+  return kb * 1024;
+}
+} // namespace
+
+snapshot_fork::snapshot_fork()
+    : mtx("snapshot_fork"), pid(0), num_attempted(0), num_failed(0),
+      last_fork_nanos(0), last_child_pages(0), last_cow_bytes(0),
+      child_private_bytes(nullptr), last_success(false),
+      page_size(uint64_t(sysconf(_SC_PAGESIZE))) {
+  void *p = mmap(nullptr, size_t(page_size), PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+    ORS_WARNING("mmap for snapshot stats failed: {}", strerror(errno));
+  else
+    child_private_bytes = new (p) std::atomic<uint64_t>(0);
+}
+
+snapshot_fork::~snapshot_fork() {
+  stop();
+  if (child_private_bytes != nullptr)
+    munmap(child_private_bytes, size_t(page_size));
+}
+
+bool snapshot_fork::start(child_fn child_main) {
+  std::lock_guard<utils::mutex> lg(mtx);
+  if (pid > 0)
+    return false;
+  ++num_attempted;
+  if (child_private_bytes != nullptr)
+    child_private_bytes->store(0);
+  std::atomic<uint64_t> *report = child_private_bytes;
+  auto start = utils::time::steady_clock::now();
+  pid_t child = fork();
+  if (child == 0) {
+    // The child must never return into the caller's stack frames.
+    int status = 1;
+    try {
+      status = child_main();
+    } catch (...) {
+    }
+    if (report != nullptr)
+      report->store(private_bytes());
+    // _exit() skips the atexit handler that flushes the log
+    utils::log::flush();
+    _exit(status);
+  }
+  if (child < 0) {
+    ++num_failed;
+    ORS_ERROR("fork() for snapshot failed: {}", strerror(errno));
+    return false;
+  }
+  last_fork_nanos = utils::time::steady_clock::now() - start;
+  pid = child;
+  ORS_NOTICE("forked snapshot child {} in {} ns", pid,
+             last_fork_nanos.count());
+  return true;
+}
+
+bool snapshot_fork::in_progress() {
+  std::unique_lock<utils::mutex> ul(mtx);
+  bool success;
+  if (pid > 0)
+    reap(false, success);
+  return pid > 0;
+}
+
+bool snapshot_fork::wait() {
+  std::unique_lock<utils::mutex> ul(mtx);
+  bool success = false;
+  if (pid <= 0)
+    return false;
+  pid_t child = pid;
+  {
+    // Wait for the child to exit without reaping it, so that stats
+    // collection is not stuck behind a long snapshot.
+    utils::mutex_unlock<utils::mutex> unlock(ul);
+    siginfo_t info;
+    while (waitid(P_PID, id_t(child), &info, WEXITED | WNOWAIT) != 0 &&
+           errno == EINTR) {
+    }
+  }
+  if (pid != child)
+    return last_success;
+  while (!reap(true, success)) {
+  }
+  return success;
+}
+
+void snapshot_fork::stop() {
+  std::unique_lock<utils::mutex> ul(mtx);
+  if (pid <= 0)
+    return;
+  ::kill(pid, SIGKILL);
+  bool success;
+  while (!reap(true, success)) {
+  }
+}
+
+pid_t snapshot_fork::child_pid() {
+  std::lock_guard<utils::mutex> lg(mtx);
+  return pid;
+}
+
+void snapshot_fork::update_server_stats(
+    proto::ServerStats::StateMachine &stats) {
+  std::unique_lock<utils::mutex> ul(mtx);
+  bool success;
+  if (pid > 0)
+    reap(false, success);
+  stats.set_snapshotting(pid > 0);
+  stats.set_num_snapshots_attempted(num_attempted);
+  stats.set_num_snapshots_failed(num_failed);
+  stats.set_snapshot_fork_nanos(uint64_t(last_fork_nanos.count()));
+  stats.set_snapshot_child_fault_bytes(last_child_pages * page_size);
+  stats.set_snapshot_cow_bytes(last_cow_bytes);
+}
+
+bool snapshot_fork::finish(int status, const struct rusage &child_usage) {
+  last_child_pages = uint64_t(child_usage.ru_minflt);
+  last_cow_bytes =
+      child_private_bytes != nullptr ? child_private_bytes->load() : 0;
+  last_success = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  if (!last_success) {
+    ++num_failed;
+    if (WIFSIGNALED(status))
+      ORS_WARNING("snapshot child {} killed by signal {}", pid,
+                  WTERMSIG(status));
+    else
+      ORS_WARNING("snapshot child {} failed with status {}", pid,
+                  WEXITSTATUS(status));
+  }
+  pid = 0;
+  return last_success;
+}
+
+bool snapshot_fork::reap(bool block, bool &success) {
+  int status = 0;
+  struct rusage usage;
+  memset(&usage, 0, sizeof(usage));
+  pid_t r = wait4(pid, &status, block ? 0 : WNOHANG, &usage);
+  if (r == 0)
+    return false;
+  if (r < 0) {
+    if (errno == EINTR)
+      return false;
+    ORS_ERROR("wait4({}) failed: {}", pid, strerror(errno));
+    ++num_failed;
+    pid = 0;
+    success = false;
+    return true;
+  }
+  success = finish(status, usage);
+  return true;
+}
+
+} // namespace state_machine
+} // namespace ors
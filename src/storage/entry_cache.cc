@@ -0,0 +1,130 @@
+#include <mutex>
+
+#include <storage/entry_cache.h>
+
+namespace ors {
+namespace storage {
+
+entry_cache::entry_cache(uint64_t max_bytes)
+    : max_bytes(max_bytes), mtx("entry_cache"), slots(), first(1),
+      total_bytes(0), hits(0), misses(0), evictions(0) {}
+
+void entry_cache::append(uint64_t index, entry_ptr entry) {
+  uint64_t bytes = entry->ByteSizeLong();
+  std::lock_guard<utils::mutex> lg(mtx);
+  uint64_t next = first + slots.size();
+  if (index < next && index >= first) {
+    while (first + slots.size() > index) {
+      total_bytes -= slots.back().bytes;
+      slots.pop_back();
+    }
+  } else if (index != next) {
+    // a gap, or an index before everything cached: start over from index
+    slots.clear();
+    total_bytes = 0;
+    first = index;
+  }
+  if (bytes > max_bytes) {
+    // keeping it would evict everything, itself included
+    evictions += slots.size();
+    slots.clear();
+    total_bytes = 0;
+    first = index + 1;
+    return;
+  }
+  slots.push_back({std::move(entry), bytes});
+  total_bytes += bytes;
+  evict();
+}
+
+void entry_cache::truncate_suffix(uint64_t index) {
+  std::lock_guard<utils::mutex> lg(mtx);
+  while (!slots.empty() && first + slots.size() > index) {
+    total_bytes -= slots.back().bytes;
+    slots.pop_back();
+  }
+  if (slots.empty() && index < first)
+    first = index;
+}
+
+void entry_cache::truncate_prefix(uint64_t index) {
+  std::lock_guard<utils::mutex> lg(mtx);
+  while (!slots.empty() && first < index) {
+    total_bytes -= slots.front().bytes;
+    slots.pop_front();
+    ++first;
+  }
+  if (slots.empty() && first < index)
+    first = index;
+}
+
+entry_cache::entry_ptr entry_cache::get(uint64_t index) {
+  std::lock_guard<utils::mutex> lg(mtx);
+  if (index < first || index - first >= slots.size()) {
+    ++misses;
+    return nullptr;
+  }
+  ++hits;
+  return slots[index - first].entry;
+}
+
+size_t entry_cache::get_range(uint64_t start, size_t max_entries,
+                              uint64_t max_bytes, std::vector<entry_ptr> &out) {
+  std::lock_guard<utils::mutex> lg(mtx);
+  if (start < first || start - first >= slots.size() || max_entries == 0) {
+    ++misses;
+    return 0;
+  }
+  ++hits;
+  size_t n = 0;
+  uint64_t bytes = 0;
+  for (size_t i = start - first; i < slots.size() && n < max_entries; ++i) {
+    if (n > 0 && bytes + slots[i].bytes > max_bytes)
+      break;
+    bytes += slots[i].bytes;
+    out.push_back(slots[i].entry);
+    ++n;
+  }
+  return n;
+}
+
+uint64_t entry_cache::first_index() {
+  std::lock_guard<utils::mutex> lg(mtx);
+  return first;
+}
+
+uint64_t entry_cache::last_index() {
+  std::lock_guard<utils::mutex> lg(mtx);
+  return first + slots.size() - 1;
+}
+
+bool entry_cache::empty() {
+  std::lock_guard<utils::mutex> lg(mtx);
+  return slots.empty();
+}
+
+uint64_t entry_cache::bytes() {
+  std::lock_guard<utils::mutex> lg(mtx);
+  return total_bytes;
+}
+
+void entry_cache::update_server_stats(proto::ServerStats::Storage &stats) {
+  std::lock_guard<utils::mutex> lg(mtx);
+  stats.set_num_entry_cache_hits(hits);
+  stats.set_num_entry_cache_misses(misses);
+  stats.set_num_entry_cache_evictions(evictions);
+  stats.set_entry_cache_entries(slots.size());
+  stats.set_entry_cache_bytes(total_bytes);
+}
+
+void entry_cache::evict() {
+  while (total_bytes > max_bytes && !slots.empty()) {
+    total_bytes -= slots.front().bytes;
+    slots.pop_front();
+    ++first;
+    ++evictions;
+  }
+}
+
+} // namespace storage
+} // namespace ors
@@ -0,0 +1,409 @@
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <mutex>
+#include <thread>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <storage/snapshot_file.h>
+#include <utils/log.h>
+#include <utils/common.h>
+
+namespace ors {
+namespace storage {
+namespace snapshot_file {
+
+using utils::string::fmt;
+
+namespace {
+
+const char MAGIC[8] = {'O', 'R', 'S', 'S', 'N', 'A', 'P', '\0'};
+
+constexpr size_t HEADER_BYTES = sizeof(MAGIC) + 4 + 4;
+
+constexpr size_t INDEX_ENTRY_BYTES = 8 + 4 + 4 + 4 + 1 + 1;
+
+constexpr size_t FOOTER_BYTES = 8 + 4 + 4 + sizeof(MAGIC);
+
+void put32(std::string &out, uint32_t v) {
+  for (int i = 0; i < 4; ++i)
+    out.push_back(char((v >> (8 * i)) & 0xff));
+}
+
+void put64(std::string &out, uint64_t v) {
+  for (int i = 0; i < 8; ++i)
+    out.push_back(char((v >> (8 * i)) & 0xff));
+}
+
+uint32_t get32(const char *p) {
+  uint32_t v = 0;
+  for (int i = 3; i >= 0; --i)
+    v = (v << 8) | uint8_t(p[i]);
+  return v;
+}
+
+uint64_t get64(const char *p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; --i)
+    v = (v << 8) | uint8_t(p[i]);
+  return v;
+}
+
+uint32_t checksum(const void *data, size_t length) {
+  return uint32_t(
+      crc32(0L, static_cast<const Bytef *>(data), uInt(length)));
+}
+
+void read_fully(int fd, void *data, size_t length, uint64_t offset,
+                const std::string &path) {
+  char *p = static_cast<char *>(data);
+  while (length > 0) {
+    ssize_t r = pread(fd, p, length, off_t(offset));
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r <= 0)
+      throw exception(fmt("Could not read %s at offset %lu: %s", path.c_str(),
+                          offset, r == 0 ? "end of file" : strerror(errno)));
+    p += r;
+    offset += uint64_t(r);
+    length -= size_t(r);
+  }
+}
+
+} // namespace
+
+exception::exception(const std::string &error) : std::runtime_error(error) {}
+
+writer::writer(const std::string &path, uint32_t block_size, int level)
+    : fd(-1), path(path), block_size(block_size), level(level), current(),
+      continued(false), index(), offset(0), bytes_written(0) {
+  if (block_size == 0)
+    throw exception(fmt("Snapshot block size for %s must not be 0",
+                        path.c_str()));
+  fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+    throw exception(
+        fmt("Could not create %s: %s", path.c_str(), strerror(errno)));
+  std::string header(MAGIC, sizeof(MAGIC));
+  put32(header, VERSION);
+  put32(header, block_size);
+  write_fully(header.data(), header.size());
+  current.reserve(block_size);
+}
+
+writer::~writer() {
+  if (fd < 0)
+    return;
+  try {
+    close();
+  } catch (const exception &e) {
+    ORS_ERROR("{}", e.what());
+  }
+}
+
+size_t writer::get_bytes_writen() const { return bytes_written; }
+
+void writer::write_message(const google::protobuf::Message &msg) {
+  std::string buf;
+  put32(buf, uint32_t(msg.ByteSizeLong()));
+  if (!msg.AppendToString(&buf))
+    throw exception(fmt("Could not serialize %s", msg.GetTypeName().c_str()));
+  // keep messages within one block so blocks can be parsed independently
+  if (!current.empty() && current.size() + buf.size() > block_size)
+    flush_block();
+  write_raw(buf.data(), buf.size());
+}
+
+void writer::write_raw(const void *data, size_t length) {
+  const char *p = static_cast<const char *>(data);
+  bytes_written += length;
+  while (length > 0) {
+    size_t n = std::min(length, size_t(block_size) - current.size());
+    current.append(p, n);
+    p += n;
+    length -= n;
+    if (current.size() >= block_size) {
+      flush_block();
+      continued = length > 0;
+    }
+  }
+}
+
+void writer::flush_block() {
+  if (current.empty())
+    return;
+  block_info info;
+  info.offset = offset;
+  info.raw_length = uint32_t(current.size());
+  info.crc = checksum(current.data(), current.size());
+  info.type = NONE;
+  info.continued = continued;
+  continued = false;
+  const std::string *stored = &current;
+  std::string compressed;
+  if (level > 0) {
+    uLongf bound = compressBound(uLong(current.size()));
+    compressed.resize(bound);
+    int r = compress2(reinterpret_cast<Bytef *>(&compressed[0]), &bound,
+                      reinterpret_cast<const Bytef *>(current.data()),
+                      uLong(current.size()), level);
+    if (r == Z_OK && bound < current.size()) {
+      compressed.resize(bound);
+      stored = &compressed;
+      info.type = ZLIB;
+    }
+  }
+  info.stored_length = uint32_t(stored->size());
+  write_fully(stored->data(), stored->size());
+  index.push_back(info);
+  current.clear();
+}
+
+void writer::close() {
+  if (fd < 0)
+    return;
+  flush_block();
+  uint64_t index_offset = offset;
+  std::string trailer;
+  trailer.reserve(index.size() * INDEX_ENTRY_BYTES + FOOTER_BYTES);
+  for (auto &info : index) {
+    put64(trailer, info.offset);
+    put32(trailer, info.stored_length);
+    put32(trailer, info.raw_length);
+    put32(trailer, info.crc);
+    trailer.push_back(char(info.type));
+    trailer.push_back(char(info.continued ? 1 : 0));
+  }
+  uint32_t index_crc = checksum(trailer.data(), trailer.size());
+  put64(trailer, index_offset);
+  put32(trailer, uint32_t(index.size()));
+  put32(trailer, index_crc);
+  trailer.append(MAGIC, sizeof(MAGIC));
+  write_fully(trailer.data(), trailer.size());
+  int r = fsync(fd);
+  int err = errno;
+  ::close(fd);
+  fd = -1;
+  if (r != 0)
+    throw exception(fmt("Could not fsync %s: %s", path.c_str(), strerror(err)));
+}
+
+uint64_t writer::file_bytes() const { return offset; }
+
+void writer::write_fully(const void *data, size_t length) {
+  const char *p = static_cast<const char *>(data);
+  while (length > 0) {
+    ssize_t r = ::write(fd, p, length);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r < 0)
+      throw exception(
+          fmt("Could not write %s: %s", path.c_str(), strerror(errno)));
+    p += r;
+    offset += uint64_t(r);
+    length -= size_t(r);
+  }
+}
+
+reader::reader(const std::string &path)
+    : fd(-1), path(path), block_size(0), index(), next_block(0), current(),
+      pos(0), bytes_read(0) {
+  fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw exception(
+        fmt("Could not open %s: %s", path.c_str(), strerror(errno)));
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      uint64_t(st.st_size) < HEADER_BYTES + FOOTER_BYTES) {
+    ::close(fd);
+    throw exception(fmt("%s is too short to be a snapshot", path.c_str()));
+  }
+  try {
+    char header[HEADER_BYTES];
+    read_fully(fd, header, sizeof(header), 0, path);
+    if (memcmp(header, MAGIC, sizeof(MAGIC)) != 0)
+      throw exception(fmt("%s is not a snapshot file", path.c_str()));
+    uint32_t version = get32(header + sizeof(MAGIC));
+    if (version != VERSION)
+      throw exception(fmt("%s has unsupported snapshot version %u",
+                          path.c_str(), version));
+    block_size = get32(header + sizeof(MAGIC) + 4);
+    if (block_size == 0)
+      throw exception(fmt("%s has a block size of 0", path.c_str()));
+
+    char footer[FOOTER_BYTES];
+    uint64_t footer_offset = uint64_t(st.st_size) - FOOTER_BYTES;
+    read_fully(fd, footer, sizeof(footer), footer_offset, path);
+    if (memcmp(footer + 16, MAGIC, sizeof(MAGIC)) != 0)
+      throw exception(fmt("%s is truncated (no footer)", path.c_str()));
+    uint64_t index_offset = get64(footer);
+    uint32_t count = get32(footer + 8);
+    uint32_t index_crc = get32(footer + 12);
+    if (index_offset + uint64_t(count) * INDEX_ENTRY_BYTES != footer_offset)
+      throw exception(fmt("%s has a corrupt footer", path.c_str()));
+
+    std::string raw(count * INDEX_ENTRY_BYTES, '\0');
+    read_fully(fd, &raw[0], raw.size(), index_offset, path);
+    if (checksum(raw.data(), raw.size()) != index_crc)
+      throw exception(fmt("%s has a corrupt block index", path.c_str()));
+    index.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+      const char *p = raw.data() + i * INDEX_ENTRY_BYTES;
+      block_info info;
+      info.offset = get64(p);
+      info.stored_length = get32(p + 8);
+      info.raw_length = get32(p + 12);
+      info.crc = get32(p + 16);
+      info.type = codec(uint8_t(p[20]));
+      info.continued = p[21] != 0;
+      if (info.offset + info.stored_length > index_offset)
+        throw exception(fmt("%s block %u is out of range", path.c_str(), i));
+      index.push_back(info);
+    }
+  } catch (...) {
+    ::close(fd);
+    throw;
+  }
+}
+
+reader::~reader() {
+  if (fd >= 0)
+    ::close(fd);
+}
+
+size_t reader::get_bytes_read() const { return bytes_read; }
+
+std::string reader::readMessage(google::protobuf::Message &msg) {
+  char header[4];
+  if (readRaw(header, sizeof(header)) != sizeof(header))
+    return "Failed to read the length of the message";
+  uint32_t length = get32(header);
+  std::string buf(length, '\0');
+  if (readRaw(&buf[0], length) != length)
+    return fmt("Failed to read message of %u bytes", length);
+  if (!msg.ParseFromString(buf))
+    return fmt("Failed to parse message of type %s",
+               msg.GetTypeName().c_str());
+  return "";
+}
+
+size_t reader::readRaw(void *data, size_t length) {
+  char *p = static_cast<char *>(data);
+  size_t done = 0;
+  while (done < length && fill()) {
+    size_t n = std::min(length - done, current.size() - pos);
+    memcpy(p + done, current.data() + pos, n);
+    pos += n;
+    done += n;
+  }
+  bytes_read += done;
+  return done;
+}
+
+uint64_t reader::raw_bytes() const {
+  uint64_t total = 0;
+  for (auto &info : index)
+    total += info.raw_length;
+  return total;
+}
+
+std::string reader::decode_block(size_t i) const {
+  const block_info &info = index.at(i);
+  std::string stored(info.stored_length, '\0');
+  read_fully(fd, &stored[0], stored.size(), info.offset, path);
+  std::string raw;
+  switch (info.type) {
+  case NONE:
+    raw = std::move(stored);
+    break;
+  case ZLIB: {
+    raw.resize(info.raw_length);
+    uLongf length = info.raw_length;
+    int r = uncompress(reinterpret_cast<Bytef *>(&raw[0]), &length,
+                       reinterpret_cast<const Bytef *>(stored.data()),
+                       uLong(stored.size()));
+    if (r != Z_OK || length != info.raw_length)
+      throw exception(fmt("%s block %lu failed to decompress (zlib error %d)",
+                          path.c_str(), i, r));
+    break;
+  }
+  default:
+    throw exception(fmt("%s block %lu has unknown codec %u", path.c_str(), i,
+                        unsigned(info.type)));
+  }
+  if (raw.size() != info.raw_length ||
+      checksum(raw.data(), raw.size()) != info.crc)
+    throw exception(fmt("%s block %lu failed checksum", path.c_str(), i));
+  return raw;
+}
+
+std::vector<size_t> reader::runs() const {
+  std::vector<size_t> starts;
+  for (size_t i = 0; i < index.size(); ++i) {
+    if (!index[i].continued || starts.empty())
+      starts.push_back(i);
+  }
+  return starts;
+}
+
+bool reader::fill() {
+  while (pos >= current.size()) {
+    if (next_block >= index.size())
+      return false;
+    current = decode_block(next_block++);
+    pos = 0;
+  }
+  return true;
+}
+
+void for_each_run(const reader &r, size_t threads,
+                  const std::function<void(size_t run, const std::string &raw)>
+                      &visit) {
+  std::vector<size_t> starts = r.runs();
+  if (threads == 0)
+    threads = std::max(1U, std::thread::hardware_concurrency());
+  threads = std::min(threads, starts.size());
+
+  std::atomic<size_t> next(0);
+  std::mutex mtx;
+  std::exception_ptr error;
+  auto worker = [&]() {
+    while (true) {
+      size_t run = next++;
+      if (run >= starts.size())
+        return;
+      try {
+        size_t first = starts[run];
+        size_t last =
+            run + 1 < starts.size() ? starts[run + 1] : r.num_blocks();
+        std::string raw = r.decode_block(first);
+        for (size_t i = first + 1; i < last; ++i)
+          raw += r.decode_block(i);
+        visit(run, raw);
+      } catch (...) {
+        std::lock_guard<std::mutex> lg(mtx);
+        if (!error)
+          error = std::current_exception();
+        next = starts.size();
+        return;
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < threads; ++i)
+    workers.emplace_back(worker);
+  worker();
+  for (auto &t : workers)
+    t.join();
+  if (error)
+    std::rethrow_exception(error);
+}
+
+} // namespace snapshot_file
+} // namespace storage
+} // namespace ors
@@ -0,0 +1,62 @@
+#include <cstring>
+#include <functional>
+
+#include <tree/file.h>
+
+namespace ors {
+namespace tree {
+
+digest digest::of(std::string_view contents) {
+  return {contents.size(), std::hash<std::string_view>()(contents)};
+}
+
+file::file() : data(), sum(digest::of(data)) {}
+
+file::file(std::string contents)
+    : data(std::move(contents)), sum(digest::of(data)) {}
+
+void file::write(std::string contents) {
+  data = std::move(contents);
+  sum = digest::of(data);
+}
+
+void condition_stats::update_server_stats(
+    proto::ServerStats::Tree &stats) const {
+  stats.set_num_conditions_checked(num_checked);
+  stats.set_num_conditions_failed(num_failed);
+  stats.set_num_conditions_length_rejected(num_length_rejected);
+  stats.set_num_conditions_hash_rejected(num_hash_rejected);
+  stats.set_num_conditions_full_compares(num_full_compares);
+}
+
+bool check_condition(const file *f, std::string_view expected,
+                     const digest &expected_digest, condition_stats &stats) {
+  ++stats.num_checked;
+  bool ok;
+  if (f == nullptr) {
+    ok = expected.empty();
+  } else if (f->digest().length != expected.size()) {
+    ++stats.num_length_rejected;
+    ok = false;
+  } else if (f->digest().hash != expected_digest.hash) {
+    ++stats.num_hash_rejected;
+    ok = false;
+  } else {
+    // equal hashes are not proof: confirm against the bytes
+    ++stats.num_full_compares;
+    ok = memcmp(f->contents().data(), expected.data(), expected.size()) == 0;
+  }
+  if (!ok)
+    ++stats.num_failed;
+  return ok;
+}
+
+bool check_condition(const file *f, std::string_view expected,
+                     condition_stats &stats) {
+  if (f != nullptr && f->digest().length != expected.size())
+    return check_condition(f, expected, digest{expected.size(), 0}, stats);
+  return check_condition(f, expected, digest::of(expected), stats);
+}
+
+} // namespace tree
+} // namespace ors
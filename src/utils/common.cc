@@ -5,6 +5,9 @@
 #include <cstring>
 #include <fcntl.h>
 #include <functional>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include <locale>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -21,37 +24,89 @@ bool displayable(char c) { return c >= 32 && c < 127; }
 bool printable(const char *str) { return printable(str, strlen(str) + 1); }
 
 bool printable(const void *data, size_t length) {
-  const char *begin = static_cast<const char *>(data);
-  const char *end = begin + length - 1;
-  return (length >= 1 && *end == '\0' && std::all_of(begin, end, displayable));
+  if (length == 0)
+    return false;
+  const char *p = static_cast<const char *>(data);
+  size_t n = length - 1;
+  if (p[n] != '\0')
+    return false;
+  size_t i = 0;
+#ifdef __SSE2__
+  // signed compares: bytes from 128 up are negative, so fail the low bound
+  const __m128i low = _mm_set1_epi8(31);
+  const __m128i high = _mm_set1_epi8(127);
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+    __m128i ok =
+        _mm_and_si128(_mm_cmpgt_epi8(v, low), _mm_cmplt_epi8(v, high));
+    if (_mm_movemask_epi8(ok) != 0xffff)
+      return false;
+  }
+#endif
+  return std::all_of(p + i, p + n, displayable);
 }
 
+namespace {
+/**
+ * Append the formatted output to out. The first attempt uses up to 1 KB of
+ * out's spare capacity (resize() zero-fills, so not all of it); longer
+ * output takes a second attempt at the exact size.
+ */
+void vappend(std::string &out, const char *format, va_list ap) {
+  size_t offset = out.size();
+  size_t spare = out.capacity() - offset;
+  out.resize(offset + std::min<size_t>(std::max<size_t>(spare, 64), 1024));
+  size_t room = out.size() - offset;
+  // vsnprintf trashes the va_list, so copy it first
+  va_list aq;
+  va_copy(aq, ap);
+  int r = vsnprintf(&out[offset], room, format, aq);
+  va_end(aq);
+  assert(r >= 0); // old glibc versions returned -1
+  size_t length = size_t(r);
+  if (length >= room) {
+    out.resize(offset + length + 1);
+    vsnprintf(&out[offset], length + 1, format, ap);
+  }
+  out.resize(offset + length);
+}
+
+/// Scratch space that survives between calls on the same thread.
+thread_local std::string fmt_buffer;
+thread_local std::string fmt_view_buffer;
+
+/// Larger buffers are released after use rather than kept per thread.
+constexpr size_t MAX_KEPT_BUFFER = 64 * 1024;
+} // namespace
+
 std::string fmt(const char *format, ...) {
-  std::string s;
+  fmt_buffer.clear();
   va_list ap;
   va_start(ap, format);
+  vappend(fmt_buffer, format, ap);
+  va_end(ap);
+  std::string s(fmt_buffer);
+  if (fmt_buffer.capacity() > MAX_KEPT_BUFFER)
+    std::string().swap(fmt_buffer);
+  return s;
+}
 
-  // We're not really sure how big of a buffer will be necessary.
-  // Try 1K, if not the return value will tell us how much is necessary.
-  size_t buf_size = 1024;
-  while (true) {
-    char buf[buf_size];
-    // vsnprintf trashes the va_list, so copy it first
-    va_list aq;
-    va_copy(aq, ap);
-    int r = vsnprintf(buf, buf_size, format, aq);
-    va_end(aq);
-    assert(r >= 0); // old glibc versions returned -1
-    size_t r2 = size_t(r);
-    if (r2 < buf_size) {
-      s = buf;
-      break;
-    }
-    buf_size = r2 + 1;
-  }
+void append_fmt(std::string &out, const char *format, ...) {
+  va_list ap;
+  va_start(ap, format);
+  vappend(out, format, ap);
+  va_end(ap);
+}
 
+std::string_view fmt_view(const char *format, ...) {
+  if (fmt_view_buffer.capacity() > MAX_KEPT_BUFFER)
+    std::string().swap(fmt_view_buffer);
+  fmt_view_buffer.clear();
+  va_list ap;
+  va_start(ap, format);
+  vappend(fmt_view_buffer, format, ap);
   va_end(ap);
-  return s;
+  return fmt_view_buffer;
 }
 
 std::string flags(int value,
@@ -70,36 +125,39 @@ std::string flags(int value,
   return join(strings, "|");
 }
 
-std::string trim(const std::string &original) {
-  std::string s = original;
-  s.erase(std::find_if(s.rbegin(), s.rend(),
-                       std::not1(std::ptr_fun<int, int>(std::isspace)))
-              .base(),
-          s.end());
-  s.erase(s.begin(),
-          std::find_if(s.begin(), s.end(),
-                       std::not1(std::ptr_fun<int, int>(std::isspace))));
-  return std::move(s);
+std::string trim(std::string_view s) { return std::string(trim_view(s)); }
+
+std::string_view trim_view(std::string_view s) {
+  auto space = [](char c) {
+    return std::isspace(static_cast<unsigned char>(c)) != 0;
+  };
+  while (!s.empty() && space(s.front()))
+    s.remove_prefix(1);
+  while (!s.empty() && space(s.back()))
+    s.remove_suffix(1);
+  return s;
 }
 
 std::string join(const std::vector<std::string> &components,
                  const std::string &glue) {
   std::string r;
+  size_t length = 0;
+  for (const auto &c : components)
+    length += c.size() + glue.size();
+  r.reserve(length);
   for (size_t i = 0; i < components.size(); ++i) {
-    r += components.at(i);
+    r += components[i];
     if (i < components.size() - 1)
       r += glue;
   }
-  return std::move(r);
+  return r;
 }
 
-std::vector<std::string> split(const std::string &subject, char delimiter) {
+std::vector<std::string> split(std::string_view subject, char delimiter) {
   std::vector<std::string> items;
-  std::istringstream stream(subject);
-  std::string item;
-  while (std::getline(stream, item, delimiter))
-    items.push_back(std::move(item));
-  return std::move(items);
+  for (std::string_view item : split_view(subject, delimiter))
+    items.emplace_back(item);
+  return items;
 }
 
 void replace_all(std::string &haystack, const std::string &needle,
@@ -114,17 +172,6 @@ void replace_all(std::string &haystack, const std::string &needle,
   }
 }
 
-bool starts_with(const std::string &haystack, const std::string &needle) {
-  return (haystack.compare(0, needle.length(), needle) == 0);
-}
-
-bool ends_with(const std::string &haystack, const std::string &needle) {
-  if (haystack.length() < needle.length())
-    return false;
-  return (haystack.compare(haystack.length() - needle.length(), needle.length(),
-                           needle) == 0);
-}
-
 } // namespace string
 } // namespace utils
 } // namespace ors
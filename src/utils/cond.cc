@@ -1,19 +1,18 @@
-#include <spdlog/spdlog.h>
+#include <cerrno>
+#include <climits>
 #include <string.h>
 #include <utils/cond.h>
+#include <utils/futex.h>
+#include <utils/log.h>
 
 namespace ors {
 namespace utils {
+
 condition_variable::condition_variable()
-    : cv(), cb(), notify_count(0), last_wu() {
-  init();
-}
+    : seq(0), waiters(0), requeue_to(nullptr), cb(), notify_count(0),
+      last_wu() {}
 
-condition_variable::~condition_variable() {
-  int ret = pthread_cond_destroy(&cv);
-  if (ret != 0)
-    spdlog::error("pthread_cond_destroy : %s", strerror(ret));
-}
+condition_variable::~condition_variable() {}
 
 void condition_variable::notify(notify_type t) {
   switch (t) {
@@ -30,89 +29,119 @@ void condition_variable::notify(notify_type t) {
 
 void condition_variable::notify_one() {
   ++notify_count;
-  int ret = pthread_cond_signal(&cv);
-  if (ret != 0)
-    spdlog::error("pthread_cond_signal : %s", strerror(ret));
+  // a waiter registers while holding its mutex, so a notifier that changed
+  // the condition under that mutex sees it here
+  if (waiters.load() == 0)
+    return;
+  seq.fetch_add(1, std::memory_order_release);
+  futex::wake(&seq, 1);
 }
 
 void condition_variable::notify_all() {
   ++notify_count;
-  int ret = pthread_cond_broadcast(&cv);
-  if (ret != 0)
-    spdlog::error("pthread_cond_broadcast : %s", strerror(ret));
-}
-
-void condition_variable::wait(std::unique_lock<std::mutex> &ul) {
-  if (cb) {
-    ul.unlock();
-    cb();
-    ul.lock();
-  } else {
-    pthread_mutex_t *mutex = ul.mutex()->native_handle();
-    int ret = pthread_cond_wait(&cv, mutex);
-    if (ret != 0)
-      spdlog::error("pthread_cond_wait : %s", strerror(ret));
+  if (waiters.load() == 0)
+    return;
+  uint32_t s = seq.fetch_add(1, std::memory_order_release) + 1;
+  std::atomic<uint32_t> *target = requeue_to.load();
+  if (target == nullptr ||
+      futex::cmp_requeue(&seq, 1, INT_MAX, target, s) < 0) {
+    futex::wake(&seq, INT_MAX);
+    return;
+  }
+  // Requeued waiters are only woken by an unlock that finds the lock
+  // CONTENDED (each one relocks it that way, which passes the baton on).
+  // Make sure the first such unlock happens.
+  uint32_t c = target->load();
+  for (;;) {
+    if (c == adaptive_mutex::CONTENDED)
+      break;
+    if (c == adaptive_mutex::LOCKED) {
+      if (target->compare_exchange_weak(c, adaptive_mutex::CONTENDED))
+        break;
+      continue;
+    }
+    futex::wake(target, 1); // unlocked: let one requeued waiter take it
+    break;
   }
 }
 
-void condition_variable::wait(std::unique_lock<utils::mutex> &ul) {
-  utils::mutex &mutex(*ul.mutex());
-  if (mutex.cb)
-    mutex.cb();
+void condition_variable::wait(std::unique_lock<std::mutex> &ul) {
   assert(ul);
-  std::unique_lock<std::mutex> stdLockGuard(mutex.mtx, std::adopt_lock_t());
-  ul.release();
-  wait(stdLockGuard);
-  assert(stdLockGuard);
-  ul = std::unique_lock<utils::mutex>(mutex, std::adopt_lock_t());
-  stdLockGuard.release();
-  if (mutex.cb)
-    mutex.cb();
+  block(*ul.mutex(), nullptr);
 }
 
 void condition_variable::wait_until(
     std::unique_lock<std::mutex> &ul,
     const utils::time::steady_clock::time_point &abs_tp) {
+  assert(ul);
   last_wu = abs_tp;
+  block(*ul.mutex(), &abs_tp);
+}
+
+template <typename lockable>
+void condition_variable::block(
+    lockable &m, const time::steady_clock::time_point *deadline) {
   if (cb) {
-    ul.unlock();
+    m.unlock();
     cb();
-    ul.lock();
-  } else {
+    m.lock();
+    return;
+  }
+  // with steady_clock mocked, sleep until a notify or a change of mocked
+  // time, and let the caller re-check its deadline against mocked time
+  const bool mocked =
+      deadline != nullptr && time::steady_clock::is_mock_value.load();
+  struct timespec wakespec;
+  if (deadline != nullptr && !mocked) {
     utils::time::steady_clock::time_point now =
         utils::time::steady_clock::now();
     utils::time::steady_clock::time_point wake =
-        std::min(abs_tp, now + std::chrono::hours(1));
+        std::min(*deadline, now + std::chrono::hours(1));
     if (wake < now)
       return;
-    struct timespec wakespec = utils::time::make_timespec(wake);
-    pthread_mutex_t *mutex = ul.mutex()->native_handle();
-    int ret = pthread_cond_timedwait(&cv, mutex, &wakespec);
-    switch (ret) {
-    case 0:
-      break;
-    case ETIMEDOUT:
-      break;
-    default:
-      spdlog::error("pthread_cond_timedwait : %s", strerror(ret));
-    }
+    wakespec = utils::time::make_timespec(wake);
+  }
+
+  requeue_to.store(requeue_word(m));
+  waiters.fetch_add(1);
+  if (mocked)
+    time::detail::add_mock_sleeper(&seq);
+  uint32_t s = seq.load(std::memory_order_acquire);
+  if (mocked && time::steady_clock::now() >= *deadline) {
+    time::detail::remove_mock_sleeper(&seq);
+    waiters.fetch_sub(1);
+    return;
   }
+  m.unlock();
+  int ret = deadline == nullptr || mocked
+                ? futex::wait(&seq, s)
+                : futex::wait_until(&seq, s, &wakespec);
+  if (ret != 0 && errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT)
+    ORS_ERROR("futex wait: {}", strerror(errno));
+  relock(m);
+  if (mocked)
+    time::detail::remove_mock_sleeper(&seq);
+  waiters.fetch_sub(1);
+}
+
+template void
+condition_variable::block(std::mutex &m,
+                          const time::steady_clock::time_point *deadline);
+template void
+condition_variable::block(adaptive_mutex &m,
+                          const time::steady_clock::time_point *deadline);
+
+std::atomic<uint32_t> *condition_variable::requeue_word(std::mutex &) {
+  return nullptr;
 }
 
-void condition_variable::init() {
-  pthread_condattr_t cvattr;
-  int ret = pthread_condattr_init(&cvattr);
-  if (ret != 0)
-    spdlog::error("pthread_condattr_init : %s", strerror(ret));
-  ret = pthread_condattr_setclock(&cvattr, utils::time::STEADY_CLOCK_ID);
-  if (ret != 0)
-    spdlog::error("pthread_condattr_setclock : %s", strerror(ret));
-  ret = pthread_cond_init(&cv, &cvattr);
-  if (ret != 0)
-    spdlog::error("pthread_cond_init : %s", strerror(ret));
-  ret = pthread_condattr_destroy(&cvattr);
-  if (ret != 0)
-    spdlog::error("pthread_condattr_destroy : %s", strerror(ret));
+std::atomic<uint32_t> *condition_variable::requeue_word(adaptive_mutex &m) {
+  return &m.state;
 }
+
+void condition_variable::relock(std::mutex &m) { m.lock(); }
+
+void condition_variable::relock(adaptive_mutex &m) { m.lock_contended(); }
+
 } // namespace utils
-} // namespace ors
\ No newline at end of file
+} // namespace ors
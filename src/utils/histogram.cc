@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <utils/histogram.h>
+
+namespace ors {
+namespace utils {
+
+namespace {
+constexpr auto relaxed = std::memory_order_relaxed;
+
+/// Bucket holding the rank-th smallest sample (rank starts at 1).
+size_t bucket_at_rank(const uint64_t *buckets, uint64_t rank) {
+  uint64_t seen = 0;
+  for (size_t i = 0; i < log_linear_buckets::COUNT; ++i) {
+    seen += buckets[i];
+    if (seen >= rank)
+      return i;
+  }
+  return log_linear_buckets::COUNT - 1;
+}
+
+uint64_t quantile_of(const uint64_t *buckets, uint64_t count, double q) {
+  if (count == 0)
+    return 0;
+  uint64_t rank = uint64_t(std::ceil(q * double(count)));
+  rank = std::min(std::max<uint64_t>(rank, 1), count);
+  return log_linear_buckets::upper_bound(bucket_at_rank(buckets, rank));
+}
+} // namespace
+
+histogram::counts::counts() : buckets() { clear(); }
+
+void histogram::counts::clear() {
+  for (auto &b : buckets)
+    b.store(0, relaxed);
+}
+
+histogram::slot::slot() : epoch(UINT64_MAX), data() {}
+
+histogram::histogram(std::chrono::nanoseconds slot_nanos)
+    : slot_nanos(std::max<int64_t>(slot_nanos.count(), 1)), total(),
+      window(new slot[WINDOW_SLOTS]) {}
+
+histogram::~histogram() {}
+
+void histogram::record(uint64_t value) {
+  record(value, time::coarse_clock::now());
+}
+
+void histogram::record(uint64_t value, time::steady_clock::time_point now) {
+  size_t i = log_linear_buckets::index(value);
+  total.buckets[i].fetch_add(1, relaxed);
+
+  uint64_t epoch = uint64_t(
+      std::chrono::nanoseconds(now.time_since_epoch()).count() / slot_nanos);
+  slot &s = window[epoch % WINDOW_SLOTS];
+  uint64_t seen = s.epoch.load(std::memory_order_acquire);
+  if (seen != epoch) {
+    // first sample of a new interval in this slot: whoever wins the CAS
+    // clears out the old interval's counts
+    if (seen < epoch || seen == UINT64_MAX) {
+      if (s.epoch.compare_exchange_strong(seen, epoch,
+                                          std::memory_order_acq_rel))
+        s.data.clear();
+    } else {
+      return; // sample older than the slot's interval; only count in total
+    }
+  }
+  s.data.buckets[i].fetch_add(1, relaxed);
+}
+
+void histogram::update_proto(proto::LatencyStat &out) const {
+  std::vector<uint64_t> merged(log_linear_buckets::COUNT);
+  for (size_t i = 0; i < log_linear_buckets::COUNT; ++i)
+    merged[i] = total.buckets[i].load(relaxed);
+  fill_histogram(merged.data(), 0, *out.mutable_total());
+
+  uint64_t now = uint64_t(
+      std::chrono::nanoseconds(time::steady_clock::now().time_since_epoch())
+          .count() /
+      slot_nanos);
+  std::fill(merged.begin(), merged.end(), 0);
+  for (size_t w = 0; w < WINDOW_SLOTS; ++w) {
+    const slot &s = window[w];
+    uint64_t epoch = s.epoch.load(std::memory_order_acquire);
+    if (epoch == UINT64_MAX || epoch > now || now - epoch >= WINDOW_SLOTS)
+      continue;
+    for (size_t i = 0; i < log_linear_buckets::COUNT; ++i)
+      merged[i] += s.data.buckets[i].load(relaxed);
+  }
+  fill_histogram(merged.data(), slot_nanos * int64_t(WINDOW_SLOTS),
+                 *out.mutable_window());
+}
+
+uint64_t histogram::count() const {
+  uint64_t count = 0;
+  for (auto &b : total.buckets)
+    count += b.load(relaxed);
+  return count;
+}
+
+uint64_t histogram::quantile(double q) const {
+  std::vector<uint64_t> merged(log_linear_buckets::COUNT);
+  uint64_t count = 0;
+  for (size_t i = 0; i < log_linear_buckets::COUNT; ++i) {
+    merged[i] = total.buckets[i].load(relaxed);
+    count += merged[i];
+  }
+  return quantile_of(merged.data(), count, q);
+}
+
+void fill_histogram(const uint64_t *buckets, int64_t window_nanos,
+                    proto::Histogram &out) {
+  out.Clear();
+  out.set_window_nanos(window_nanos);
+  uint64_t count = 0;
+  size_t first = log_linear_buckets::COUNT;
+  size_t last = 0;
+  for (size_t i = 0; i < log_linear_buckets::COUNT; ++i) {
+    if (buckets[i] == 0)
+      continue;
+    count += buckets[i];
+    first = std::min(first, i);
+    last = i;
+    proto::Histogram::Bucket &b = *out.add_bucket();
+    b.set_upper_bound(log_linear_buckets::upper_bound(i));
+    b.set_count(buckets[i]);
+  }
+  out.set_count(count);
+  if (count == 0)
+    return;
+  out.set_min(first == 0 ? 0 : log_linear_buckets::upper_bound(first - 1) + 1);
+  out.set_max(log_linear_buckets::upper_bound(last));
+  out.set_p50(quantile_of(buckets, count, 0.50));
+  out.set_p90(quantile_of(buckets, count, 0.90));
+  out.set_p99(quantile_of(buckets, count, 0.99));
+  out.set_p999(quantile_of(buckets, count, 0.999));
+}
+
+} // namespace utils
+} // namespace ors
@@ -0,0 +1,206 @@
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <limits.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <utils/common.h>
+#include <utils/live_config.h>
+#include <utils/log.h>
+#include <utils/tid.h>
+#include <utils/time.h>
+
+namespace ors {
+namespace utils {
+
+namespace {
+config read_config(const std::string &filename) {
+  config c;
+  c.read_file(filename);
+  return c;
+}
+
+const char *type_name(live_config::type t) {
+  switch (t) {
+  case live_config::INTEGER:
+    return "integer";
+  case live_config::DURATION:
+    return "duration";
+  case live_config::BOOLEAN:
+    return "boolean";
+  }
+  return "unknown";
+}
+
+/// Split a path into its directory and file name.
+std::pair<std::string, std::string> split_path(const std::string &path) {
+  size_t slash = path.rfind('/');
+  if (slash == path.npos)
+    return {".", path};
+  return {slash == 0 ? "/" : path.substr(0, slash), path.substr(slash + 1)};
+}
+} // namespace
+
+live_config::live_config(const std::string &filename)
+    : filename(filename), mtx("live_config"), current(read_config(filename)),
+      entries(), callbacks(), reloads(0), failed_reloads(0), stop_fd(-1),
+      watcher() {}
+
+live_config::~live_config() { stop(); }
+
+live_config::handle<int64_t> live_config::integer(const std::string &key,
+                                                  int64_t default_value) {
+  return handle<int64_t>(
+      add(key, INTEGER, utils::string::to_string(default_value)));
+}
+
+live_config::duration_handle
+live_config::duration(const std::string &key,
+                      const std::string &default_value) {
+  return duration_handle(handle<uint64_t>(add(key, DURATION, default_value)));
+}
+
+live_config::handle<bool> live_config::boolean(const std::string &key,
+                                               bool default_value) {
+  return handle<bool>(add(key, BOOLEAN, default_value ? "true" : "false"));
+}
+
+const live_config::entry *live_config::add(const std::string &key, type t,
+                                           const std::string &default_value) {
+  std::lock_guard<utils::mutex> lg(mtx);
+  auto it = entries.find(key);
+  if (it != entries.end()) {
+    if (it->second->t != t)
+      throw config::exception(utils::string::fmt(
+          "config key %s is registered as %s, not %s", key.c_str(),
+          type_name(it->second->t), type_name(t)));
+    return it->second.get();
+  }
+  std::unique_ptr<entry> e(new entry{t, default_value, {0}});
+  e->value.store(parse(current, key, *e));
+  return entries.emplace(key, std::move(e)).first->second.get();
+}
+
+uint64_t live_config::parse(const config &c, const std::string &key,
+                            const entry &e) {
+  std::string value = c.read(key, e.default_value);
+  switch (e.t) {
+  case INTEGER:
+    return uint64_t(config::from_string<int64_t>(key, value));
+  case DURATION:
+    try {
+      return time::parse_non_negative_duration(value);
+    } catch (const time::invalid_time_description &ex) {
+      throw config::conversion_error(key, value, "duration");
+    }
+  case BOOLEAN:
+    return config::from_string<bool>(key, value);
+  }
+  return 0;
+}
+
+std::string live_config::reload() {
+  std::vector<std::function<void()>> to_call;
+  {
+    std::lock_guard<utils::mutex> lg(mtx);
+    try {
+      config c = read_config(filename);
+      // parse everything before publishing anything
+      std::vector<std::pair<entry *, uint64_t>> values;
+      for (auto &kv : entries)
+        values.emplace_back(kv.second.get(), parse(c, kv.first, *kv.second));
+      for (auto &v : values)
+        v.first->value.store(v.second, std::memory_order_relaxed);
+      current.contents = std::move(c.contents);
+    } catch (const config::exception &e) {
+      ++failed_reloads;
+      ORS_WARNING("Not reloading {}: {}", filename, e.what());
+      return e.what();
+    }
+    ++reloads;
+    to_call = callbacks;
+  }
+  ORS_NOTICE("Reloaded {}", filename);
+  for (auto &fn : to_call)
+    fn();
+  return "";
+}
+
+void live_config::on_reload(std::function<void()> fn) {
+  std::lock_guard<utils::mutex> lg(mtx);
+  callbacks.push_back(std::move(fn));
+}
+
+void live_config::watch() {
+  if (watcher.joinable())
+    return;
+  int fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+  if (fd < 0)
+    throw config::exception(
+        utils::string::fmt("inotify_init1 failed: %s", strerror(errno)));
+  std::string dir = split_path(filename).first;
+  // not IN_CREATE: a file just created is usually still empty
+  if (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    int error = errno;
+    close(fd);
+    throw config::exception(utils::string::fmt(
+        "Could not watch %s: %s", dir.c_str(), strerror(error)));
+  }
+  stop_fd = eventfd(0, EFD_CLOEXEC);
+  if (stop_fd < 0) {
+    int error = errno;
+    close(fd);
+    throw config::exception(
+        utils::string::fmt("eventfd failed: %s", strerror(error)));
+  }
+  watcher = std::thread(&live_config::watcher_main, this, fd);
+}
+
+void live_config::stop() {
+  if (!watcher.joinable())
+    return;
+  uint64_t one = 1;
+  if (write(stop_fd, &one, sizeof(one)) != sizeof(one))
+    ORS_ERROR("Could not stop the watcher of {}: {}", filename,
+              strerror(errno));
+  watcher.join();
+  close(stop_fd);
+  stop_fd = -1;
+}
+
+void live_config::watcher_main(int inotify_fd) {
+  tid::set_name("config-watch");
+  std::string name = split_path(filename).second;
+  alignas(struct inotify_event) char buf[4096];
+  for (;;) {
+    struct pollfd fds[2] = {{inotify_fd, POLLIN, 0}, {stop_fd, POLLIN, 0}};
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      ORS_ERROR("poll failed watching {}: {}", filename, strerror(errno));
+      break;
+    }
+    if (fds[1].revents)
+      break;
+    bool changed = false;
+    ssize_t n;
+    while ((n = read(inotify_fd, buf, sizeof(buf))) > 0) {
+      for (char *p = buf; p < buf + n;) {
+        auto *ev = reinterpret_cast<struct inotify_event *>(p);
+        if (ev->len > 0 && name == ev->name)
+          changed = true;
+        p += sizeof(struct inotify_event) + ev->len;
+      }
+    }
+    // an editor's save shows up as several events; reload once for them
+    if (changed)
+      reload();
+  }
+  close(inotify_fd);
+}
+
+} // namespace utils
+} // namespace ors
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <utils/lock_profiler.h>
+#include <utils/time.h>
+
+namespace ors {
+namespace utils {
+namespace lock_profiler {
+
+namespace detail {
+std::atomic<bool> _enabled(false);
+} // namespace detail
+
+namespace {
+
+constexpr auto relaxed = std::memory_order_relaxed;
+
+/// One thread's counters for one site. Written by that thread only.
+struct alignas(64) shard {
+  shard()
+      : acquisitions(0), contended(0), wait(0), max_wait(0), hold(0),
+        max_hold(0) {}
+  std::atomic<uint64_t> acquisitions;
+  std::atomic<uint64_t> contended;
+  std::atomic<uint64_t> wait;
+  std::atomic<uint64_t> max_wait;
+  std::atomic<uint64_t> hold;
+  std::atomic<uint64_t> max_hold;
+};
+
+struct registry {
+  registry()
+      : mtx(), names({"unnamed"}), ids({{"unnamed", 0}}), shards() {}
+
+  std::mutex mtx;
+  /// Site names by id.
+  std::vector<std::string> names;
+  std::map<std::string, uint32_t> ids;
+  /// Every thread's shards, as (site, shard). Owned here, never freed, so
+  /// counts of exited threads are kept.
+  std::vector<std::pair<uint32_t, std::unique_ptr<shard>>> shards;
+};
+
+/// Never destroyed: mutexes may be locked during static destruction.
+registry &instance() {
+  static registry *r = new registry();
+  return *r;
+}
+
+/// This thread's shards, indexed by site id.
+thread_local std::vector<shard *> _local;
+
+shard &local(uint32_t site) {
+  if (site < _local.size() && _local[site] != nullptr)
+    return *_local[site];
+  registry &r = instance();
+  std::lock_guard<std::mutex> lg(r.mtx);
+  r.shards.emplace_back(site, new shard());
+  if (site >= _local.size())
+    _local.resize(site + 1, nullptr);
+  _local[site] = r.shards.back().second.get();
+  return *_local[site];
+}
+
+void raise(std::atomic<uint64_t> &max, uint64_t v) {
+  if (v > max.load(relaxed))
+    max.store(v, relaxed);
+}
+
+} // namespace
+
+void enable(bool on) {
+  registry &r = instance();
+  std::lock_guard<std::mutex> lg(r.mtx);
+  detail::_enabled.store(on, relaxed);
+}
+
+void reset() {
+  registry &r = instance();
+  std::lock_guard<std::mutex> lg(r.mtx);
+  for (auto &s : r.shards) {
+    s.second->acquisitions.store(0, relaxed);
+    s.second->contended.store(0, relaxed);
+    s.second->wait.store(0, relaxed);
+    s.second->max_wait.store(0, relaxed);
+    s.second->hold.store(0, relaxed);
+    s.second->max_hold.store(0, relaxed);
+  }
+}
+
+uint32_t site_id(const char *name) {
+  registry &r = instance();
+  std::lock_guard<std::mutex> lg(r.mtx);
+  auto it = r.ids.find(name);
+  if (it != r.ids.end())
+    return it->second;
+  uint32_t id = uint32_t(r.names.size());
+  r.names.emplace_back(name);
+  r.ids.emplace(name, id);
+  return id;
+}
+
+void record(uint32_t site, uint64_t wait_ticks, uint64_t hold_ticks,
+            bool contended) {
+  shard &s = local(site);
+  s.acquisitions.store(s.acquisitions.load(relaxed) + 1, relaxed);
+  if (contended)
+    s.contended.store(s.contended.load(relaxed) + 1, relaxed);
+  s.wait.store(s.wait.load(relaxed) + wait_ticks, relaxed);
+  s.hold.store(s.hold.load(relaxed) + hold_ticks, relaxed);
+  raise(s.max_wait, wait_ticks);
+  raise(s.max_hold, hold_ticks);
+}
+
+void update_server_stats(proto::ServerStats::Locks &locks) {
+  registry &r = instance();
+  std::lock_guard<std::mutex> lg(r.mtx);
+  locks.Clear();
+  locks.set_profiling(detail::_enabled.load(relaxed));
+
+  auto nanos = [](uint64_t t) { return uint64_t(time::tsc_clock::to_nanos(t)); };
+
+  std::vector<proto::ServerStats::Locks::Site> sites(r.names.size());
+  for (auto &s : r.shards) {
+    proto::ServerStats::Locks::Site &out = sites[s.first];
+    const shard &in = *s.second;
+    out.set_acquisitions(out.acquisitions() + in.acquisitions.load(relaxed));
+    out.set_contended(out.contended() + in.contended.load(relaxed));
+    out.set_wait_nanos(out.wait_nanos() + nanos(in.wait.load(relaxed)));
+    out.set_max_wait_nanos(
+        std::max(out.max_wait_nanos(), nanos(in.max_wait.load(relaxed))));
+    out.set_hold_nanos(out.hold_nanos() + nanos(in.hold.load(relaxed)));
+    out.set_max_hold_nanos(
+        std::max(out.max_hold_nanos(), nanos(in.max_hold.load(relaxed))));
+  }
+  for (size_t i = 0; i < sites.size(); ++i)
+    sites[i].set_name(r.names[i]);
+  std::stable_sort(sites.begin(), sites.end(),
+                   [](const proto::ServerStats::Locks::Site &a,
+                      const proto::ServerStats::Locks::Site &b) {
+                     return a.wait_nanos() > b.wait_nanos();
+                   });
+  for (auto &s : sites) {
+    if (s.acquisitions() > 0)
+      *locks.add_site() = std::move(s);
+  }
+}
+
+} // namespace lock_profiler
+} // namespace utils
+} // namespace ors
@@ -0,0 +1,748 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <ctime>
+#include <istream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef SPDLOG_FMT_EXTERNAL
+#include <fmt/args.h>
+#else
+#include <spdlog/fmt/bundled/args.h>
+#endif
+
+#include <utils/log.h>
+#include <utils/tid.h>
+
+namespace ors {
+namespace utils {
+namespace log {
+
+namespace {
+
+constexpr auto relaxed = std::memory_order_relaxed;
+
+/// Bytes of ring per logging thread.
+constexpr size_t RING_BYTES = 256 * 1024;
+
+/// How long the writer sleeps when every ring is empty.
+constexpr auto IDLE_WAIT = std::chrono::milliseconds(1);
+
+/// How often binary logs get a fresh clock entry.
+constexpr int64_t CLOCK_ENTRY_NANOS = 1000 * 1000 * 1000;
+
+/**
+ * Binary log entry types. Each entry is its type byte followed by:
+ *  MAGIC:   "ORSLOG", version byte; starts every binary section.
+ *  SITE:    varint id, level byte, varint line, then file, function and
+ *           format as varint length + bytes; precedes the site's first record.
+ *  CLOCK:   tsc (8 bytes), unix nanos (8 bytes), ticks per nanosecond
+ *           (double); maps later records' tsc to real time.
+ *  RECORD:  varint site id, tsc (8 bytes), varint thread id, varint argument
+ *           count, then per argument an arg_tag and its value.
+ *  DROPPED: varint number of records lost to full rings.
+ * Integers in fixed-size fields are little-endian, as written by the host.
+ */
+enum entry_type : uint8_t {
+  ENTRY_MAGIC = 'M',
+  ENTRY_SITE = 'S',
+  ENTRY_CLOCK = 'C',
+  ENTRY_RECORD = 'R',
+  ENTRY_DROPPED = 'D',
+};
+
+const char MAGIC[] = "ORSLOG";
+
+constexpr uint8_t BINARY_VERSION = 1;
+
+int64_t realtime_nanos() {
+  // real time even when tests mock time::system_clock
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return int64_t(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
+/// Maps rdtsc() readings to unix nanoseconds.
+struct tsc_clock {
+  uint64_t tsc;
+  int64_t nanos;
+  double ticks_per_nano;
+
+  int64_t to_nanos(uint64_t t) const {
+    return nanos + int64_t(double(int64_t(t - tsc)) / ticks_per_nano);
+  }
+};
+
+template <typename T> void put_fixed(fmt::memory_buffer &out, T v) {
+  out.append(reinterpret_cast<const char *>(&v),
+             reinterpret_cast<const char *>(&v) + sizeof(v));
+}
+
+/**
+ * Single-producer single-consumer byte ring. Positions only grow; a record
+ * never wraps, so when it does not fit before the end the producer leaves a
+ * padding record there and starts over at offset 0.
+ */
+struct ring {
+  ring() : data(new char[RING_BYTES]), head(0), tail(0), orphaned(false) {}
+
+  std::unique_ptr<char[]> data;
+  /// Written by the owning thread only.
+  alignas(64) std::atomic<uint64_t> head;
+  /// Written by the writer thread only.
+  alignas(64) std::atomic<uint64_t> tail;
+  /// Set when the owning thread exits; the writer frees it once drained.
+  std::atomic<bool> orphaned;
+};
+
+struct logger;
+logger &instance();
+
+struct logger {
+  logger()
+      : mtx(), rings(), modules(), sites(), patterns(),
+        fallback(level::NOTICE), path(), out(stderr), enc(encoding::TEXT),
+        section_started(false), sites_written(),
+        clock{time::rdtsc(), realtime_nanos(), 1.0},
+        last_clock_entry(0), flush_mtx(), wake(), drained(), requested(0),
+        completed(0), dropped(0), reported_dropped(0), writer() {
+    std::atexit([] { flush(); });
+    pthread_atfork(
+        [] {
+          instance().mtx.lock();
+          instance().flush_mtx.lock();
+        },
+        [] {
+          instance().flush_mtx.unlock();
+          instance().mtx.unlock();
+        },
+        [] { instance().after_fork_child(); });
+    start();
+  }
+
+  /// Make the child's logger usable again and restart its writer.
+  void after_fork_child();
+
+  void start() {
+    writer = std::thread([this] { main(); });
+    writer.detach();
+  }
+
+  void main();
+
+  /// Write out everything currently in the rings; returns bytes consumed.
+  size_t drain(fmt::memory_buffer &buf);
+
+  /// Re-anchor clock to real time, with time::tsc_clock's current rate.
+  void calibrate();
+
+  /// Emit the section header and a clock entry if they are due.
+  void begin_binary(fmt::memory_buffer &buf);
+
+  void write_record(detail::record *r, fmt::memory_buffer &buf);
+
+  level level_for(const std::string &file) const;
+
+  /// Guards everything down to the flush state, except the calibration,
+  /// which only the writer touches.
+  std::mutex mtx;
+  std::list<std::unique_ptr<ring>> rings;
+  std::map<std::string, std::unique_ptr<module_level>> modules;
+  std::vector<const detail::site *> sites;
+  std::vector<std::pair<std::string, level>> patterns;
+  level fallback;
+  std::string path;
+  FILE *out;
+  encoding enc;
+  /// Whether out has a MAGIC entry for the current binary section.
+  bool section_started;
+  /// Which sites out has a SITE entry for, by id.
+  std::vector<bool> sites_written;
+
+  tsc_clock clock;
+  /// clock.nanos when the last CLOCK entry was written.
+  int64_t last_clock_entry;
+
+  std::mutex flush_mtx;
+  std::condition_variable wake;
+  std::condition_variable drained;
+  /// Guarded by flush_mtx.
+  uint64_t requested;
+  /// Guarded by flush_mtx.
+  uint64_t completed;
+
+  std::atomic<uint64_t> dropped;
+  /// Part of dropped already noted in the log. Used by the writer only.
+  uint64_t reported_dropped;
+  std::thread writer;
+};
+
+/// Never destroyed: threads may log during static destruction.
+logger &instance() {
+  static logger *l = new logger();
+  return *l;
+}
+
+struct thread_ring {
+  ~thread_ring() {
+    if (r != nullptr)
+      r->orphaned.store(true, std::memory_order_release);
+  }
+  ring *r = nullptr;
+};
+
+thread_local thread_ring _local;
+
+/// Path relative to the source tree, e.g. "src/utils/cond.cc".
+std::string relative(const char *file) {
+  std::string f(file);
+  for (const char *root : {"/src/", "/include/", "/test/", "/bench/"}) {
+    size_t pos = f.rfind(root);
+    if (pos != std::string::npos)
+      return f.substr(pos + 1);
+  }
+  return f;
+}
+
+std::string trim(const std::string &s) {
+  size_t b = s.find_first_not_of(" \t\n");
+  if (b == std::string::npos)
+    return "";
+  size_t e = s.find_last_not_of(" \t\n");
+  return s.substr(b, e - b + 1);
+}
+
+/// The text both encodings render before a record's message.
+void put_prefix(fmt::memory_buffer &buf, int64_t nanos, const char *file,
+                uint32_t line, const char *function, level lvl,
+                uint64_t tid) {
+  fmt::format_to(std::back_inserter(buf), "{}.{:06d} {}:{} in {}() {}[{}]: ",
+                 nanos / 1000000000, (nanos % 1000000000) / 1000,
+                 relative(file), line, function, level_name(lvl), tid);
+}
+
+void put_dropped(fmt::memory_buffer &buf, uint64_t n) {
+  fmt::format_to(std::back_inserter(buf), "{} log messages dropped: ring full\n",
+                 n);
+}
+
+} // namespace
+
+void logger::after_fork_child() {
+  // Only the forking thread survives. The parent's writer may have been
+  // waiting on wake at the fork, leaving a waiter that no longer exists in
+  // the child, so both condition variables start over; flush tickets the
+  // parent handed out will never be completed here.
+  new (&wake) std::condition_variable();
+  new (&drained) std::condition_variable();
+  completed = requested;
+  // Records queued before the fork are the parent's to write. Rings of the
+  // other threads have no owner in the child, so drop them, leaking their
+  // records' arguments rather than running destructors for another
+  // process's objects, and free their buffers.
+  ring *own = _local.r;
+  for (auto it = rings.begin(); it != rings.end();) {
+    if (it->get() == own) {
+      (*it)->tail.store((*it)->head.load(relaxed), relaxed);
+      ++it;
+    } else {
+      it = rings.erase(it);
+    }
+  }
+  flush_mtx.unlock();
+  mtx.unlock();
+  start();
+}
+
+void logger::main() {
+  fmt::memory_buffer buf;
+  for (;;) {
+    uint64_t want;
+    {
+      std::lock_guard<std::mutex> lg(flush_mtx);
+      want = requested;
+    }
+    size_t n = drain(buf);
+    {
+      std::unique_lock<std::mutex> ul(flush_mtx);
+      if (n == 0) {
+        completed = want;
+        drained.notify_all();
+        if (requested == want)
+          wake.wait_for(ul, IDLE_WAIT);
+      }
+    }
+  }
+}
+
+void logger::calibrate() {
+  clock.tsc = time::rdtsc();
+  clock.nanos = realtime_nanos();
+  clock.ticks_per_nano = time::tsc_clock::ticks_per_nano();
+}
+
+void logger::begin_binary(fmt::memory_buffer &buf) {
+  if (!section_started) {
+    buf.push_back(char(ENTRY_MAGIC));
+    buf.append(MAGIC, MAGIC + strlen(MAGIC));
+    buf.push_back(char(BINARY_VERSION));
+    sites_written.clear();
+    last_clock_entry = 0;
+    section_started = true;
+  }
+  if (clock.nanos - last_clock_entry >= CLOCK_ENTRY_NANOS) {
+    buf.push_back(char(ENTRY_CLOCK));
+    put_fixed(buf, clock.tsc);
+    put_fixed(buf, clock.nanos);
+    put_fixed(buf, clock.ticks_per_nano);
+    last_clock_entry = clock.nanos;
+  }
+}
+
+void logger::write_record(detail::record *r, fmt::memory_buffer &buf) {
+  const detail::site &s = *r->where;
+  if (enc == encoding::TEXT) {
+    put_prefix(buf, clock.to_nanos(r->tsc), s.file, s.line, s.function, s.lvl,
+               r->tid);
+    r->render(r, enc, buf);
+    buf.push_back('\n');
+    return;
+  }
+  begin_binary(buf);
+  if (s.id >= sites_written.size())
+    sites_written.resize(s.id + 1, false);
+  if (!sites_written[s.id]) {
+    buf.push_back(char(ENTRY_SITE));
+    detail::put_varint(buf, s.id);
+    buf.push_back(char(s.lvl));
+    detail::put_varint(buf, s.line);
+    detail::put_string(buf, s.file);
+    detail::put_string(buf, s.function);
+    detail::put_string(buf, s.format);
+    sites_written[s.id] = true;
+  }
+  buf.push_back(char(ENTRY_RECORD));
+  detail::put_varint(buf, s.id);
+  put_fixed(buf, r->tsc);
+  detail::put_varint(buf, r->tid);
+  r->render(r, enc, buf);
+}
+
+size_t logger::drain(fmt::memory_buffer &buf) {
+  std::lock_guard<std::mutex> lg(mtx);
+  calibrate();
+  size_t consumed = 0;
+  for (auto it = rings.begin(); it != rings.end();) {
+    ring &r = **it;
+    bool orphaned = r.orphaned.load(std::memory_order_acquire);
+    uint64_t tail = r.tail.load(relaxed);
+    uint64_t head = r.head.load(std::memory_order_acquire);
+    while (tail != head) {
+      size_t offset = tail % RING_BYTES;
+      if (RING_BYTES - offset < detail::header_bytes()) {
+        // too short for a header: implicit padding
+        consumed += RING_BYTES - offset;
+        tail += RING_BYTES - offset;
+        continue;
+      }
+      auto *rec = reinterpret_cast<detail::record *>(&r.data[offset]);
+      if (rec->render != nullptr)
+        write_record(rec, buf);
+      tail += rec->size;
+      consumed += rec->size;
+    }
+    r.tail.store(tail, std::memory_order_release);
+    if (orphaned)
+      it = rings.erase(it);
+    else
+      ++it;
+  }
+  uint64_t lost = dropped.load(relaxed);
+  if (lost > reported_dropped) {
+    if (enc == encoding::TEXT) {
+      put_dropped(buf, lost - reported_dropped);
+    } else {
+      begin_binary(buf);
+      buf.push_back(char(ENTRY_DROPPED));
+      detail::put_varint(buf, lost - reported_dropped);
+    }
+    reported_dropped = lost;
+  }
+  if (buf.size() > 0) {
+    fwrite(buf.data(), 1, buf.size(), out);
+    fflush(out);
+    buf.clear();
+  }
+  return consumed;
+}
+
+level logger::level_for(const std::string &file) const {
+  for (auto &p : patterns) {
+    if (file.compare(0, p.first.size(), p.first) == 0)
+      return p.second;
+  }
+  return fallback;
+}
+
+const char *level_name(level l) {
+  switch (l) {
+  case level::SILENT:
+    return "SILENT";
+  case level::ERROR:
+    return "ERROR";
+  case level::WARNING:
+    return "WARNING";
+  case level::NOTICE:
+    return "NOTICE";
+  case level::VERBOSE:
+    return "VERBOSE";
+  }
+  return "UNKNOWN";
+}
+
+level level_from_string(const std::string &name) {
+  for (level l : {level::SILENT, level::ERROR, level::WARNING, level::NOTICE,
+                  level::VERBOSE}) {
+    if (name == level_name(l))
+      return l;
+  }
+  throw std::invalid_argument("unknown log level: " + name);
+}
+
+module_level &module(const char *file) {
+  logger &l = instance();
+  std::string name = relative(file);
+  std::lock_guard<std::mutex> lg(l.mtx);
+  auto &m = l.modules[name];
+  if (!m)
+    m.reset(new module_level(uint8_t(l.level_for(name))));
+  return *m;
+}
+
+void set_policy(const std::string &policy) {
+  std::vector<std::pair<std::string, level>> patterns;
+  level fallback = level::NOTICE;
+  size_t begin = 0;
+  while (begin <= policy.size()) {
+    size_t end = policy.find(',', begin);
+    if (end == std::string::npos)
+      end = policy.size();
+    std::string item = trim(policy.substr(begin, end - begin));
+    begin = end + 1;
+    if (item.empty())
+      continue;
+    size_t at = item.rfind('@');
+    if (at == std::string::npos)
+      fallback = level_from_string(item);
+    else
+      patterns.emplace_back(trim(item.substr(0, at)),
+                            level_from_string(trim(item.substr(at + 1))));
+  }
+
+  logger &l = instance();
+  std::lock_guard<std::mutex> lg(l.mtx);
+  l.patterns = std::move(patterns);
+  l.fallback = fallback;
+  for (auto &m : l.modules)
+    m.second->store(uint8_t(l.level_for(m.first)), relaxed);
+}
+
+std::string policy() {
+  logger &l = instance();
+  std::lock_guard<std::mutex> lg(l.mtx);
+  std::string s;
+  for (auto &p : l.patterns)
+    s += p.first + "@" + level_name(p.second) + ",";
+  return s + level_name(l.fallback);
+}
+
+void set_filename(const std::string &filename) {
+  FILE *next = stderr;
+  if (!filename.empty()) {
+    next = fopen(filename.c_str(), "a");
+    if (next == nullptr)
+      throw std::runtime_error("could not open log file " + filename + ": " +
+                               strerror(errno));
+  }
+  flush();
+  logger &l = instance();
+  std::lock_guard<std::mutex> lg(l.mtx);
+  if (l.out != stderr)
+    fclose(l.out);
+  l.out = next;
+  l.path = filename;
+  l.section_started = false;
+}
+
+std::string filename() {
+  logger &l = instance();
+  std::lock_guard<std::mutex> lg(l.mtx);
+  return l.path;
+}
+
+void reopen() { set_filename(filename()); }
+
+void flush() {
+  logger &l = instance();
+  std::unique_lock<std::mutex> ul(l.flush_mtx);
+  uint64_t ticket = ++l.requested;
+  l.wake.notify_one();
+  // the writer only completes a ticket after a pass that found the rings
+  // empty, so everything logged before this call has been written
+  l.drained.wait(ul, [&] { return l.completed >= ticket; });
+}
+
+uint64_t num_dropped() { return instance().dropped.load(relaxed); }
+
+void set_encoding(encoding e) {
+  flush();
+  logger &l = instance();
+  std::lock_guard<std::mutex> lg(l.mtx);
+  if (l.enc != e)
+    l.section_started = false;
+  l.enc = e;
+}
+
+encoding current_encoding() {
+  logger &l = instance();
+  std::lock_guard<std::mutex> lg(l.mtx);
+  return l.enc;
+}
+
+namespace {
+
+/// Reads binary log entries; any failure is sticky.
+class binary_input {
+public:
+  explicit binary_input(std::istream &in) : in(in), ok(true) {}
+
+  uint8_t byte() {
+    char c = 0;
+    if (ok && !in.get(c))
+      ok = false;
+    return uint8_t(c);
+  }
+
+  uint64_t varint() {
+    uint64_t v = 0;
+    for (unsigned shift = 0; ok && shift < 64; shift += 7) {
+      uint8_t b = byte();
+      v |= uint64_t(b & 0x7f) << shift;
+      if ((b & 0x80) == 0)
+        return v;
+    }
+    ok = false;
+    return 0;
+  }
+
+  template <typename T> T fixed() {
+    T v{};
+    if (ok && !in.read(reinterpret_cast<char *>(&v), sizeof(v)))
+      ok = false;
+    return v;
+  }
+
+  std::string string() {
+    uint64_t n = varint();
+    std::string s;
+    if (!ok || n > (uint64_t(1) << 30)) {
+      ok = false;
+      return s;
+    }
+    s.resize(n);
+    if (n > 0 && !in.read(&s[0], std::streamsize(n)))
+      ok = false;
+    return s;
+  }
+
+  std::istream &in;
+  bool ok;
+};
+
+struct decoded_site {
+  level lvl;
+  uint32_t line;
+  std::string file;
+  std::string function;
+  std::string format;
+};
+
+} // namespace
+
+std::string decode(std::istream &in, std::ostream &out) {
+  binary_input input(in);
+  std::map<uint64_t, decoded_site> sites;
+  tsc_clock clock{0, 0, 1.0};
+  bool started = false;
+  fmt::memory_buffer buf;
+  uint64_t entries = 0;
+  for (;;) {
+    char type;
+    if (!in.get(type))
+      break;
+    if (!started && type != char(ENTRY_MAGIC))
+      return "not a binary log: missing header";
+    switch (uint8_t(type)) {
+    case ENTRY_MAGIC: {
+      std::string magic(strlen(MAGIC), '\0');
+      if (!in.read(&magic[0], std::streamsize(magic.size())) ||
+          magic != MAGIC)
+        return "not a binary log: bad header";
+      uint8_t version = input.byte();
+      if (version != BINARY_VERSION)
+        return fmt::format("unsupported binary log version {}", version);
+      sites.clear();
+      started = true;
+      break;
+    }
+    case ENTRY_SITE: {
+      uint64_t id = input.varint();
+      decoded_site &s = sites[id];
+      s.lvl = level(input.byte());
+      s.line = uint32_t(input.varint());
+      s.file = input.string();
+      s.function = input.string();
+      s.format = input.string();
+      break;
+    }
+    case ENTRY_CLOCK:
+      clock.tsc = input.fixed<uint64_t>();
+      clock.nanos = input.fixed<int64_t>();
+      clock.ticks_per_nano = input.fixed<double>();
+      break;
+    case ENTRY_RECORD: {
+      uint64_t id = input.varint();
+      uint64_t tsc = input.fixed<uint64_t>();
+      uint64_t tid = input.varint();
+      uint64_t argc = input.varint();
+      auto it = sites.find(id);
+      if (input.ok && it == sites.end())
+        return fmt::format("entry {}: record for unknown site {}", entries, id);
+      fmt::dynamic_format_arg_store<fmt::format_context> args;
+      for (uint64_t i = 0; input.ok && i < argc; ++i) {
+        switch (input.byte()) {
+        case detail::ARG_INT: {
+          uint64_t z = input.varint();
+          args.push_back(int64_t(z >> 1) ^ -int64_t(z & 1));
+          break;
+        }
+        case detail::ARG_UINT:
+          args.push_back(input.varint());
+          break;
+        case detail::ARG_DOUBLE:
+          args.push_back(input.fixed<double>());
+          break;
+        case detail::ARG_BOOL:
+          args.push_back(input.byte() != 0);
+          break;
+        case detail::ARG_CHAR:
+          args.push_back(char(input.byte()));
+          break;
+        case detail::ARG_STRING:
+          args.push_back(input.string());
+          break;
+        default:
+          input.ok = false;
+        }
+      }
+      if (!input.ok)
+        break;
+      const decoded_site &s = it->second;
+      put_prefix(buf, clock.to_nanos(tsc), s.file.c_str(), s.line,
+                 s.function.c_str(), s.lvl, tid);
+      try {
+        fmt::vformat_to(std::back_inserter(buf), s.format, args);
+      } catch (const std::exception &e) {
+        buf.append(std::string("<bad log format: ") + e.what() + ">");
+      }
+      buf.push_back('\n');
+      break;
+    }
+    case ENTRY_DROPPED:
+      put_dropped(buf, input.varint());
+      break;
+    default:
+      return fmt::format("entry {}: unknown type {}", entries, int(type));
+    }
+    if (!input.ok)
+      return fmt::format("entry {}: truncated or corrupt", entries);
+    out.write(buf.data(), std::streamsize(buf.size()));
+    buf.clear();
+    ++entries;
+  }
+  return "";
+}
+
+namespace detail {
+
+site::site(level lvl, const char *file, uint32_t line, const char *function,
+           const char *format)
+    : lvl(lvl), file(file), line(line), function(function), format(format),
+      enabled(module(file)), id([this] {
+        logger &l = instance();
+        std::lock_guard<std::mutex> lg(l.mtx);
+        l.sites.push_back(this);
+        return uint32_t(l.sites.size() - 1);
+      }()) {}
+
+record *reserve(size_t size) {
+  size = (size + ALIGN - 1) & ~(ALIGN - 1);
+  if (_local.r == nullptr) {
+    logger &l = instance();
+    std::lock_guard<std::mutex> lg(l.mtx);
+    l.rings.emplace_back(new ring());
+    _local.r = l.rings.back().get();
+  }
+  ring &r = *_local.r;
+  uint64_t head = r.head.load(relaxed);
+  uint64_t tail = r.tail.load(std::memory_order_acquire);
+  size_t offset = head % RING_BYTES;
+  size_t padding = RING_BYTES - offset < size ? RING_BYTES - offset : 0;
+  if (size > RING_BYTES / 2 || head + padding + size - tail > RING_BYTES) {
+    instance().dropped.fetch_add(1, relaxed);
+    return nullptr;
+  }
+  if (padding > 0) {
+    if (padding >= header_bytes()) {
+      auto *pad = reinterpret_cast<record *>(&r.data[offset]);
+      pad->size = uint32_t(padding);
+      pad->render = nullptr;
+    }
+    r.head.store(head + padding, std::memory_order_release);
+    offset = 0;
+  }
+  auto *rec = reinterpret_cast<record *>(&r.data[offset]);
+  rec->size = uint32_t(size);
+  return rec;
+}
+
+void commit(record *rec) {
+  ring &r = *_local.r;
+  r.head.store(r.head.load(relaxed) + rec->size, std::memory_order_release);
+}
+
+void put_varint(fmt::memory_buffer &out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(char(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(char(v));
+}
+
+void put_string(fmt::memory_buffer &out, std::string_view s) {
+  put_varint(out, s.size());
+  out.append(s.data(), s.data() + s.size());
+}
+
+} // namespace detail
+} // namespace log
+} // namespace utils
+} // namespace ors
@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <thread>
+
+#include <utils/futex.h>
+#include <utils/mutex.h>
+
+namespace ors {
+namespace utils {
+
+namespace {
+const bool _single_cpu = std::thread::hardware_concurrency() <= 1;
+
+inline void cpu_relax() {
+#if defined(__i386) || defined(__x86_64__)
+  __builtin_ia32_pause();
+#endif
+}
+} // namespace
+
+void adaptive_mutex::lock_slow() {
+  if (!_single_cpu) {
+    // spin up to twice the recent average, then fold this attempt's count
+    // into the average
+    int16_t average = spins.load(std::memory_order_relaxed);
+    int16_t limit = std::min<int16_t>(MAX_SPINS, int16_t(average * 2 + 10));
+    for (int16_t n = 0; n < limit; ++n) {
+      uint32_t c = UNLOCKED;
+      if (state.load(std::memory_order_relaxed) == UNLOCKED &&
+          state.compare_exchange_weak(c, LOCKED, std::memory_order_acquire,
+                                      std::memory_order_relaxed)) {
+        spins.store(int16_t(average + (n - average) / 8),
+                    std::memory_order_relaxed);
+        return;
+      }
+      cpu_relax();
+    }
+    spins.store(int16_t(average + (limit - average) / 8),
+                std::memory_order_relaxed);
+  }
+  lock_contended();
+}
+
+void adaptive_mutex::lock_contended() {
+  // mark the lock contended so the holder's unlock wakes us; if it was free
+  // we now hold it (as CONTENDED, which at worst costs one extra wake)
+  while (state.exchange(CONTENDED, std::memory_order_acquire) != UNLOCKED)
+    futex::wait(&state, CONTENDED);
+}
+
+void adaptive_mutex::wake() { futex::wake(&state, 1); }
+
+} // namespace utils
+} // namespace ors
@@ -1,8 +1,8 @@
 #include <google/protobuf/text_format.h>
-#include <spdlog/spdlog.h>
 #include <sstream>
 #include <utils/protobuf.h>
 #include <utils/common.h>
+#include <utils/log.h>
 #include <utils/numeric.h>
 namespace ors {
 namespace utils {
@@ -65,9 +65,8 @@ bool parse(const ors::utils::buffer &from, Message &to, size_t skip_bytes) {
   google::protobuf::LogSilencer lser;
   if (!to.ParseFromArray(static_cast<const char *>(from.data()) + skip_bytes,
                          down_cast<int>(from.length() - skip_bytes))) {
-    spdlog::error("Missing fields in protocol buffer of type %s: %s",
-                  to.GetTypeName().c_str(),
-                  to.InitializationErrorString().c_str());
+    ORS_ERROR("Missing fields in protocol buffer of type {}: {}",
+              to.GetTypeName(), to.InitializationErrorString());
     return false;
   }
   return true;
@@ -77,10 +76,9 @@ void serialize(const Message &from, ors::utils::buffer &to, size_t skip_bytes) {
   // SerializeToArray seems to always return true, so we explicitly check
   // IsInitialized to make sure all required fields are set.
   if (!from.IsInitialized()) {
-    spdlog::error("Missing fields in protocol buffer of type %s: %s (have %s)",
-                  from.GetTypeName().c_str(),
-                  from.InitializationErrorString().c_str(),
-                  dump_string(from).c_str());
+    ORS_ERROR("Missing fields in protocol buffer of type {}: {} (have {})",
+              from.GetTypeName(), from.InitializationErrorString(),
+              dump_string(from));
   }
   size_t length = size_t(from.ByteSize());
   char *data = new char[skip_bytes + length];
@@ -1,7 +1,6 @@
-#include <cmath>
+#include <atomic>
 #include <cstring>
 #include <fcntl.h>
-#include <limits>
 #include <mutex>
 #include <pthread.h>
 #include <sys/stat.h>
@@ -11,48 +10,25 @@
 namespace ors {
 namespace utils {
 namespace rand {
-static prng _prng;
+namespace {
+/// Held across fork() so no thread is half way through seeding.
+std::mutex _mtx;
 
-void acquire_mutex() { _prng.mutex().lock(); }
+/// Bumped in the child after fork(); threads reseed when theirs is stale.
+std::atomic<uint64_t> _generation(1);
 
-/**
- * Called in the parent post fork(). This function is outside of the
- * anonymous namespace so it can be called from RandomTest.
- */
-void release_mutex() { _prng.mutex().unlock(); }
-void reset_random_state() {
-  // we will have grabbed the mutex in pthread_atfork prepare, need
-  // to release here
-  release_mutex();
-  _prng.reset_seed();
-}
-
-prng::prng() : mtx(), distribution(0, std::numeric_limits<uint64_t>::max()) {
-  reset_seed();
-  int err = pthread_atfork(acquire_mutex, release_mutex, reset_random_state);
-  if (err != 0) {
-    // too early to call ERROR in here
-    fprintf(stderr,
-            "Failed to set up pthread_atfork() handler to "
-            "reset prng seed in child processes. "
-            "As a result, child processes will generate the same "
-            "sequence of random values as the parent they were forked "
-            "from. Error: %s\n",
-            strerror(err));
-  }
-}
-
-prng::~prng() {}
+__thread uint64_t _seeded_generation = 0;
+__thread xoshiro256 *_generator = nullptr;
 
-void prng::reset_seed() {
-  std::lock_guard<std::mutex> lockGuard(mtx);
+uint64_t urandom_seed() {
+  std::lock_guard<std::mutex> lockGuard(_mtx);
   int fd = open("/dev/urandom", O_RDONLY);
   if (fd < 0) {
     // too early to call PANIC in here
     fprintf(stderr, "Open /dev/urandom failed: %s\n", strerror(errno));
     abort();
   }
-  uint_fast64_t seed;
+  uint64_t seed;
   ssize_t bytesRead = read(fd, &seed, sizeof(seed));
   close(fd);
   if (bytesRead != sizeof(seed)) {
@@ -60,36 +36,60 @@ void prng::reset_seed() {
     fprintf(stderr, "Read seed error from /dev/urandom\n");
     abort();
   }
-  mt64.seed(seed);
-  static_assert(RAND_MAX >= (1L << 30), "RAND_MAX too small");
-  // init = true;
+  return seed;
 }
 
-uint64_t prng::random64() {
-  auto r = distribution(mt64);
-  return r;
+xoshiro256 &reseed() {
+  // __thread needs a trivial type, so the state itself is a lazily built
+  // thread_local; the hot path only touches the two __thread words
+  thread_local xoshiro256 state;
+  state.seed(urandom_seed());
+  _generator = &state;
+  _seeded_generation = _generation.load(std::memory_order_relaxed);
+  return state;
 }
 
-std::mutex &prng::mutex() { return mtx; }
-
-template <typename T> T random() { return T(_prng.random64()); }
-
-uint8_t random8() { return random<uint8_t>(); }
-
-uint16_t random16() { return random<uint16_t>(); }
+struct fork_handlers {
+  fork_handlers() {
+    int err = pthread_atfork(acquire_mutex, release_mutex, reset_random_state);
+    if (err != 0) {
+      // too early to call ERROR in here
+      fprintf(stderr,
+              "Failed to set up pthread_atfork() handler to "
+              "reset prng seed in child processes. "
+              "As a result, child processes will generate the same "
+              "sequence of random values as the parent they were forked "
+              "from. Error: %s\n",
+              strerror(err));
+    }
+  }
+};
+fork_handlers _fork_handlers;
+} // namespace
 
-uint32_t random32() { return random<uint32_t>(); }
+void acquire_mutex() { _mtx.lock(); }
 
-uint64_t random64() { return _prng.random64(); }
+/**
+ * Called in the parent post fork(). This function is outside of the
+ * anonymous namespace so it can be called from RandomTest.
+ */
+void release_mutex() { _mtx.unlock(); }
 
-double random_decimal() {
-  return double(random64()) / double(std::numeric_limits<uint_fast64_t>::max());
+void reset_random_state() {
+  // we will have grabbed the mutex in pthread_atfork prepare, need
+  // to release here
+  release_mutex();
+  _generation.fetch_add(1, std::memory_order_relaxed);
 }
 
-uint64_t random_range(uint64_t begin, uint64_t end) {
-  return begin + random_decimal() * (end - begin);
+xoshiro256 &generator() {
+  if (__builtin_expect(_seeded_generation !=
+                           _generation.load(std::memory_order_relaxed),
+                       0))
+    return reseed();
+  return *_generator;
 }
 
 } // namespace rand
 } // namespace utils
-} // namespace ors
\ No newline at end of file
+} // namespace ors
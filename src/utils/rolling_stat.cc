@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <utils/rolling_stat.h>
+
+namespace ors {
+namespace utils {
+
+namespace {
+std::atomic<uint64_t> _next_generation(1);
+
+std::mutex _ids_mtx;
+/// Guarded by _ids_mtx.
+uint64_t _next_id = 0;
+/// Ids of destroyed instances. Guarded by _ids_mtx.
+std::vector<uint64_t> _free_ids;
+
+uint64_t allocate_id() {
+  std::lock_guard<std::mutex> lg(_ids_mtx);
+  if (_free_ids.empty())
+    return _next_id++;
+  uint64_t id = _free_ids.back();
+  _free_ids.pop_back();
+  return id;
+}
+
+struct cached_shard {
+  uint64_t generation;
+  void *shard;
+};
+
+/// Per-thread cache from rolling_stat id to that thread's shard.
+thread_local std::vector<cached_shard> _shards;
+
+constexpr auto relaxed = std::memory_order_relaxed;
+} // namespace
+
+rolling_stat::shard::shard()
+    : count(0), sum(0), sum_squares(0), min(std::numeric_limits<uint64_t>::max()),
+      max(0), last(0), last_tsc(0), ewma2(0), ewma4(0) {}
+
+rolling_stat::rolling_stat()
+    : id(allocate_id()), generation(_next_generation++), mtx(), shards(),
+      last_exceptional(), exceptional_count(0) {}
+
+rolling_stat::~rolling_stat() {
+  std::lock_guard<std::mutex> lg(_ids_mtx);
+  _free_ids.push_back(id);
+}
+
+void rolling_stat::push(uint64_t value) {
+  shard &s = local();
+  uint64_t n = s.count.load(relaxed);
+  double v = double(value);
+  if (n == 0) {
+    s.ewma2.store(v, relaxed);
+    s.ewma4.store(v, relaxed);
+  } else {
+    s.ewma2.store(0.5 * s.ewma2.load(relaxed) + 0.5 * v, relaxed);
+    s.ewma4.store(0.75 * s.ewma4.load(relaxed) + 0.25 * v, relaxed);
+  }
+  s.sum.store(s.sum.load(relaxed) + value, relaxed);
+  s.sum_squares.store(s.sum_squares.load(relaxed) + v * v, relaxed);
+  if (value < s.min.load(relaxed))
+    s.min.store(value, relaxed);
+  if (value > s.max.load(relaxed))
+    s.max.store(value, relaxed);
+  s.last.store(value, relaxed);
+  s.last_tsc.store(time::rdtsc(), relaxed);
+  // published last so a reader that sees the count sees most of the rest
+  s.count.store(n + 1, std::memory_order_release);
+}
+
+void rolling_stat::note_exceptional(time::system_clock::time_point when,
+                                    uint64_t value) {
+  push(value);
+  std::lock_guard<std::mutex> lg(mtx);
+  ++exceptional_count;
+  last_exceptional.push_back(
+      {std::chrono::nanoseconds(when.time_since_epoch()).count(), value});
+  if (last_exceptional.size() > MAX_EXCEPTIONAL)
+    last_exceptional.pop_front();
+}
+
+void rolling_stat::update_proto(proto::RollingStat &out) const {
+  uint64_t count = 0;
+  uint64_t sum = 0;
+  double sum_squares = 0;
+  uint64_t min = std::numeric_limits<uint64_t>::max();
+  uint64_t max = 0;
+  uint64_t last = 0;
+  uint64_t last_tsc = 0;
+  double ewma2 = 0;
+  double ewma4 = 0;
+
+  std::lock_guard<std::mutex> lg(mtx);
+  for (auto &s : shards) {
+    uint64_t n = s->count.load(std::memory_order_acquire);
+    if (n == 0)
+      continue;
+    count += n;
+    sum += s->sum.load(relaxed);
+    sum_squares += s->sum_squares.load(relaxed);
+    min = std::min(min, s->min.load(relaxed));
+    max = std::max(max, s->max.load(relaxed));
+    uint64_t tsc = s->last_tsc.load(relaxed);
+    if (tsc >= last_tsc) {
+      last_tsc = tsc;
+      last = s->last.load(relaxed);
+    }
+    ewma2 += s->ewma2.load(relaxed) * double(n);
+    ewma4 += s->ewma4.load(relaxed) * double(n);
+  }
+
+  out.set_count(count);
+  out.set_sum(sum);
+  out.set_exceptional_count(exceptional_count);
+  out.clear_last_exceptional();
+  for (auto &e : last_exceptional) {
+    proto::RollingStat::Exceptional &ex = *out.add_last_exceptional();
+    ex.set_when(e.when);
+    ex.set_value(e.value);
+  }
+  if (count == 0)
+    return;
+  double average = double(sum) / double(count);
+  double variance = sum_squares / double(count) - average * average;
+  out.set_average(average);
+  out.set_min(min);
+  out.set_max(max);
+  out.set_last(last);
+  out.set_stddev(variance > 0 ? std::sqrt(variance) : 0);
+  out.set_ewma2(ewma2 / double(count));
+  out.set_ewma4(ewma4 / double(count));
+}
+
+uint64_t rolling_stat::count() const {
+  uint64_t count = 0;
+  std::lock_guard<std::mutex> lg(mtx);
+  for (auto &s : shards)
+    count += s->count.load(relaxed);
+  return count;
+}
+
+rolling_stat::shard &rolling_stat::local() {
+  if (id < _shards.size() && _shards[id].generation == generation)
+    return *static_cast<shard *>(_shards[id].shard);
+  return register_thread();
+}
+
+rolling_stat::shard &rolling_stat::register_thread() {
+  std::lock_guard<std::mutex> lg(mtx);
+  shards.emplace_back(new shard());
+  if (id >= _shards.size())
+    _shards.resize(id + 1, {0, nullptr});
+  _shards[id] = {generation, shards.back().get()};
+  return *shards.back();
+}
+
+} // namespace utils
+} // namespace ors
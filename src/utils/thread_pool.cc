@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+
+#include <utils/log.h>
+#include <utils/thread_pool.h>
+#include <utils/tid.h>
+
+namespace ors {
+namespace utils {
+
+namespace {
+/// The pool and index of the calling worker thread, if any.
+thread_local const thread_pool *_pool = nullptr;
+thread_local size_t _index = 0;
+
+uint64_t xorshift(uint64_t &state) {
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+} // namespace
+
+thread_pool::thread_pool(size_t threads, const std::string &name, bool pin)
+    : name(name), workers(), mtx("thread_pool"), work_available(), idle(),
+      injected(), num_injected(0), sleepers(0), outstanding(0), steals(0),
+      exiting(false) {
+  if (threads == 0)
+    threads = std::max(1U, std::thread::hardware_concurrency());
+  for (size_t i = 0; i < threads; ++i)
+    workers.emplace_back(new worker());
+  // start only once every deque exists, since workers steal from each other
+  for (size_t i = 0; i < threads; ++i)
+    workers[i]->thread = std::thread(&thread_pool::main, this, i, pin);
+}
+
+thread_pool::~thread_pool() {
+  {
+    std::lock_guard<utils::mutex> lg(mtx);
+    exiting = true;
+  }
+  work_available.notify_all();
+  for (auto &w : workers)
+    w->thread.join();
+}
+
+void thread_pool::submit(std::function<void()> fn) {
+  task *t = new task(std::move(fn));
+  outstanding.fetch_add(1, std::memory_order_relaxed);
+  if (_pool == this) {
+    workers[_index]->deque.push(t);
+  } else {
+    std::lock_guard<utils::mutex> lg(mtx);
+    injected.push_back(t);
+    num_injected.store(injected.size(), std::memory_order_relaxed);
+  }
+  // pairs with the fence in main(): either a parking worker sees the task
+  // on its final scan, or we see it among the sleepers
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleepers.load(std::memory_order_relaxed) > 0)
+    wake_one();
+}
+
+void thread_pool::wait_idle() {
+  std::unique_lock<utils::mutex> ul(mtx);
+  while (outstanding.load(std::memory_order_acquire) != 0)
+    idle.wait(ul);
+}
+
+int thread_pool::current_worker() const {
+  return _pool == this ? int(_index) : -1;
+}
+
+void thread_pool::main(size_t index, bool pin) {
+  tid::set_name(name + "-" + std::to_string(index));
+  if (pin) {
+    unsigned cpus = std::max(1U, std::thread::hardware_concurrency());
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(index % cpus, &set);
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (ret != 0)
+      ORS_WARNING("could not pin {}-{} to CPU {}: {}", name, index,
+                  index % cpus, strerror(ret));
+  }
+  _pool = this;
+  _index = index;
+  uint64_t rng = 0x9e3779b97f4a7c15ULL * (index + 1);
+
+  for (;;) {
+    task *t = find_task(index, rng, false);
+    if (t != nullptr) {
+      run(t);
+      continue;
+    }
+    std::unique_lock<utils::mutex> ul(mtx);
+    sleepers.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // final scan: a submit() that missed us in sleepers is visible now,
+    // and one that saw us must take mtx to notify, so cannot get ahead of
+    // the wait below
+    t = find_task(index, rng, true);
+    bool done = t == nullptr && exiting && outstanding.load() == 0;
+    if (t == nullptr && !done)
+      work_available.wait(ul);
+    sleepers.fetch_sub(1, std::memory_order_relaxed);
+    if (done)
+      break;
+    ul.unlock();
+    if (t != nullptr)
+      run(t);
+  }
+  _pool = nullptr;
+}
+
+thread_pool::task *thread_pool::find_task(size_t index, uint64_t &rng,
+                                          bool locked) {
+  task *t = nullptr;
+  if (workers[index]->deque.pop(t))
+    return t;
+  if (num_injected.load(std::memory_order_relaxed) > 0) {
+    std::unique_lock<utils::mutex> ul(mtx, std::defer_lock);
+    if (!locked)
+      ul.lock();
+    if (!injected.empty()) {
+      t = injected.front();
+      injected.pop_front();
+      num_injected.store(injected.size(), std::memory_order_relaxed);
+      return t;
+    }
+  }
+  size_t n = workers.size();
+  size_t start = size_t(xorshift(rng) % n);
+  for (size_t i = 0; i < n; ++i) {
+    size_t victim = (start + i) % n;
+    if (victim != index && workers[victim]->deque.steal(t)) {
+      steals.fetch_add(1, std::memory_order_relaxed);
+      return t;
+    }
+  }
+  return nullptr;
+}
+
+void thread_pool::run(task *t) {
+  try {
+    (*t)();
+  } catch (const std::exception &e) {
+    ORS_ERROR("task on {} threw: {}", name, e.what());
+  } catch (...) {
+    ORS_ERROR("task on {} threw a non-exception", name);
+  }
+  delete t;
+  if (outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    std::lock_guard<utils::mutex> lg(mtx);
+    idle.notify_all();
+    // exiting workers wait for the last task
+    if (exiting)
+      work_available.notify_all();
+  }
+}
+
+void thread_pool::wake_one() {
+  std::lock_guard<utils::mutex> lg(mtx);
+  work_available.notify_one();
+}
+
+} // namespace utils
+} // namespace ors
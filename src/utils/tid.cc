@@ -1,64 +1,173 @@
+#include <algorithm>
 #include <atomic>
-#include <map>
+#include <cstdio>
+#include <cstring>
 #include <mutex>
-#include <unordered_set>
+#include <pthread.h>
 #include <utils/common.h>
 #include <utils/tid.h>
 
-// static std::atomic<uint64_t> _nextid = 1;
-// static std::mutex _mtx;
-
-// static std::map<uint64_t, std::string> _tid_name_map;
-// static std::unordered_set<std::string> _tid_name_set;
 namespace ors {
 namespace utils {
 namespace tid {
 __thread uint64_t _tid = 0;
+__thread char _name[MAX_NAME + 1];
 
-// static uint64_t nextid;
 std::atomic<uint64_t> _nextid = 1;
-std::mutex _mtx;
 
-std::map<uint64_t, std::string> _tid_name_map;
-std::unordered_set<std::string> _tid_name_set;
+namespace {
+constexpr size_t NAME_WORDS = (MAX_NAME + 1) / sizeof(uint64_t);
+
+/**
+ * A registered thread. Slots are never freed: an exiting thread sets tid to
+ * 0 and the next thread to register reuses the slot, so readers can walk
+ * the list without any reclamation scheme.
+ */
+struct slot {
+  slot() : tid(0), seq(0), words(), next(nullptr) {}
+
+  /// 0 while the slot is free.
+  std::atomic<uint64_t> tid;
+  /// Seqlock over words: odd while the owner is writing them.
+  std::atomic<uint32_t> seq;
+  /// The name, NUL-padded, copied in words so readers never race on bytes.
+  std::atomic<uint64_t> words[NAME_WORDS];
+  /// Set before the slot is published and never changed.
+  slot *next;
+
+  /// Owner only.
+  void publish(const char *name) {
+    uint64_t w[NAME_WORDS] = {};
+    memcpy(w, name, strnlen(name, MAX_NAME));
+    uint32_t s = seq.load(std::memory_order_relaxed);
+    seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < NAME_WORDS; ++i)
+      words[i].store(w[i], std::memory_order_relaxed);
+    seq.store(s + 2, std::memory_order_release);
+  }
+
+  std::string read() const {
+    uint64_t w[NAME_WORDS];
+    for (;;) {
+      uint32_t s = seq.load(std::memory_order_acquire);
+      if (s & 1)
+        continue;
+      for (size_t i = 0; i < NAME_WORDS; ++i)
+        w[i] = words[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq.load(std::memory_order_relaxed) == s)
+        break;
+    }
+    const char *p = reinterpret_cast<const char *>(w);
+    return std::string(p, strnlen(p, MAX_NAME));
+  }
+};
+
+std::atomic<slot *> _head(nullptr);
+__thread slot *_slot = nullptr;
+
+/**
+ * Serializes set_name() so that checking a name is free and publishing it
+ * happen as one step. tid() and name() never take it.
+ */
+std::mutex _names_mtx;
+
+/// Frees the calling thread's slot when the thread exits.
+struct releaser {
+  ~releaser() {
+    if (_slot != nullptr)
+      _slot->tid.store(0, std::memory_order_release);
+  }
+};
+thread_local releaser _releaser;
 
-uint64_t tid() {
-  if (_tid == 0) {
-    std::lock_guard<std::mutex> lg(_mtx);
-    _tid = _nextid;
-    ++_nextid;
+slot *claim(uint64_t id) {
+  for (slot *s = _head.load(std::memory_order_acquire); s; s = s->next) {
+    uint64_t free = 0;
+    if (s->tid.load(std::memory_order_relaxed) == 0 &&
+        s->tid.compare_exchange_strong(free, id, std::memory_order_acquire))
+      return s;
   }
+  slot *s = new slot();
+  s->tid.store(id, std::memory_order_relaxed);
+  s->next = _head.load(std::memory_order_relaxed);
+  while (!_head.compare_exchange_weak(s->next, s, std::memory_order_release,
+                                      std::memory_order_relaxed))
+    ;
+  return s;
+}
+
+void set_default_name() {
+  snprintf(_name, sizeof(_name), "Thread %" PRIu64, _tid);
+}
+
+/// Whether a live thread other than the caller is called name.
+bool in_use(const std::string &name) {
+  for (slot *s = _head.load(std::memory_order_acquire); s; s = s->next) {
+    if (s != _slot && s->tid.load(std::memory_order_acquire) != 0 &&
+        s->read() == name)
+      return true;
+  }
+  return false;
+}
+} // namespace
+
+uint64_t assign() {
+  if (_tid != 0)
+    return _tid;
+  _tid = _nextid.fetch_add(1, std::memory_order_relaxed);
+  if (_slot == nullptr) {
+    _slot = claim(_tid);
+    // constructs this thread's releaser, registering its destructor
+    (void)&_releaser;
+  } else {
+    _slot->tid.store(_tid, std::memory_order_release);
+  }
+  set_default_name();
+  _slot->publish(_name);
   return _tid;
 }
 
 void set_name(std::string name) {
-  auto curr_tid = tid();
-  std::lock_guard<std::mutex> lg(_mtx);
+  tid();
   auto trim_name = ors::utils::string::trim(name);
-  try {
-    if (trim_name.size() == 0 || _tid_name_set.count(trim_name)) {
-      throw thread_name_alredy_exist(trim_name);
-    } else {
-      _tid_name_map[curr_tid] = trim_name;
-      _tid_name_set.insert(trim_name);
+  if (trim_name.size() > MAX_NAME)
+    trim_name.resize(MAX_NAME);
+  {
+    std::lock_guard<std::mutex> lg(_names_mtx);
+    try {
+      if (trim_name.size() == 0 || in_use(trim_name)) {
+        throw thread_name_alredy_exist(trim_name);
+      } else {
+        memcpy(_name, trim_name.c_str(), trim_name.size() + 1);
+      }
+    } catch (thread_name_alredy_exist &e) {
+      set_default_name();
     }
-  } catch (thread_name_alredy_exist &e) {
-    // spdlog::warning()
-    _tid_name_map[curr_tid] =
-        std::move(string::fmt("Thread %ld", curr_tid));
+    _slot->publish(_name);
   }
-
-  //   else tid_name_map[curr_tid] = trim_name;
+  // the kernel keeps 15 bytes plus the terminator
+  char comm[16] = {};
+  memcpy(comm, _name, std::min(strlen(_name), sizeof(comm) - 1));
+  pthread_setname_np(pthread_self(), comm);
 }
 
-std::string name() {
-  auto curr_tid = tid();
-  std::lock_guard<std::mutex> lg(_mtx);
-  if (_tid_name_map.count(curr_tid))
-    return _tid_name_map[curr_tid];
-  else
-    return std::move(ors::utils::string::fmt("Thread %lu", curr_tid));
+std::string name() { return c_name(); }
+
+std::vector<thread_info> threads() {
+  std::vector<thread_info> res;
+  for (slot *s = _head.load(std::memory_order_acquire); s; s = s->next) {
+    uint64_t id = s->tid.load(std::memory_order_acquire);
+    if (id == 0)
+      continue;
+    std::string n = s->read();
+    // skip a slot freed and reclaimed while we read it
+    if (s->tid.load(std::memory_order_acquire) == id)
+      res.push_back({id, std::move(n)});
+  }
+  return res;
 }
 } // namespace tid
 } // namespace utils
-} // namespace ors
\ No newline at end of file
+} // namespace ors
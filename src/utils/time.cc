@@ -1,11 +1,19 @@
 #include <algorithm>
 #include <cassert>
+#include <climits>
 #include <cstdlib>
 #include <cstring>
 #include <functional>
+#include <mutex>
+#include <pthread.h>
 #include <stdexcept>
+#include <vector>
+#if defined(__i386) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
 
-#include <spdlog/spdlog.h>
+#include <utils/futex.h>
+#include <utils/log.h>
 #include <utils/time.h>
 
 namespace ors {
@@ -118,14 +126,28 @@ uint64_t parse_non_negative_duration(const std::string &description) {
 }
 
 void sleep(ors::utils::time::steady_clock::time_point wake) {
+  if (steady_clock::is_mock_value.load()) {
+    std::atomic<uint32_t> word(0);
+    detail::add_mock_sleeper(&word);
+    for (;;) {
+      uint32_t seen = word.load();
+      if (!steady_clock::is_mock_value.load() || steady_clock::now() >= wake)
+        break;
+      futex::wait(&word, seen);
+    }
+    detail::remove_mock_sleeper(&word);
+    if (steady_clock::is_mock_value.load())
+      return;
+    // unmocked while sleeping: the rest is in real time
+  }
   struct timespec spec = make_timespec(wake);
   if (spec.tv_sec < 0)
     return;
   int r = clock_nanosleep(STEADY_CLOCK_ID, TIMER_ABSTIME, &spec, nullptr);
   if (r != 0) {
-    SPDLOG_ERROR("clock_nanosleep(STEADY_CLOCK_ID=%d, %s) failed: %s",
-                 STEADY_CLOCK_ID,
-                 ors::utils::string::to_string(wake).c_str(), strerror(r));
+    ORS_ERROR("clock_nanosleep(STEADY_CLOCK_ID={}, {}) failed: {}",
+              STEADY_CLOCK_ID, ors::utils::string::to_string(wake),
+              strerror(r));
   }
 }
 
@@ -144,7 +166,7 @@ stdy_clock::time_point stdy_clock::now() {
   struct timespec now;
   int r = clock_gettime(STEADY_CLOCK_ID, &now);
   if (r != 0) {
-    SPDLOG_ERROR("clock_gettime(STEADY_CLOCK_ID) failed: %s", strerror(errno));
+    ORS_ERROR("clock_gettime(STEADY_CLOCK_ID) failed: {}", strerror(errno));
   }
   return time_point(std::chrono::nanoseconds(
       int64_t(now.tv_sec) * 1000 * 1000 * 1000 + now.tv_nsec));
@@ -154,12 +176,195 @@ sys_clock::time_point sys_clock::now() {
   struct timespec now;
   int r = clock_gettime(CLOCK_REALTIME, &now);
   if (r != 0) {
-    SPDLOG_ERROR("clock_gettime(CLOCK_REALTIME) failed: %s", strerror(errno));
+    ORS_ERROR("clock_gettime(CLOCK_REALTIME) failed: {}", strerror(errno));
   }
   return time_point(std::chrono::nanoseconds(
       int64_t(now.tv_sec) * 1000 * 1000 * 1000 + now.tv_nsec));
 }
 
+namespace detail {
+namespace {
+struct mock_sleepers {
+  std::mutex mtx;
+  std::vector<std::atomic<uint32_t> *> words;
+};
+
+/// Never destroyed: sleepers may outlive static destruction.
+mock_sleepers &sleepers() {
+  static mock_sleepers *s = new mock_sleepers();
+  return *s;
+}
+} // namespace
+
+void add_mock_sleeper(std::atomic<uint32_t> *word) {
+  mock_sleepers &s = sleepers();
+  std::lock_guard<std::mutex> lg(s.mtx);
+  s.words.push_back(word);
+}
+
+void remove_mock_sleeper(std::atomic<uint32_t> *word) {
+  mock_sleepers &s = sleepers();
+  std::lock_guard<std::mutex> lg(s.mtx);
+  auto it = std::find(s.words.begin(), s.words.end(), word);
+  if (it != s.words.end())
+    s.words.erase(it);
+}
+
+void wake_mock_sleepers() {
+  mock_sleepers &s = sleepers();
+  std::lock_guard<std::mutex> lg(s.mtx);
+  for (std::atomic<uint32_t> *word : s.words) {
+    word->fetch_add(1);
+    futex::wake(word, INT_MAX);
+  }
+}
+
+tsc_calibration _tsc;
+std::atomic<int64_t> _coarse_nanos(0);
+std::atomic<int> _coarse_source(int(coarse_clock::source::KERNEL));
+
+namespace {
+/// Longest interval between recalibrations.
+constexpr int64_t RECALIBRATE_MAX_NANOS = 1000 * 1000 * 1000;
+
+/// The first recalibration follows this soon after startup.
+constexpr int64_t RECALIBRATE_MIN_NANOS = 10 * 1000 * 1000;
+
+/// How long the startup measurement spins.
+constexpr int64_t STARTUP_NANOS = 200 * 1000;
+
+/// Held by the thread recalibrating; cleared in fork children.
+std::atomic_flag _recalibrating = ATOMIC_FLAG_INIT;
+
+/// Written only by the thread holding _recalibrating.
+uint64_t _first_tsc = 0;
+int64_t _first_nanos = 0;
+int64_t _interval = RECALIBRATE_MIN_NANOS;
+
+/**
+ * A simultaneous TSC and CLOCK_MONOTONIC reading: the tsc midway between
+ * two rdtsc() calls around clock_gettime(), from the tightest of a few
+ * tries.
+ */
+void sample(uint64_t &tsc, int64_t &nanos) {
+  uint64_t best = ~0UL;
+  for (int i = 0; i < 5; ++i) {
+    uint64_t before = rdtsc();
+    int64_t n = monotonic_nanos();
+    uint64_t after = rdtsc();
+    if (after - before < best) {
+      best = after - before;
+      tsc = before + (after - before) / 2;
+      nanos = n;
+    }
+  }
+}
+
+void publish(uint64_t anchor, int64_t nanos, double nanos_per_tick,
+             uint64_t due) {
+  uint32_t s = _tsc.seq.load(std::memory_order_relaxed);
+  _tsc.seq.store(s + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  _tsc.anchor_tsc.store(anchor, std::memory_order_relaxed);
+  _tsc.anchor_nanos.store(nanos, std::memory_order_relaxed);
+  _tsc.mult.store(uint64_t(nanos_per_tick * 4294967296.0),
+                  std::memory_order_relaxed);
+  _tsc.seq.store(s + 2, std::memory_order_release);
+  _tsc.due.store(due, std::memory_order_relaxed);
+}
+
+void calibrate() {
+  uint64_t tsc;
+  int64_t nanos;
+  sample(tsc, nanos);
+  if (_first_nanos == 0) {
+    pthread_atfork(nullptr, nullptr, [] { _recalibrating.clear(); });
+    _first_tsc = tsc;
+    _first_nanos = nanos;
+    while (monotonic_nanos() - _first_nanos < STARTUP_NANOS)
+      ;
+    sample(tsc, nanos);
+    double rate = double(tsc - _first_tsc) / double(nanos - _first_nanos);
+    publish(tsc, nanos, 1.0 / rate, tsc + uint64_t(double(_interval) * rate));
+    // tsc_recalibrate() callers waiting for the first calibration check this
+    _tsc.ticks_per_nano.store(rate, std::memory_order_release);
+    return;
+  }
+
+  double rate = double(tsc - _first_tsc) / double(nanos - _first_nanos);
+  _tsc.ticks_per_nano.store(rate, std::memory_order_relaxed);
+  // continue from where the old line is now, so readers never see time go
+  // backwards; if that is behind CLOCK_MONOTONIC, jump forward to it, and if
+  // ahead, run slow enough to be back on it by the next recalibration
+  uint64_t anchor = _tsc.anchor_tsc.load(std::memory_order_relaxed);
+  __int128 delta = int64_t(tsc - anchor);
+  int64_t estimate = _tsc.anchor_nanos.load(std::memory_order_relaxed) +
+                     int64_t((delta * _tsc.mult.load(std::memory_order_relaxed)) >> 32);
+  _interval = std::min(_interval * 2, RECALIBRATE_MAX_NANOS);
+  double nanos_per_tick = 1.0 / rate;
+  if (estimate <= nanos) {
+    estimate = nanos;
+  } else {
+    double slew = double(estimate - nanos) / double(_interval);
+    nanos_per_tick *= 1.0 - std::min(slew, 0.5);
+  }
+  publish(tsc, estimate, nanos_per_tick,
+          tsc + uint64_t(double(_interval) * rate));
+}
+
+std::once_flag _tsc_once;
+} // namespace
+
+void tsc_init() {
+  std::call_once(_tsc_once, [] {
+    // calibration itself happens on the first reading, as _tsc.due is 0
+    _tsc.use_tsc.store(tsc_clock::invariant(), std::memory_order_relaxed);
+    _tsc.ready.store(true, std::memory_order_release);
+  });
+}
+
+void tsc_recalibrate() {
+  if (_recalibrating.test_and_set(std::memory_order_acquire)) {
+    while (_tsc.ticks_per_nano.load(std::memory_order_acquire) == 0)
+      ;
+    return;
+  }
+  calibrate();
+  _recalibrating.clear(std::memory_order_release);
+}
+} // namespace detail
+
+bool tsc_clock::invariant() {
+#if defined(__i386) || defined(__x86_64__)
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+    return false;
+  return (edx & (1U << 8)) != 0;
+#else
+  // the powerpc timebase runs at a fixed frequency
+  return true;
+#endif
+}
+
+void tsc_clock::set_enabled(bool on) {
+  detail::tsc_init();
+  if (on && !invariant())
+    ORS_NOTICE("no invariant TSC: tsc_clock falls back to clock_gettime()");
+  detail::_tsc.use_tsc.store(on && invariant(), std::memory_order_relaxed);
+}
+
+coarse_clock::time_point coarse_clock::update() {
+  time_point now = steady_clock::now();
+  if (steady_clock::is_mock_value.load())
+    return now;
+  int64_t nanos = now.time_since_epoch().count();
+  int64_t cached = detail::_coarse_nanos.load(std::memory_order_relaxed);
+  while (cached < nanos &&
+         !detail::_coarse_nanos.compare_exchange_weak(
+             cached, nanos, std::memory_order_relaxed))
+    ;
+  return time_point(duration(std::max(cached, nanos)));
+}
 
 steady_converter::steady_converter()
     : stdy_tp(steady_clock::now())
@@ -1,13 +1,19 @@
-add_requires("spdlog","protobuf","pqxx","pq")
+add_requires("spdlog","protobuf","pqxx","pq","zlib")
 
 target("main")
     set_kind("binary")
     -- add_headerfiles("include/*.h")
     add_includedirs("../include")
     add_files("utils/*.cc")
+    add_files("state_machine/*.cc")
+    add_files("storage/*.cc")
+    add_files("tree/*.cc")
+    add_files("../proto/server_stats.proto", {rules = "protobuf.cpp", proto_rootdir = "../proto"})
+    add_files("../proto/client.proto", {rules = "protobuf.cpp", proto_rootdir = "../proto"})
+    add_files("../proto/raft.proto", {rules = "protobuf.cpp", proto_rootdir = "../proto"})
     add_files("*.cc")
     add_syslinks("pthread")
     
-    add_packages("spdlog","protobuf","pqxx","pq")
+    add_packages("spdlog","protobuf","pqxx","pq","zlib")
     -- add_links("spdlog")
     -- set_config("buildir", "build.xmake")
\ No newline at end of file
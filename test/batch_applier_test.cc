@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include <state_machine/batch_applier.h>
+
+namespace ors {
+namespace state_machine {
+
+class batch_applier_test : public ::testing::Test {
+public:
+  batch_applier_test()
+      : calls(0), applier(std::bind(&batch_applier_test::apply, this,
+                                    std::placeholders::_1,
+                                    std::placeholders::_2),
+                          3) {}
+
+  void apply(const std::vector<batch_applier::entry> &batch,
+             std::vector<std::string> &responses) {
+    ++calls;
+    for (auto &e : batch)
+      responses.push_back("ok " + e.data);
+  }
+
+  std::atomic<uint64_t> calls;
+  batch_applier applier;
+};
+
+TEST_F(batch_applier_test, apply_batch_empty) {
+  EXPECT_EQ(0U, applier.apply_batch());
+  EXPECT_EQ(0U, calls);
+  EXPECT_EQ(0U, applier.last_applied());
+}
+
+TEST_F(batch_applier_test, apply_batch) {
+  for (uint64_t i = 1; i <= 5; ++i)
+    applier.commit(i, std::to_string(i));
+  EXPECT_EQ(3U, applier.apply_batch());
+  EXPECT_EQ(1U, calls);
+  EXPECT_EQ(3U, applier.last_applied());
+  EXPECT_EQ(2U, applier.apply_batch());
+  EXPECT_EQ(2U, calls);
+  EXPECT_EQ(5U, applier.last_applied());
+
+  std::string response;
+  EXPECT_TRUE(applier.wait_response(4, response));
+  EXPECT_EQ("ok 4", response);
+  // responses are handed out once
+  EXPECT_FALSE(applier.wait_response(4, response));
+
+  proto::ServerStats::StateMachine stats;
+  applier.update_server_stats(stats);
+  EXPECT_EQ(5U, stats.last_applied());
+  EXPECT_EQ(2U, stats.num_apply_batches());
+  EXPECT_EQ(5U, stats.num_applied_entries());
+  EXPECT_EQ(3U, stats.max_apply_batch_size());
+  EXPECT_EQ(2U, stats.apply_batch_size().count());
+  EXPECT_EQ(2.5, stats.apply_batch_size().average());
+
+  proto::ServerStats::Latency latency;
+  applier.update_server_stats(latency);
+  EXPECT_EQ(2U, latency.apply_nanos().total().count());
+}
+
+TEST_F(batch_applier_test, set_max_batch_size) {
+  for (uint64_t i = 1; i <= 5; ++i)
+    applier.commit(i, std::to_string(i));
+  applier.set_max_batch_size(1);
+  EXPECT_EQ(1U, applier.apply_batch());
+  applier.set_max_batch_size(0); // no limit
+  EXPECT_EQ(4U, applier.apply_batch());
+  EXPECT_EQ(5U, applier.last_applied());
+}
+
+TEST_F(batch_applier_test, wait_response_timeout) {
+  std::string response;
+  EXPECT_FALSE(applier.wait_response(
+      1, response,
+      utils::time::steady_clock::now() + std::chrono::milliseconds(1)));
+}
+
+TEST_F(batch_applier_test, thread) {
+  applier.start();
+  std::vector<batch_applier::entry> entries;
+  for (uint64_t i = 1; i <= 100; ++i)
+    entries.push_back({i, std::to_string(i)});
+  applier.commit(std::move(entries));
+  std::string response;
+  EXPECT_TRUE(applier.wait_response(100, response));
+  EXPECT_EQ("ok 100", response);
+  EXPECT_TRUE(applier.wait_applied(100));
+  EXPECT_GE(34U, calls);
+  applier.exit();
+  EXPECT_FALSE(applier.wait_applied(101));
+}
+
+} // namespace state_machine
+} // namespace ors
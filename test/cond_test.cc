@@ -1,10 +1,12 @@
 #include <string>
 #include <thread>
+#include <vector>
 // #include <unordered_map>
 // #include <unordered_set>
 // #include <mutex>
 // #include <utils/tid.h>
 #include <gtest/gtest.h>
+#include <unistd.h>
 // #include <utils/mutex.h>
 #include <spdlog/spdlog.h>
 #include <utils/cond.h>
@@ -13,6 +15,8 @@
 typedef std::chrono::milliseconds ms;
 namespace ors {
 namespace utils {
+typedef basic_mutex<mutex_policy::test_hook> hooked_mutex;
+
 class cond_test : public ::testing::Test {
 public:
   cond_test()
@@ -29,7 +33,7 @@ public:
   }
 
   void wait() {
-    std::unique_lock<utils::mutex> lg(mutex);
+    std::unique_lock<hooked_mutex> lg(mutex);
     ++ready;
     while (!cond) {
       cv.wait(lg);
@@ -88,7 +92,7 @@ public:
     return end - start;
   }
 
-  utils::mutex mutex;
+  hooked_mutex mutex;
   std::mutex stdmutex;
   condition_variable cv;
   std::atomic<uint64_t> ready;
@@ -109,7 +113,7 @@ TEST_F(cond_test, notify_one_TimingSensitive) {
   spinForReady(2);
   EXPECT_EQ(0U, done);
   {
-    std::unique_lock<utils::mutex> lg(mutex);
+    std::unique_lock<hooked_mutex> lg(mutex);
     cond = true;
     cv.notify(condition_variable::ONE);
   }
@@ -118,7 +122,7 @@ TEST_F(cond_test, notify_one_TimingSensitive) {
   EXPECT_EQ(1U, counter2);
   EXPECT_EQ(1U, done);
   {
-    std::unique_lock<utils::mutex> lg(mutex);
+    std::unique_lock<hooked_mutex> lg(mutex);
     cond = true;
     cv.notify(condition_variable::ONE);
   }
@@ -137,7 +141,7 @@ TEST_F(cond_test, notify_all_TimingSensitive) {
   spinForReady(2);
   EXPECT_EQ(0U, done);
   {
-    std::unique_lock<utils::mutex> lg(mutex);
+    std::unique_lock<hooked_mutex> lg(mutex);
     cond = true;
     cv.notify(condition_variable::ALL);
   }
@@ -171,7 +175,7 @@ TEST_F(cond_test, wait_stdmutex_real_TimingSensitive) {
 TEST_F(cond_test, wait_mutex_callback) {
   cv.cb = std::bind(&cond_test::incrementCounter1, this);
   {
-    std::unique_lock<utils::mutex> lg(mutex);
+    std::unique_lock<hooked_mutex> lg(mutex);
     cv.wait(lg);
   }
   EXPECT_EQ(1U, counter1);
@@ -183,7 +187,7 @@ TEST_F(cond_test, wait_mutex_realtime_sensitive) {
   spinForReady(1);
   EXPECT_EQ(0U, done);
   {
-    std::unique_lock<utils::mutex> lg(mutex);
+    std::unique_lock<hooked_mutex> lg(mutex);
     cond = true;
     cv.notify_all();
   }
@@ -200,5 +204,111 @@ TEST_F(cond_test, wait_mutex_realtime_sensitive) {
             ms(1));
 }
 
+TEST(cond, notify_all_requeues_adaptive_waiters) {
+  typedef basic_mutex<mutex_policy::none, adaptive_mutex> amutex;
+  amutex m;
+  condition_variable cv;
+  bool go = false;
+  int ready = 0;
+  int woken = 0;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&] {
+      std::unique_lock<amutex> ul(m);
+      ++ready;
+      while (!go)
+        cv.wait(ul);
+      ++woken;
+    });
+  }
+  for (;;) {
+    std::unique_lock<amutex> ul(m);
+    if (ready == 8)
+      break;
+    ul.unlock();
+    usleep(100);
+  }
+  {
+    std::unique_lock<amutex> ul(m);
+    go = true;
+    cv.notify_all();
+  }
+  for (auto &t : threads)
+    t.join();
+  EXPECT_EQ(8, woken);
+}
+
+TEST(cond, wait_until_adaptive_times_out) {
+  typedef basic_mutex<mutex_policy::none, adaptive_mutex> amutex;
+  amutex m;
+  condition_variable cv;
+  std::unique_lock<amutex> ul(m);
+  auto start = time::steady_clock::now();
+  cv.wait_until(ul, start + ms(5));
+  EXPECT_TRUE(ul.owns_lock());
+  EXPECT_GE(time::steady_clock::now() - start, ms(4));
+  // the lock still works for others afterwards
+  ul.unlock();
+  std::thread t([&] { std::lock_guard<amutex> lg(m); });
+  t.join();
+}
+
+TEST(cond, notify_without_waiters) {
+  condition_variable cv;
+  for (int i = 0; i < 1000; ++i) {
+    cv.notify_one();
+    cv.notify_all();
+  }
+  EXPECT_EQ(2000U, cv.notify_count);
+}
+
+TEST(cond, wait_until_mocked_time) {
+  time::steady_clock::mocker mock(time::steady_clock::time_point() +
+                                  std::chrono::hours(1));
+  std::mutex m;
+  condition_variable cv;
+  std::atomic<bool> timed_out(false);
+  auto deadline = time::steady_clock::now() + std::chrono::minutes(10);
+  std::thread t([&] {
+    std::unique_lock<std::mutex> ul(m);
+    while (time::steady_clock::now() < deadline)
+      cv.wait_until(ul, deadline);
+    timed_out = true;
+  });
+  // real time passing does not time the wait out
+  usleep(20 * 1000);
+  EXPECT_FALSE(timed_out.load());
+  time::steady_clock::advance(std::chrono::minutes(5));
+  usleep(20 * 1000);
+  EXPECT_FALSE(timed_out.load());
+  time::steady_clock::advance(std::chrono::minutes(5));
+  t.join();
+  EXPECT_TRUE(timed_out.load());
+}
+
+TEST(cond, fast_forward_simulation) {
+  // ten minutes of 150ms election timeouts, in simulated time
+  time::steady_clock::mocker mock{time::steady_clock::time_point()};
+  hooked_mutex m;
+  condition_variable cv;
+  std::atomic<int> timeouts(0);
+  std::atomic<bool> stop(false);
+  std::thread follower([&] {
+    std::unique_lock<hooked_mutex> ul(m);
+    while (!stop) {
+      auto deadline = time::steady_clock::now() + ms(150);
+      while (!stop && time::steady_clock::now() < deadline)
+        cv.wait_until(ul, deadline);
+      ++timeouts;
+    }
+  });
+  while (timeouts < 4000)
+    time::steady_clock::advance(ms(10));
+  stop = true;
+  time::steady_clock::advance(ms(10));
+  follower.join();
+  EXPECT_LE(4000, timeouts.load());
+}
+
 } // namespace utils
 } // namespace ors
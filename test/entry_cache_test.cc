@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+#include <thread>
+
+#include <storage/entry_cache.h>
+
+namespace ors {
+namespace storage {
+
+namespace {
+entry_cache::entry_ptr make_entry(uint64_t term, size_t data_bytes) {
+  auto e = std::make_shared<proto::raft::Entry>();
+  e->set_term(term);
+  e->set_cluster_time(0);
+  e->set_type(proto::raft::DATA);
+  e->set_data(std::string(data_bytes, 'd'));
+  return e;
+}
+} // namespace
+
+TEST(entry_cache_test, empty) {
+  entry_cache cache(1 << 20);
+  EXPECT_TRUE(cache.empty());
+  EXPECT_EQ(0U, cache.bytes());
+  EXPECT_EQ(cache.first_index() - 1, cache.last_index());
+  EXPECT_EQ(nullptr, cache.get(1));
+  std::vector<entry_cache::entry_ptr> out;
+  EXPECT_EQ(0U, cache.get_range(1, 10, 1 << 20, out));
+  EXPECT_TRUE(out.empty());
+}
+
+TEST(entry_cache_test, append_get) {
+  entry_cache cache(1 << 20);
+  std::vector<entry_cache::entry_ptr> entries;
+  for (uint64_t i = 1; i <= 5; ++i) {
+    entries.push_back(make_entry(1, 100));
+    cache.append(i, entries.back());
+  }
+  EXPECT_EQ(1U, cache.first_index());
+  EXPECT_EQ(5U, cache.last_index());
+  EXPECT_EQ(5 * entries[0]->ByteSizeLong(), cache.bytes());
+  // the same object the append path holds, not a copy
+  EXPECT_EQ(entries[2].get(), cache.get(3).get());
+  EXPECT_EQ(nullptr, cache.get(0));
+  EXPECT_EQ(nullptr, cache.get(6));
+
+  proto::ServerStats::Storage stats;
+  cache.update_server_stats(stats);
+  EXPECT_EQ(1U, stats.num_entry_cache_hits());
+  EXPECT_EQ(2U, stats.num_entry_cache_misses());
+  EXPECT_EQ(5U, stats.entry_cache_entries());
+  EXPECT_EQ(cache.bytes(), stats.entry_cache_bytes());
+}
+
+TEST(entry_cache_test, get_range) {
+  entry_cache cache(1 << 20);
+  for (uint64_t i = 1; i <= 10; ++i)
+    cache.append(i, make_entry(1, 100));
+  uint64_t one = cache.get(1)->ByteSizeLong();
+
+  std::vector<entry_cache::entry_ptr> out;
+  EXPECT_EQ(3U, cache.get_range(4, 3, 1 << 20, out));
+  EXPECT_EQ(cache.get(4), out[0]);
+  EXPECT_EQ(cache.get(6), out[2]);
+
+  out.clear();
+  EXPECT_EQ(2U, cache.get_range(4, 100, 2 * one + one / 2, out));
+  out.clear();
+  EXPECT_EQ(3U, cache.get_range(8, 100, 1 << 20, out));
+  // one entry even if it alone is over max_bytes
+  out.clear();
+  EXPECT_EQ(1U, cache.get_range(8, 100, 1, out));
+  out.clear();
+  EXPECT_EQ(0U, cache.get_range(11, 100, 1 << 20, out));
+  EXPECT_TRUE(out.empty());
+}
+
+TEST(entry_cache_test, evicts_oldest) {
+  uint64_t one = make_entry(1, 1000)->ByteSizeLong();
+  entry_cache cache(4 * one);
+  for (uint64_t i = 1; i <= 10; ++i) {
+    cache.append(i, make_entry(1, 1000));
+    EXPECT_LE(cache.bytes(), 4 * one);
+  }
+  EXPECT_EQ(7U, cache.first_index());
+  EXPECT_EQ(10U, cache.last_index());
+  EXPECT_EQ(nullptr, cache.get(6));
+  EXPECT_NE(nullptr, cache.get(7));
+
+  proto::ServerStats::Storage stats;
+  cache.update_server_stats(stats);
+  EXPECT_EQ(6U, stats.num_entry_cache_evictions());
+  EXPECT_EQ(4U, stats.entry_cache_entries());
+
+  // an entry bigger than the whole budget is not kept, and the entries
+  // before it would no longer be contiguous with what follows
+  cache.append(11, make_entry(1, 5000));
+  EXPECT_TRUE(cache.empty());
+  EXPECT_EQ(nullptr, cache.get(11));
+  cache.append(12, make_entry(1, 1000));
+  EXPECT_EQ(12U, cache.first_index());
+  EXPECT_EQ(12U, cache.last_index());
+}
+
+TEST(entry_cache_test, overwrite_truncates) {
+  entry_cache cache(1 << 20);
+  for (uint64_t i = 1; i <= 5; ++i)
+    cache.append(i, make_entry(1, 10));
+  auto replacement = make_entry(2, 10);
+  cache.append(3, replacement);
+  EXPECT_EQ(3U, cache.last_index());
+  EXPECT_EQ(replacement, cache.get(3));
+  EXPECT_EQ(nullptr, cache.get(4));
+  EXPECT_EQ(3 * replacement->ByteSizeLong(), cache.bytes());
+}
+
+TEST(entry_cache_test, gap_starts_over) {
+  entry_cache cache(1 << 20);
+  for (uint64_t i = 1; i <= 3; ++i)
+    cache.append(i, make_entry(1, 10));
+  cache.append(10, make_entry(1, 10));
+  EXPECT_EQ(10U, cache.first_index());
+  EXPECT_EQ(10U, cache.last_index());
+  EXPECT_EQ(nullptr, cache.get(3));
+}
+
+TEST(entry_cache_test, truncate) {
+  entry_cache cache(1 << 20);
+  for (uint64_t i = 1; i <= 10; ++i)
+    cache.append(i, make_entry(1, 10));
+  cache.truncate_suffix(8);
+  EXPECT_EQ(7U, cache.last_index());
+  cache.truncate_prefix(4);
+  EXPECT_EQ(4U, cache.first_index());
+  EXPECT_EQ(4 * cache.get(4)->ByteSizeLong(), cache.bytes());
+  // appending continues after the truncation point
+  cache.append(8, make_entry(2, 10));
+  EXPECT_EQ(8U, cache.last_index());
+
+  cache.truncate_prefix(100);
+  EXPECT_TRUE(cache.empty());
+  EXPECT_EQ(0U, cache.bytes());
+  cache.append(100, make_entry(2, 10));
+  EXPECT_EQ(100U, cache.first_index());
+  cache.truncate_suffix(50);
+  EXPECT_TRUE(cache.empty());
+  EXPECT_EQ(49U, cache.last_index());
+}
+
+TEST(entry_cache_test, entries_outlive_eviction) {
+  uint64_t one = make_entry(1, 100)->ByteSizeLong();
+  entry_cache cache(one);
+  cache.append(1, make_entry(1, 100));
+  std::vector<entry_cache::entry_ptr> out;
+  ASSERT_EQ(1U, cache.get_range(1, 1, one, out));
+  cache.append(2, make_entry(1, 100));
+  EXPECT_EQ(nullptr, cache.get(1));
+  // a request being built keeps its entries alive
+  EXPECT_EQ(std::string(100, 'd'), out[0]->data());
+}
+
+TEST(entry_cache_test, concurrent) {
+  uint64_t one = make_entry(1, 64)->ByteSizeLong();
+  entry_cache cache(64 * one);
+  std::atomic<bool> done(false);
+  std::thread reader([&] {
+    std::vector<entry_cache::entry_ptr> out;
+    while (!done) {
+      out.clear();
+      uint64_t first = cache.first_index();
+      size_t n = cache.get_range(first, 16, 1 << 20, out);
+      for (size_t i = 0; i < n; ++i)
+        ASSERT_EQ(64U, out[i]->data().size());
+    }
+  });
+  for (uint64_t i = 1; i <= 20000; ++i)
+    cache.append(i, make_entry(1, 64));
+  done = true;
+  reader.join();
+  EXPECT_EQ(20000U, cache.last_index());
+  EXPECT_EQ(64U, cache.last_index() - cache.first_index() + 1);
+}
+
+} // namespace storage
+} // namespace ors
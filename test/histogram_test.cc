@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <utils/histogram.h>
+
+namespace ors {
+namespace utils {
+
+using buckets = log_linear_buckets;
+
+TEST(histogram, buckets) {
+  for (uint64_t v = 0; v < 100000; ++v) {
+    size_t i = buckets::index(v);
+    ASSERT_LT(i, buckets::COUNT);
+    ASSERT_LE(v, buckets::upper_bound(i)) << v;
+    if (i > 0) {
+      ASSERT_GT(v, buckets::upper_bound(i - 1)) << v;
+    }
+  }
+  EXPECT_EQ(buckets::COUNT - 1, buckets::index(UINT64_MAX));
+  EXPECT_EQ(UINT64_MAX, buckets::upper_bound(buckets::COUNT - 1));
+  // relative error stays within one sub-bucket
+  uint64_t v = 123456789;
+  EXPECT_LT(double(buckets::upper_bound(buckets::index(v)) - v) / double(v),
+            1.0 / buckets::SUB_COUNT);
+}
+
+TEST(histogram, quantiles) {
+  histogram h;
+  for (uint64_t v = 1; v <= 1000; ++v)
+    h.record(v);
+  EXPECT_EQ(1000U, h.count());
+  EXPECT_NEAR(500, double(h.quantile(0.5)), 500 * 0.04);
+  EXPECT_NEAR(990, double(h.quantile(0.99)), 990 * 0.04);
+  EXPECT_EQ(1U, h.quantile(0));
+
+  proto::LatencyStat out;
+  h.update_proto(out);
+  EXPECT_EQ(1000U, out.total().count());
+  EXPECT_EQ(1U, out.total().min());
+  EXPECT_LE(1000U, out.total().max());
+  EXPECT_EQ(h.quantile(0.999), out.total().p999());
+  EXPECT_EQ(0, out.total().window_nanos());
+  EXPECT_EQ(1000U, out.window().count());
+  EXPECT_EQ(10000000000, out.window().window_nanos());
+}
+
+TEST(histogram, window) {
+  histogram h(std::chrono::milliseconds(1));
+  time::steady_clock::time_point now =
+      time::steady_clock::time_point() + std::chrono::hours(1);
+  // frozen time, so the recent sample cannot age out before update_proto()
+  time::steady_clock::mocker m(now);
+  h.record(5, now - std::chrono::seconds(1));
+  h.record(7, now);
+  proto::LatencyStat out;
+  h.update_proto(out);
+  EXPECT_EQ(2U, out.total().count());
+  // the old sample aged out of the window
+  EXPECT_EQ(1U, out.window().count());
+  EXPECT_EQ(7U, out.window().max());
+}
+
+TEST(histogram, threads) {
+  histogram h;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.emplace_back([&h]() {
+      for (uint64_t i = 0; i < 10000; ++i)
+        h.record(i);
+    });
+  for (auto &t : threads)
+    t.join();
+  EXPECT_EQ(40000U, h.count());
+}
+
+} // namespace utils
+} // namespace ors
@@ -0,0 +1,160 @@
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <thread>
+#include <unistd.h>
+
+#include <utils/live_config.h>
+#include <utils/time.h>
+
+namespace ors {
+namespace utils {
+
+class live_config_test : public ::testing::Test {
+public:
+  live_config_test()
+      : dir(std::filesystem::temp_directory_path() /
+            ("ors_live_config_" + std::to_string(getpid()))),
+        path((dir / "server.conf").string()) {
+    std::filesystem::create_directories(dir);
+    write("max_batch = 64\n"
+          "election_timeout = 150ms  # comment\n"
+          "verbose = yes\n");
+  }
+
+  ~live_config_test() { std::filesystem::remove_all(dir); }
+
+  /// Replace the file the way editors do: write a new one, rename it over.
+  void write(const std::string &contents) {
+    std::string tmp = path + ".tmp";
+    std::ofstream(tmp) << contents;
+    std::filesystem::rename(tmp, path);
+  }
+
+  /// Wait up to a few seconds for cond.
+  template <typename F> bool eventually(F cond) {
+    for (int i = 0; i < 500; ++i) {
+      if (cond())
+        return true;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return cond();
+  }
+
+  std::filesystem::path dir;
+  std::string path;
+};
+
+TEST_F(live_config_test, typed_values) {
+  live_config cfg(path);
+  auto batch = cfg.integer("max_batch", 1024);
+  auto timeout = cfg.duration("election_timeout", "1s");
+  auto verbose = cfg.boolean("verbose", false);
+  auto missing = cfg.integer("missing", -5);
+  auto missing_timeout = cfg.duration("missing_timeout", "2s");
+  EXPECT_EQ(64, batch.get());
+  EXPECT_EQ(150U * 1000 * 1000, timeout.nanos());
+  EXPECT_EQ(std::chrono::milliseconds(150), timeout.chrono());
+  EXPECT_TRUE(verbose.get());
+  EXPECT_EQ(-5, missing.get());
+  EXPECT_EQ(2U * 1000 * 1000 * 1000, missing_timeout.nanos());
+}
+
+TEST_F(live_config_test, register_errors) {
+  EXPECT_THROW(live_config(path + ".nope"), config::file_not_found);
+  live_config cfg(path);
+  cfg.integer("max_batch", 1);
+  EXPECT_THROW(cfg.boolean("max_batch", true), config::exception);
+  EXPECT_THROW(cfg.integer("election_timeout", 0), config::conversion_error);
+  EXPECT_THROW(cfg.duration("max_batch", "1s"), config::exception);
+  EXPECT_THROW(cfg.boolean("election_timeout", true),
+               config::conversion_error);
+  EXPECT_THROW(cfg.duration("bad", "-3s"), config::conversion_error);
+  // the same key and type give the same handle
+  EXPECT_EQ(64, cfg.integer("max_batch", 99).get());
+}
+
+TEST_F(live_config_test, reload) {
+  live_config cfg(path);
+  auto batch = cfg.integer("max_batch", 1024);
+  auto timeout = cfg.duration("election_timeout", "1s");
+  int called = 0;
+  cfg.on_reload([&called] { ++called; });
+
+  write("max_batch = 128\n");
+  EXPECT_EQ("", cfg.reload());
+  EXPECT_EQ(128, batch.get());
+  EXPECT_EQ(1000U * 1000 * 1000, timeout.nanos()); // back to the default
+  EXPECT_EQ(1, called);
+  EXPECT_EQ(1U, cfg.num_reloads());
+
+  // one bad value rejects the whole reload
+  write("max_batch = 256\nelection_timeout = soon\n");
+  EXPECT_NE("", cfg.reload());
+  EXPECT_EQ(128, batch.get());
+  EXPECT_EQ(1, called);
+  EXPECT_EQ(1U, cfg.num_failed_reloads());
+
+  std::filesystem::remove(path);
+  EXPECT_NE("", cfg.reload());
+  EXPECT_EQ(128, batch.get());
+
+  // keys registered after a reload see the reloaded file
+  write("max_batch = 512\nother = 7\n");
+  EXPECT_EQ("", cfg.reload());
+  EXPECT_EQ(7, cfg.integer("other", 0).get());
+}
+
+TEST_F(live_config_test, watch) {
+  live_config cfg(path);
+  auto batch = cfg.integer("max_batch", 1024);
+  auto timeout = cfg.duration("election_timeout", "1s");
+  cfg.watch();
+  cfg.watch(); // once is enough
+
+  write("max_batch = 32\nelection_timeout = 300ms\n");
+  EXPECT_TRUE(eventually([&] { return batch.get() == 32; }));
+  EXPECT_EQ(300U * 1000 * 1000, timeout.nanos());
+
+  // written in place rather than replaced
+  std::ofstream(path) << "max_batch = 16\n";
+  EXPECT_TRUE(eventually([&] { return batch.get() == 16; }));
+
+  // other files in the directory are ignored
+  uint64_t reloads = cfg.num_reloads();
+  std::ofstream((dir / "unrelated").string()) << "max_batch = 1\n";
+  usleep(100 * 1000);
+  EXPECT_EQ(reloads, cfg.num_reloads());
+  EXPECT_EQ(16, batch.get());
+
+  cfg.stop();
+  write("max_batch = 8\n");
+  usleep(100 * 1000);
+  EXPECT_EQ(16, batch.get());
+}
+
+TEST_F(live_config_test, readers_during_reload) {
+  live_config cfg(path);
+  auto batch = cfg.integer("max_batch", 1024);
+  std::atomic<bool> done(false);
+  std::atomic<uint64_t> bad(0);
+  std::thread reader([&] {
+    while (!done) {
+      int64_t v = batch.get();
+      if (v != 64 && v != 65)
+        ++bad;
+    }
+  });
+  for (int i = 0; i < 50; ++i) {
+    write(i % 2 ? "max_batch = 64\n" : "max_batch = 65\n");
+    cfg.reload();
+  }
+  done = true;
+  reader.join();
+  EXPECT_EQ(0U, bad);
+  EXPECT_EQ(50U, cfg.num_reloads());
+}
+
+} // namespace utils
+} // namespace ors
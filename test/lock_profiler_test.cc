@@ -0,0 +1,118 @@
+#include <chrono>
+#include <gtest/gtest.h>
+#include <thread>
+#include <utils/cond.h>
+#include <utils/lock_profiler.h>
+#include <utils/mutex.h>
+
+namespace ors {
+namespace utils {
+
+namespace {
+const proto::ServerStats::Locks::Site *
+find(const proto::ServerStats::Locks &locks, const std::string &name) {
+  for (auto &s : locks.site()) {
+    if (s.name() == name)
+      return &s;
+  }
+  return nullptr;
+}
+} // namespace
+
+class lock_profiler_test : public ::testing::Test {
+protected:
+  void SetUp() override {
+    lock_profiler::reset();
+    lock_profiler::enable(true);
+  }
+  void TearDown() override {
+    lock_profiler::enable(false);
+    lock_profiler::reset();
+  }
+};
+
+TEST_F(lock_profiler_test, disabled_records_nothing) {
+  lock_profiler::enable(false);
+  mutex m("lock_profiler_test.disabled");
+  m.lock();
+  m.unlock();
+  proto::ServerStats::Locks locks;
+  lock_profiler::update_server_stats(locks);
+  EXPECT_FALSE(locks.profiling());
+  EXPECT_EQ(nullptr, find(locks, "lock_profiler_test.disabled"));
+}
+
+TEST_F(lock_profiler_test, counts_acquisitions_and_hold_time) {
+  mutex m("lock_profiler_test.hold");
+  for (int i = 0; i < 3; ++i) {
+    std::lock_guard<mutex> lg(m);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  EXPECT_TRUE(m.try_lock());
+  m.unlock();
+
+  proto::ServerStats::Locks locks;
+  lock_profiler::update_server_stats(locks);
+  EXPECT_TRUE(locks.profiling());
+  auto *s = find(locks, "lock_profiler_test.hold");
+  ASSERT_NE(nullptr, s);
+  EXPECT_EQ(4U, s->acquisitions());
+  EXPECT_EQ(0U, s->contended());
+  EXPECT_GE(s->hold_nanos(), 5U * 1000 * 1000);
+  EXPECT_GE(s->max_hold_nanos(), 1U * 1000 * 1000);
+  EXPECT_LE(s->max_hold_nanos(), s->hold_nanos());
+}
+
+TEST_F(lock_profiler_test, same_name_shares_site) {
+  mutex a("lock_profiler_test.shared");
+  mutex b("lock_profiler_test.shared");
+  a.lock();
+  a.unlock();
+  b.lock();
+  b.unlock();
+  proto::ServerStats::Locks locks;
+  lock_profiler::update_server_stats(locks);
+  auto *s = find(locks, "lock_profiler_test.shared");
+  ASSERT_NE(nullptr, s);
+  EXPECT_EQ(2U, s->acquisitions());
+}
+
+TEST_F(lock_profiler_test, contention) {
+  mutex m("lock_profiler_test.contended");
+  std::unique_lock<mutex> ul(m);
+  std::thread t([&] {
+    std::lock_guard<mutex> lg(m);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ul.unlock();
+  t.join();
+
+  proto::ServerStats::Locks locks;
+  lock_profiler::update_server_stats(locks);
+  auto *s = find(locks, "lock_profiler_test.contended");
+  ASSERT_NE(nullptr, s);
+  EXPECT_EQ(2U, s->acquisitions());
+  EXPECT_EQ(1U, s->contended());
+  EXPECT_GE(s->max_wait_nanos(), 10U * 1000 * 1000);
+  // the most waited-on site comes first
+  EXPECT_EQ("lock_profiler_test.contended", locks.site(0).name());
+}
+
+TEST_F(lock_profiler_test, condition_wait_ends_hold) {
+  mutex m("lock_profiler_test.cond");
+  condition_variable cv;
+  std::unique_lock<mutex> ul(m);
+  cv.wait_until(ul, time::steady_clock::now() + std::chrono::milliseconds(20));
+  ul.unlock();
+
+  proto::ServerStats::Locks locks;
+  lock_profiler::update_server_stats(locks);
+  auto *s = find(locks, "lock_profiler_test.cond");
+  ASSERT_NE(nullptr, s);
+  // one hold before the wait and one after; neither includes the wait
+  EXPECT_EQ(2U, s->acquisitions());
+  EXPECT_LT(s->max_hold_nanos(), 10U * 1000 * 1000);
+}
+
+} // namespace utils
+} // namespace ors
@@ -1,12 +1,218 @@
-#include "spdlog/spdlog.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
 
-void test_spdlog() {
-  spdlog::set_level(spdlog::level::debug);
-  spdlog::debug("Backtrace message {}", 33);
-  spdlog::info("set spdlog {}", "dependencies ok");
+#include <utils/log.h>
+
+using namespace ors::utils;
+
+namespace {
+/// Has no raw binary form, so it is shipped as text.
+struct point {
+  int x;
+  int y;
+};
+} // namespace
+
+template <> struct fmt::formatter<point> : fmt::formatter<int> {
+  auto format(const point &p, format_context &ctx) const {
+    return fmt::format_to(ctx.out(), "({}, {})", p.x, p.y);
+  }
+};
+
+namespace {
+
+class LogTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    path = "/tmp/ors_log_test." + std::to_string(::getpid());
+    std::remove(path.c_str());
+    log::set_filename(path);
+    log::set_policy("NOTICE");
+  }
+
+  void TearDown() override {
+    log::set_encoding(log::encoding::TEXT);
+    log::set_filename("");
+    log::set_policy("NOTICE");
+    std::remove(path.c_str());
+  }
+
+  std::string contents() {
+    log::flush();
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+  }
+
+  std::string path;
+};
+
+TEST_F(LogTest, PolicyRoundTrip) {
+  log::set_policy(" src/storage@VERBOSE, src/utils/cond.cc@ERROR ,WARNING");
+  EXPECT_EQ("src/storage@VERBOSE,src/utils/cond.cc@ERROR,WARNING",
+            log::policy());
+  log::set_policy("");
+  EXPECT_EQ("NOTICE", log::policy());
+  EXPECT_THROW(log::set_policy("src@LOUD"), std::invalid_argument);
+}
+
+TEST_F(LogTest, ModuleLevels) {
+  auto &storage = log::module("/build/ors/src/storage/snapshot_file.cc");
+  auto &cond = log::module("/build/ors/src/utils/cond.cc");
+  auto &other = log::module("/build/ors/src/utils/time.cc");
+  EXPECT_EQ(uint8_t(log::level::NOTICE), storage.load());
+
+  // existing modules pick up a new policy
+  log::set_policy("src/storage@VERBOSE,src/utils/cond.cc@ERROR,WARNING");
+  EXPECT_EQ(uint8_t(log::level::VERBOSE), storage.load());
+  EXPECT_EQ(uint8_t(log::level::ERROR), cond.load());
+  EXPECT_EQ(uint8_t(log::level::WARNING), other.load());
+  EXPECT_EQ(&storage, &log::module("/elsewhere/src/storage/snapshot_file.cc"));
+}
+
+TEST_F(LogTest, WritesFormattedRecords) {
+  ORS_NOTICE("hello {} {}", 42, std::string("world"));
+  std::string out = contents();
+  EXPECT_NE(std::string::npos, out.find("hello 42 world")) << out;
+  EXPECT_NE(std::string::npos, out.find("test/log_test.cc:")) << out;
+  EXPECT_NE(std::string::npos, out.find("NOTICE[")) << out;
+}
+
+TEST_F(LogTest, DisabledLevelsAreSkipped) {
+  log::set_policy("test/log_test.cc@ERROR,VERBOSE");
+  ORS_WARNING("hidden");
+  ORS_ERROR("shown");
+  std::string out = contents();
+  EXPECT_EQ(std::string::npos, out.find("hidden")) << out;
+  EXPECT_NE(std::string::npos, out.find("shown")) << out;
+}
+
+TEST_F(LogTest, CopiesStringArguments) {
+  char buf[] = "before";
+  ORS_NOTICE("value {}", static_cast<const char *>(buf));
+  buf[0] = 'X';
+  EXPECT_NE(std::string::npos, contents().find("value before"));
+}
+
+TEST_F(LogTest, CopiesStringViewArguments) {
+  std::string tmp = "before";
+  ORS_NOTICE("view {}", std::string_view(tmp));
+  char buf[] = "array";
+  ORS_NOTICE("array {}", buf);
+  tmp.assign(tmp.size(), 'X');
+  buf[0] = 'X';
+  std::string out = contents();
+  EXPECT_NE(std::string::npos, out.find("view before"));
+  EXPECT_NE(std::string::npos, out.find("array array"));
+}
+
+TEST_F(LogTest, BadFormatDoesNotThrow) {
+  ORS_NOTICE("missing {} {}", 1);
+  EXPECT_NE(std::string::npos, contents().find("bad log format"));
+}
+
+TEST_F(LogTest, ForkedChildLogs) {
+  // a thread of the parent's with its own ring, which the child drops
+  std::thread([] { ORS_NOTICE("parent thread"); }).join();
+  ORS_NOTICE("before fork");
+  log::flush();
+  // let the writer go idle, so it is waiting when the fork happens
+  usleep(10000);
+  pid_t child = fork();
+  ASSERT_LE(0, child);
+  if (child == 0) {
+    alarm(10); // a hung flush fails the test instead of blocking it
+    for (int i = 0; i < 5; ++i) {
+      ORS_NOTICE("child record {}", i);
+      log::flush();
+    }
+    _exit(0);
+  }
+  int status = 0;
+  ASSERT_EQ(child, waitpid(child, &status, 0));
+  ASSERT_TRUE(WIFEXITED(status)) << status;
+  EXPECT_EQ(0, WEXITSTATUS(status));
+  std::string out = contents();
+  for (int i = 0; i < 5; ++i)
+    EXPECT_NE(std::string::npos, out.find("child record " + std::to_string(i)));
+  // records from before the fork are written once, by the parent
+  size_t first = out.find("before fork");
+  ASSERT_NE(std::string::npos, first);
+  EXPECT_EQ(std::string::npos, out.find("before fork", first + 1));
+}
+
+TEST_F(LogTest, ManyThreads) {
+  constexpr int THREADS = 4;
+  constexpr int PER_THREAD = 1000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < THREADS; ++t) {
+    threads.emplace_back([t] {
+      for (int i = 0; i < PER_THREAD; ++i)
+        ORS_NOTICE("thread {} message {}", t, i);
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+  std::string out = contents();
+  size_t lines = 0;
+  for (char c : out)
+    lines += c == '\n';
+  EXPECT_EQ(0U, log::num_dropped());
+  EXPECT_EQ(size_t(THREADS * PER_THREAD), lines);
+  EXPECT_NE(std::string::npos, out.find("thread 3 message 999"));
+}
+
+TEST_F(LogTest, BinaryRoundTrip) {
+  log::set_encoding(log::encoding::BINARY);
+  ORS_NOTICE("ints {} {} {}", -5, uint64_t(1) << 63, 'c');
+  ORS_NOTICE("bool {} double {:.2f}", true, 2.5);
+  ORS_WARNING("text {} {}", "abc", std::string(1000, 'x'));
+  ORS_NOTICE("custom {}", point{1, 2});
+  for (int i = 0; i < 3; ++i)
+    ORS_NOTICE("repeat {}", i);
+  std::string binary = contents();
+  EXPECT_EQ(std::string::npos, binary.find("ints -5"));
+
+  std::istringstream in(binary);
+  std::ostringstream out;
+  EXPECT_EQ("", log::decode(in, out));
+  std::string text = out.str();
+  EXPECT_NE(std::string::npos, text.find("ints -5 9223372036854775808 c"))
+      << text;
+  EXPECT_NE(std::string::npos, text.find("bool true double 2.50")) << text;
+  EXPECT_NE(std::string::npos, text.find("WARNING[")) << text;
+  EXPECT_NE(std::string::npos, text.find("text abc " + std::string(1000, 'x')));
+  EXPECT_NE(std::string::npos, text.find("custom (1, 2)")) << text;
+  EXPECT_NE(std::string::npos, text.find("repeat 2")) << text;
+  EXPECT_NE(std::string::npos, text.find("test/log_test.cc:")) << text;
+  // each site's metadata is written once
+  size_t count = 0;
+  for (size_t pos = 0; (pos = binary.find("repeat {}", pos)) != std::string::npos;
+       ++pos)
+    ++count;
+  EXPECT_EQ(1U, count);
+}
+
+TEST_F(LogTest, DecodeErrors) {
+  std::ostringstream out;
+  std::istringstream text("12345.000000 hello\n");
+  EXPECT_NE("", log::decode(text, out));
+
+  log::set_encoding(log::encoding::BINARY);
+  ORS_NOTICE("truncated {}", std::string(100, 'y'));
+  std::string binary = contents();
+  std::istringstream cut(binary.substr(0, binary.size() - 10));
+  EXPECT_NE("", log::decode(cut, out));
 }
 
-// int main(int argc, char const *argv[]) {
-//   test_spdlog();
-//   return 0;
-// }
+} // namespace
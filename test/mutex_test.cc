@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <utils/cond.h>
+#include <utils/mutex.h>
+#include <vector>
+
+namespace ors {
+namespace utils {
+
+namespace {
+/// Each of threads threads increments a shared counter under m.
+template <typename lock_type>
+uint64_t hammer(lock_type &m, int threads, int per_thread) {
+  uint64_t counter = 0;
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&] {
+      for (int i = 0; i < per_thread; ++i) {
+        std::lock_guard<lock_type> lg(m);
+        ++counter;
+      }
+    });
+  }
+  for (auto &w : workers)
+    w.join();
+  return counter;
+}
+} // namespace
+
+TEST(mutex, none_policy_is_free) {
+  EXPECT_EQ(sizeof(std::mutex), sizeof(basic_mutex<mutex_policy::none>));
+  EXPECT_EQ(sizeof(adaptive_mutex),
+            sizeof(basic_mutex<mutex_policy::none, adaptive_mutex>));
+}
+
+TEST(mutex, test_hook_counts) {
+  basic_mutex<mutex_policy::test_hook> m;
+  int calls = 0;
+  m.cb = [&] { ++calls; };
+  m.lock();
+  m.unlock();
+  EXPECT_TRUE(m.try_lock());
+  m.unlock();
+  EXPECT_EQ(4, calls);
+}
+
+TEST(mutex, named_policies_construct) {
+  basic_mutex<mutex_policy::none> a("mutex_test.none");
+  basic_mutex<mutex_policy::test_hook> b("mutex_test.hook");
+  mutex c("mutex_test.profiled");
+  std::lock_guard<basic_mutex<mutex_policy::none>> la(a);
+  std::lock_guard<basic_mutex<mutex_policy::test_hook>> lb(b);
+  std::lock_guard<mutex> lc(c);
+}
+
+TEST(mutex, policies_with_condition_variable) {
+  basic_mutex<mutex_policy::none> m;
+  condition_variable cv;
+  std::unique_lock<basic_mutex<mutex_policy::none>> ul(m);
+  cv.wait_until(ul, time::steady_clock::now() + std::chrono::milliseconds(1));
+  EXPECT_TRUE(ul.owns_lock());
+}
+
+TEST(adaptive_mutex, try_lock) {
+  adaptive_mutex m;
+  EXPECT_TRUE(m.try_lock());
+  EXPECT_FALSE(m.try_lock());
+  m.unlock();
+  EXPECT_TRUE(m.try_lock());
+  m.unlock();
+}
+
+TEST(adaptive_mutex, mutual_exclusion) {
+  adaptive_mutex m;
+  EXPECT_EQ(4U * 20000, hammer(m, 4, 20000));
+  basic_mutex<mutex_policy::profiled, adaptive_mutex> pm("mutex_test.adaptive");
+  EXPECT_EQ(4U * 20000, hammer(pm, 4, 20000));
+}
+
+TEST(adaptive_mutex, parks_waiters) {
+  adaptive_mutex m;
+  m.lock();
+  std::atomic<bool> got(false);
+  std::thread t([&] {
+    m.lock();
+    got = true;
+    m.unlock();
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_FALSE(got);
+  m.unlock();
+  t.join();
+  EXPECT_TRUE(got);
+}
+
+} // namespace utils
+} // namespace ors
@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <limits>
 #include <thread>
 #include <unistd.h>
 
@@ -119,6 +120,65 @@ TEST(CoreRandomTest, randomRangeInt) {
   EXPECT_NE(random_range(10000, 0), random_range(10000, 0));
 }
 
+TEST(rand_test, random_range_signed) {
+  bool negative = false, positive = false;
+  for (int i = 0; i < 100; ++i) {
+    int r = random_range(-3, 3);
+    EXPECT_LE(-3, r);
+    EXPECT_GE(3, r);
+    negative |= r < 0;
+    positive |= r > 0;
+  }
+  EXPECT_TRUE(negative);
+  EXPECT_TRUE(positive);
+  EXPECT_EQ(INT64_MIN, random_range(INT64_MIN, INT64_MIN));
+  // the full range does not overflow the span
+  random_range(uint64_t(0), std::numeric_limits<uint64_t>::max());
+  random_range(INT64_MIN, INT64_MAX);
+}
+
+TEST(rand_test, xoshiro256_seeded_sequence_repeats) {
+  xoshiro256 a(42), b(42), c(43);
+  bool differs = false;
+  for (int i = 0; i < 100; ++i) {
+    uint64_t x = a();
+    EXPECT_EQ(x, b());
+    differs |= x != c();
+  }
+  EXPECT_TRUE(differs);
+}
+
+TEST(rand_test, bounded_is_uniform) {
+  // 3 does not divide 2^64, so a modulo would be (slightly) biased; this
+  // only checks the result is in range and roughly uniform
+  xoshiro256 g(7);
+  int counts[3] = {};
+  for (int i = 0; i < 30000; ++i)
+    ++counts[g.bounded(3)];
+  for (int c : counts) {
+    EXPECT_LT(9500, c);
+    EXPECT_GT(10500, c);
+  }
+  // nearly half of all draws fall in the rejection zone for this n
+  uint64_t n = (uint64_t(1) << 63) + 1;
+  for (int i = 0; i < 100; ++i)
+    EXPECT_GT(n, g.bounded(n));
+  EXPECT_EQ(0U, g.bounded(1));
+}
+
+TEST(rand_test, generator_per_thread) {
+  xoshiro256 *mine = &generator();
+  xoshiro256 *other = nullptr;
+  uint64_t theirs = 0;
+  std::thread t([&] {
+    other = &generator();
+    theirs = random64();
+  });
+  t.join();
+  EXPECT_NE(mine, other);
+  EXPECT_NE(theirs, random64());
+}
+
 void sleep_with_Lock(bool &haveLock, std::mutex &m,
                    ors::utils::condition_variable &c) {
   ors::utils::rand::acquire_mutex();
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <utils/rolling_stat.h>
+
+namespace ors {
+namespace utils {
+
+TEST(rolling_stat, empty) {
+  rolling_stat stat;
+  proto::RollingStat out;
+  stat.update_proto(out);
+  EXPECT_EQ(0U, out.count());
+  EXPECT_EQ(0U, out.sum());
+  EXPECT_FALSE(out.has_average());
+  EXPECT_EQ(0U, stat.count());
+}
+
+TEST(rolling_stat, basics) {
+  rolling_stat stat;
+  stat.push(2);
+  stat.push(4);
+  stat.push(6);
+  proto::RollingStat out;
+  stat.update_proto(out);
+  EXPECT_EQ(3U, out.count());
+  EXPECT_EQ(12U, out.sum());
+  EXPECT_EQ(4.0, out.average());
+  EXPECT_EQ(2U, out.min());
+  EXPECT_EQ(6U, out.max());
+  EXPECT_EQ(6U, out.last());
+  EXPECT_NEAR(1.633, out.stddev(), 0.001);
+  EXPECT_EQ(4.5, out.ewma2());   // 2 -> 3 -> 4.5
+  EXPECT_EQ(3.375, out.ewma4()); // 2 -> 2.5 -> 3.375
+}
+
+TEST(rolling_stat, exceptional) {
+  rolling_stat stat;
+  for (uint64_t i = 1; i <= 7; ++i)
+    stat.note_exceptional(
+        time::system_clock::time_point(std::chrono::nanoseconds(i)), i * 10);
+  proto::RollingStat out;
+  stat.update_proto(out);
+  EXPECT_EQ(7U, out.count());
+  EXPECT_EQ(7U, out.exceptional_count());
+  ASSERT_EQ(int(rolling_stat::MAX_EXCEPTIONAL), out.last_exceptional_size());
+  EXPECT_EQ(3, out.last_exceptional(0).when());
+  EXPECT_EQ(70U, out.last_exceptional(4).value());
+}
+
+TEST(rolling_stat, threads) {
+  rolling_stat stat;
+  std::vector<std::thread> threads;
+  for (uint64_t t = 0; t < 4; ++t) {
+    threads.emplace_back([&stat, t]() {
+      for (uint64_t i = 0; i < 10000; ++i)
+        stat.push(t + 1);
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+  proto::RollingStat out;
+  stat.update_proto(out);
+  EXPECT_EQ(40000U, out.count());
+  EXPECT_EQ(100000U, out.sum());
+  EXPECT_EQ(1U, out.min());
+  EXPECT_EQ(4U, out.max());
+  EXPECT_EQ(2.5, out.average());
+  EXPECT_EQ(2.5, out.ewma2());
+}
+
+TEST(rolling_stat, recreated) {
+  // each new stat reuses the id just freed; this thread's cached shard for
+  // that id belongs to the destroyed stat and must not be used
+  for (uint64_t i = 1; i <= 100; ++i) {
+    auto stat = std::make_unique<rolling_stat>();
+    stat->push(i);
+    stat->push(i);
+    EXPECT_EQ(2U, stat->count());
+    proto::RollingStat out;
+    stat->update_proto(out);
+    EXPECT_EQ(2 * i, out.sum());
+  }
+}
+
+} // namespace utils
+} // namespace ors
@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+#include <state_machine/session_table.h>
+
+namespace ors {
+namespace state_machine {
+
+static proto::client::ExactlyOnceRPCInfo rpc(uint64_t client_id,
+                                             uint64_t first_outstanding,
+                                             uint64_t number) {
+  proto::client::ExactlyOnceRPCInfo info;
+  info.set_client_id(client_id);
+  info.set_first_outstanding_rpc(first_outstanding);
+  info.set_rpc_number(number);
+  return info;
+}
+
+class session_table_test : public ::testing::Test {
+public:
+  session_table_test() : table(1000, 4) {}
+  session_table table;
+};
+
+TEST_F(session_table_test, no_session) {
+  std::string response;
+  EXPECT_EQ(session_table::EXPIRED, table.check(rpc(1, 1, 1), 0, response));
+}
+
+TEST_F(session_table_test, duplicate) {
+  std::string response;
+  table.open(1, 0);
+  EXPECT_EQ(session_table::NEW, table.check(rpc(1, 1, 1), 0, response));
+  table.record(rpc(1, 1, 1), "one");
+  EXPECT_EQ(session_table::DUPLICATE, table.check(rpc(1, 1, 1), 0, response));
+  EXPECT_EQ("one", response);
+  EXPECT_EQ(session_table::NEW, table.check(rpc(1, 1, 2), 0, response));
+  table.record(rpc(1, 1, 2), "two");
+  // client acknowledged 1: its response is gone
+  EXPECT_EQ(session_table::STALE, table.check(rpc(1, 2, 1), 0, response));
+  EXPECT_EQ(session_table::DUPLICATE, table.check(rpc(1, 2, 2), 0, response));
+  EXPECT_EQ("two", response);
+
+  proto::ServerStats::StateMachine stats;
+  table.update_server_stats(stats);
+  EXPECT_EQ(1U, stats.num_sessions());
+  EXPECT_EQ(1U, stats.num_cached_responses());
+  EXPECT_EQ(2U, stats.num_duplicate_rpcs());
+}
+
+TEST_F(session_table_test, out_of_order) {
+  std::string response;
+  table.open(1, 0);
+  // a client with RPCs 1 and 2 outstanding; 2 is applied first
+  EXPECT_EQ(session_table::NEW, table.check(rpc(1, 1, 2), 0, response));
+  table.record(rpc(1, 1, 2), "two");
+  EXPECT_EQ(session_table::NEW, table.check(rpc(1, 1, 1), 0, response));
+  table.record(rpc(1, 1, 1), "one");
+  EXPECT_EQ(session_table::DUPLICATE, table.check(rpc(1, 1, 1), 0, response));
+  EXPECT_EQ("one", response);
+  EXPECT_EQ(session_table::DUPLICATE, table.check(rpc(1, 1, 2), 0, response));
+  EXPECT_EQ("two", response);
+
+  // a gap below an evicted response is still new
+  for (uint64_t n = 4; n <= 9; ++n)
+    table.record(rpc(1, 3, n), std::to_string(n));
+  EXPECT_EQ(session_table::EXPIRED, table.check(rpc(1, 3, 4), 0, response));
+  EXPECT_EQ(session_table::NEW, table.check(rpc(1, 3, 3), 0, response));
+  // once acknowledged, the evicted one is simply stale
+  EXPECT_EQ(session_table::STALE, table.check(rpc(1, 5, 4), 0, response));
+}
+
+TEST_F(session_table_test, outstanding_bounded) {
+  session_table small(1000, 4, 16);
+  std::string response;
+  small.open(1, 0);
+  // pipelining without ever acknowledging: responses past the ring are
+  // evicted, but only up to the cap
+  for (uint64_t n = 1; n <= 16; ++n) {
+    ASSERT_EQ(session_table::NEW, small.check(rpc(1, 1, n), 0, response));
+    small.record(rpc(1, 1, n), std::to_string(n));
+  }
+  proto::ServerStats::StateMachine stats;
+  small.update_server_stats(stats);
+  EXPECT_EQ(12U, stats.num_evicted_responses());
+  EXPECT_EQ(session_table::EXPIRED, small.check(rpc(1, 1, 17), 0, response));
+  EXPECT_FALSE(small.has_session(1));
+  small.update_server_stats(stats);
+  EXPECT_EQ(1U, stats.num_expired_sessions());
+
+  // acknowledging keeps a long-lived client within the cap
+  small.open(2, 0);
+  for (uint64_t n = 1; n <= 100; ++n) {
+    uint64_t first = n > 8 ? n - 8 : 1;
+    ASSERT_EQ(session_table::NEW, small.check(rpc(2, first, n), 0, response));
+    small.record(rpc(2, first, n), std::to_string(n));
+  }
+  EXPECT_TRUE(small.has_session(2));
+}
+
+TEST_F(session_table_test, ring_bounded) {
+  std::string response;
+  table.open(1, 0);
+  // 6 outstanding RPCs with room for 4 responses
+  for (uint64_t n = 1; n <= 6; ++n) {
+    EXPECT_EQ(session_table::NEW, table.check(rpc(1, 1, n), 0, response));
+    table.record(rpc(1, 1, n), std::to_string(n));
+  }
+  EXPECT_EQ(session_table::EXPIRED, table.check(rpc(1, 1, 1), 0, response));
+  EXPECT_EQ(session_table::DUPLICATE, table.check(rpc(1, 1, 6), 0, response));
+  EXPECT_EQ("6", response);
+  proto::ServerStats::StateMachine stats;
+  table.update_server_stats(stats);
+  EXPECT_EQ(4U, stats.num_cached_responses());
+  EXPECT_EQ(2U, stats.num_evicted_responses());
+
+  // acknowledging everything frees the ring
+  EXPECT_EQ(session_table::NEW, table.check(rpc(1, 7, 7), 0, response));
+  table.update_server_stats(stats);
+  EXPECT_EQ(0U, stats.num_cached_responses());
+}
+
+TEST_F(session_table_test, expire) {
+  std::string response;
+  table.open(1, 0);
+  table.open(2, 500);
+  table.open(3, 900);
+  EXPECT_EQ(0U, table.expire(900));
+  // using session 1 keeps it alive
+  EXPECT_EQ(session_table::NEW, table.check(rpc(1, 1, 1), 1200, response));
+  EXPECT_EQ(1U, table.expire(1600));
+  EXPECT_TRUE(table.has_session(1));
+  EXPECT_FALSE(table.has_session(2));
+  EXPECT_TRUE(table.has_session(3));
+  EXPECT_EQ(2U, table.expire(10000));
+  EXPECT_EQ(0U, table.size());
+  EXPECT_EQ(session_table::EXPIRED, table.check(rpc(1, 1, 1), 0, response));
+}
+
+TEST_F(session_table_test, close) {
+  table.open(1, 0);
+  table.record(rpc(1, 1, 1), "one");
+  table.close(1);
+  EXPECT_FALSE(table.has_session(1));
+  proto::ServerStats::StateMachine stats;
+  table.update_server_stats(stats);
+  EXPECT_EQ(0U, stats.num_sessions());
+  EXPECT_EQ(0U, stats.num_cached_responses());
+}
+
+} // namespace state_machine
+} // namespace ors
@@ -0,0 +1,236 @@
+#include <gtest/gtest.h>
+
+#include <sim/cluster.h>
+
+namespace ors {
+namespace sim {
+
+namespace {
+const uint64_t MS = 1000 * 1000;
+const uint64_t SEC = 1000 * MS;
+
+size_t leader_index(cluster &c) {
+  raft_server *l = c.leader();
+  return l ? l->get_id() - 1 : c.size();
+}
+} // namespace
+
+TEST(sim_test, event_queue_order) {
+  event_queue q;
+  std::vector<int> ran;
+  q.schedule(20, [&] { ran.push_back(3); });
+  q.schedule(10, [&] { ran.push_back(1); });
+  q.schedule(10, [&] { ran.push_back(2); });
+  uint64_t id = q.schedule(15, [&] { ran.push_back(0); });
+  q.cancel(id);
+  q.run_until(15);
+  EXPECT_EQ((std::vector<int>{1, 2}), ran);
+  EXPECT_EQ(15U, q.now());
+  EXPECT_EQ(20U, q.next_time());
+  EXPECT_TRUE(q.step());
+  EXPECT_FALSE(q.step());
+  EXPECT_EQ((std::vector<int>{1, 2, 3}), ran);
+  EXPECT_EQ(20U, q.now());
+}
+
+TEST(sim_test, network_partition) {
+  event_queue q;
+  utils::rand::xoshiro256 rng(1);
+  network net(q, rng, network_options());
+  std::vector<uint64_t> from;
+  for (uint64_t id = 1; id <= 3; ++id)
+    net.attach(id, [&](uint64_t f, const message &) { from.push_back(f); });
+  net.partition({{1, 2}, {3}});
+  EXPECT_TRUE(net.connected(1, 2));
+  EXPECT_FALSE(net.connected(1, 3));
+  net.send(1, 2, proto::raft::RequestVote::Response());
+  net.send(1, 3, proto::raft::RequestVote::Response());
+  // cut while in flight
+  net.send(2, 1, proto::raft::RequestVote::Response());
+  net.isolate(1);
+  q.run_until(SEC);
+  EXPECT_TRUE(from.empty());
+  EXPECT_EQ(3U, net.num_sent());
+  EXPECT_EQ(3U, net.num_dropped());
+  net.heal();
+  net.send(3, 1, proto::raft::RequestVote::Response());
+  q.run_until(2 * SEC);
+  EXPECT_EQ((std::vector<uint64_t>{3}), from);
+}
+
+TEST(sim_test, elects_one_leader) {
+  cluster c(cluster_options{});
+  ASSERT_TRUE(c.wait_for_leader(5 * SEC));
+  c.run_for(SEC);
+  size_t leaders = 0;
+  for (size_t i = 0; i < c.size(); ++i)
+    leaders += c.server(i).get_state() == raft_server::LEADER;
+  EXPECT_EQ(1U, leaders);
+  // heartbeats hold the election off
+  uint64_t term = c.leader()->get_term();
+  c.run_for(10 * SEC);
+  EXPECT_EQ(term, c.leader()->get_term());
+  EXPECT_EQ("", c.check_safety());
+}
+
+TEST(sim_test, replicates) {
+  cluster_options opts;
+  opts.servers = 5;
+  cluster c(opts);
+  ASSERT_TRUE(c.wait_for_leader(5 * SEC));
+  report r = c.run_workload(2 * SEC, 4, 64);
+  EXPECT_GT(r.committed, 1000U) << r.to_string();
+  EXPECT_EQ(0U, r.elections) << r.to_string();
+  // entries are batched; heartbeats must not pile up extra request streams
+  EXPECT_LT(r.messages_sent, 4 * r.committed) << r.to_string();
+  EXPECT_LE(r.p50_latency_nanos, r.p99_latency_nanos);
+  EXPECT_LE(r.p99_latency_nanos, r.max_latency_nanos);
+  // with one request in flight per follower, an entry may wait for the
+  // round trip ahead of it and then take its own: two of at most 2ms each
+  EXPECT_LE(r.max_latency_nanos, 4 * MS) << r.to_string();
+  c.run_for(SEC);
+  uint64_t last = c.leader()->last_log_index();
+  for (size_t i = 0; i < c.size(); ++i) {
+    EXPECT_EQ(last, c.server(i).get_commit_index()) << i;
+    EXPECT_EQ("c0:0", c.server(i).entry(2).data().substr(0, 4));
+    EXPECT_EQ(64U, c.server(i).entry(2).data().size());
+  }
+  EXPECT_EQ("", c.check_safety());
+}
+
+TEST(sim_test, lossy_network) {
+  cluster_options opts;
+  opts.net.drop_rate = 0.1;
+  opts.net.reorder_rate = 0.2;
+  cluster c(opts);
+  ASSERT_TRUE(c.wait_for_leader(10 * SEC));
+  report r = c.run_workload(5 * SEC, 4, 16);
+  EXPECT_GT(r.committed, 100U) << r.to_string();
+  EXPECT_GT(r.messages_dropped, 0U);
+  EXPECT_EQ("", c.check_safety());
+}
+
+TEST(sim_test, leader_partitioned_away) {
+  cluster_options opts;
+  opts.servers = 5;
+  cluster c(opts);
+  ASSERT_TRUE(c.wait_for_leader(5 * SEC));
+  raft_server *old = c.leader();
+  uint64_t term = old->get_term();
+  c.net().isolate(old->get_id());
+  // the old leader takes this, but can never commit it
+  uint64_t lost = old->submit("lost");
+  ASSERT_NE(0U, lost);
+  c.run_for(2 * SEC);
+  raft_server *l = c.leader();
+  ASSERT_NE(nullptr, l);
+  EXPECT_NE(old, l);
+  EXPECT_GT(l->get_term(), term);
+  EXPECT_GT(c.run_workload(SEC, 2, 16).committed, 100U);
+
+  c.net().heal();
+  c.run_for(2 * SEC);
+  EXPECT_EQ(raft_server::FOLLOWER, old->get_state());
+  EXPECT_EQ(l->get_commit_index(), old->get_commit_index());
+  EXPECT_NE("lost", old->entry(lost).data());
+  EXPECT_EQ("", c.check_safety());
+}
+
+TEST(sim_test, minority_cannot_commit) {
+  cluster c(cluster_options{});
+  ASSERT_TRUE(c.wait_for_leader(5 * SEC));
+  size_t l = leader_index(c);
+  uint64_t commit = c.leader()->get_commit_index();
+  c.crash((l + 1) % 3);
+  c.crash((l + 2) % 3);
+  report r = c.run_workload(SEC, 1, 16);
+  EXPECT_EQ(0U, r.committed) << r.to_string();
+  EXPECT_EQ(commit, c.server(l).get_commit_index());
+
+  c.restart((l + 1) % 3);
+  c.restart((l + 2) % 3);
+  r = c.run_workload(2 * SEC, 1, 16);
+  EXPECT_GT(r.committed, 100U) << r.to_string();
+  EXPECT_EQ("", c.check_safety());
+}
+
+TEST(sim_test, crash_and_restart_leader) {
+  cluster c(cluster_options{});
+  ASSERT_TRUE(c.wait_for_leader(5 * SEC));
+  c.run_workload(SEC, 2, 16);
+  size_t l = leader_index(c);
+  uint64_t commit = c.server(l).get_commit_index();
+  c.crash(l);
+  EXPECT_FALSE(c.server(l).is_up());
+  ASSERT_TRUE(c.wait_for_leader(5 * SEC));
+  EXPECT_NE(l, leader_index(c));
+  c.restart(l);
+  c.run_workload(SEC, 2, 16);
+  c.run_for(SEC);
+  EXPECT_GT(c.server(l).get_commit_index(), commit);
+  EXPECT_EQ(c.leader()->get_commit_index(), c.server(l).get_commit_index());
+  EXPECT_EQ("", c.check_safety());
+}
+
+TEST(sim_test, same_seed_same_run) {
+  cluster_options opts;
+  opts.seed = 42;
+  opts.net.drop_rate = 0.05;
+  opts.net.reorder_rate = 0.1;
+  std::string out[3];
+  for (int i = 0; i < 3; ++i) {
+    if (i == 2)
+      opts.seed = 43;
+    cluster c(opts);
+    c.wait_for_leader(10 * SEC);
+    report r = c.run_workload(2 * SEC, 3, 32);
+    out[i] = r.to_string() + " " + std::to_string(c.leader()->get_id()) +
+             " " + std::to_string(c.events().now());
+  }
+  EXPECT_EQ(out[0], out[1]);
+  EXPECT_NE(out[0], out[2]);
+}
+
+// Random crashes, partitions and message loss over many seeds; Raft must
+// never lose or change a committed entry.
+TEST(sim_test, safety_fuzz) {
+  for (uint64_t seed = 1; seed <= 20; ++seed) {
+    cluster_options opts;
+    opts.servers = 5;
+    opts.seed = seed;
+    opts.net.drop_rate = 0.05;
+    opts.net.reorder_rate = 0.1;
+    cluster c(opts);
+    utils::rand::xoshiro256 chaos(seed);
+    for (int round = 0; round < 10; ++round) {
+      switch (chaos.bounded(4)) {
+      case 0:
+        c.crash(chaos.bounded(c.size()));
+        break;
+      case 1:
+        for (size_t i = 0; i < c.size(); ++i)
+          if (!c.server(i).is_up())
+            c.restart(i);
+        break;
+      case 2:
+        c.net().partition({{1 + chaos.bounded(5), 1 + chaos.bounded(5)}});
+        break;
+      default:
+        c.net().heal();
+        break;
+      }
+      c.run_workload(200 * MS + chaos.bounded(500 * MS), 3, 16);
+      ASSERT_EQ("", c.check_safety()) << "seed " << seed;
+    }
+    for (size_t i = 0; i < c.size(); ++i)
+      if (!c.server(i).is_up())
+        c.restart(i);
+    c.net().heal();
+    ASSERT_TRUE(c.wait_for_leader(10 * SEC)) << "seed " << seed;
+    EXPECT_GT(c.run_workload(SEC, 1, 16).committed, 0U) << "seed " << seed;
+    EXPECT_EQ("", c.check_safety()) << "seed " << seed;
+  }
+}
+
+} // namespace sim
+} // namespace ors
@@ -0,0 +1,174 @@
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <server_stats.pb.h>
+#include <storage/snapshot_file.h>
+#include <unistd.h>
+
+namespace ors {
+namespace storage {
+namespace snapshot_file {
+
+static const char *path = "/tmp/ors_snapshot_file_test";
+
+class snapshot_file_test : public ::testing::Test {
+public:
+  snapshot_file_test() { unlink(path); }
+  ~snapshot_file_test() { unlink(path); }
+
+  static proto::ServerStats make(uint64_t i) {
+    proto::ServerStats m;
+    m.set_server_id(i);
+    m.set_addresses("127.0.0.1:5254,127.0.0.1:5255");
+    return m;
+  }
+};
+
+TEST_F(snapshot_file_test, empty) {
+  { writer w(path); }
+  reader r(path);
+  EXPECT_EQ(0U, r.num_blocks());
+  proto::ServerStats m;
+  EXPECT_NE("", r.readMessage(m));
+}
+
+TEST_F(snapshot_file_test, roundtrip) {
+  uint64_t file_bytes;
+  size_t logical;
+  {
+    writer w(path, 4096);
+    for (uint64_t i = 0; i < 1000; ++i)
+      w.write_message(make(i));
+    w.write_raw("tail", 4);
+    w.close();
+    file_bytes = w.file_bytes();
+    logical = w.get_bytes_writen();
+    EXPECT_LT(1U, w.blocks().size());
+  }
+  // repetitive messages compress well
+  EXPECT_LT(file_bytes * 3, logical);
+
+  reader r(path);
+  EXPECT_EQ(logical, r.raw_bytes());
+  for (uint64_t i = 0; i < 1000; ++i) {
+    proto::ServerStats m;
+    ASSERT_EQ("", r.readMessage(m));
+    EXPECT_EQ(i, m.server_id());
+  }
+  char tail[8];
+  EXPECT_EQ(4U, r.readRaw(tail, sizeof(tail)));
+  EXPECT_EQ("tail", std::string(tail, 4));
+  EXPECT_EQ(logical, r.get_bytes_read());
+}
+
+TEST_F(snapshot_file_test, blocks_are_independent) {
+  {
+    writer w(path, 256);
+    for (uint64_t i = 0; i < 100; ++i)
+      w.write_message(make(i));
+  }
+  reader r(path);
+  uint64_t expected = 0;
+  for (size_t b = r.num_blocks(); b > 0; --b) {
+    std::string raw = r.decode_block(b - 1);
+    EXPECT_EQ(r.blocks().at(b - 1).raw_length, raw.size());
+  }
+  // every block starts at a message boundary
+  for (size_t b = 0; b < r.num_blocks(); ++b) {
+    std::string raw = r.decode_block(b);
+    size_t off = 0;
+    while (off < raw.size()) {
+      uint32_t len = uint8_t(raw[off]) | uint8_t(raw[off + 1]) << 8;
+      proto::ServerStats m;
+      ASSERT_TRUE(m.ParseFromArray(raw.data() + off + 4, int(len)));
+      EXPECT_EQ(expected++, m.server_id());
+      off += 4 + len;
+    }
+  }
+  EXPECT_EQ(100U, expected);
+}
+
+TEST_F(snapshot_file_test, uncompressed) {
+  {
+    writer w(path, 4096, 0);
+    w.write_message(make(7));
+    w.flush_block();
+    EXPECT_EQ(NONE, w.blocks().at(0).type);
+  }
+  reader r(path);
+  proto::ServerStats m;
+  EXPECT_EQ("", r.readMessage(m));
+  EXPECT_EQ(7U, m.server_id());
+}
+
+TEST_F(snapshot_file_test, zero_block_size) {
+  EXPECT_THROW(writer w(path, 0), exception);
+  {
+    writer w(path, 4096);
+    w.write_message(make(1));
+  }
+  // the header's block size follows the magic and the version
+  int fd = open(path, O_WRONLY);
+  ASSERT_LE(0, fd);
+  char zero[4] = {};
+  ASSERT_EQ(4, pwrite(fd, zero, sizeof(zero), 12));
+  close(fd);
+  EXPECT_THROW(reader r(path), exception);
+}
+
+TEST_F(snapshot_file_test, corruption) {
+  {
+    writer w(path, 4096);
+    for (uint64_t i = 0; i < 100; ++i)
+      w.write_message(make(i));
+  }
+  {
+    reader r(path);
+    int fd = open(path, O_WRONLY);
+    ASSERT_LE(0, fd);
+    char junk = 'x';
+    ASSERT_EQ(1, pwrite(fd, &junk, 1, off_t(r.blocks().at(0).offset + 10)));
+    close(fd);
+    EXPECT_THROW(r.decode_block(0), exception);
+  }
+  ASSERT_EQ(0, truncate(path, 20));
+  EXPECT_THROW(reader r(path), exception);
+  EXPECT_THROW(reader r("/tmp/ors_snapshot_file_test_missing"), exception);
+}
+
+TEST_F(snapshot_file_test, for_each_run) {
+  {
+    writer w(path, 256);
+    for (uint64_t i = 0; i < 100; ++i)
+      w.write_message(make(i));
+    // larger than a block: spans several continued blocks
+    proto::ServerStats big = make(100);
+    big.set_addresses(std::string(1000, 'a'));
+    w.write_message(big);
+    for (uint64_t i = 101; i < 200; ++i)
+      w.write_message(make(i));
+  }
+  reader r(path);
+  std::vector<size_t> runs = r.runs();
+  EXPECT_LT(runs.size(), r.num_blocks());
+  std::vector<std::vector<proto::ServerStats>> parts(runs.size());
+  for_each_run(r, 4, [&parts](size_t run, const std::string &raw) {
+    parts.at(run) = parse_messages<proto::ServerStats>(raw);
+  });
+  uint64_t expected = 0;
+  for (auto &part : parts) {
+    for (auto &m : part)
+      EXPECT_EQ(expected++, m.server_id());
+  }
+  EXPECT_EQ(200U, expected);
+
+  EXPECT_THROW(for_each_run(r, 2,
+                            [](size_t run, const std::string & /*raw*/) {
+                              if (run == 3)
+                                throw exception("visit failed");
+                            }),
+               exception);
+}
+
+} // namespace snapshot_file
+} // namespace storage
+} // namespace ors
@@ -0,0 +1,127 @@
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <state_machine/snapshot_fork.h>
+#include <utils/log.h>
+#include <unistd.h>
+#include <vector>
+
+namespace ors {
+namespace state_machine {
+
+static const char *path = "/tmp/ors_snapshot_fork_test";
+
+class snapshot_fork_test : public ::testing::Test {
+public:
+  snapshot_fork_test() : forker() { unlink(path); }
+  ~snapshot_fork_test() { unlink(path); }
+
+  snapshot_fork forker;
+};
+
+TEST_F(snapshot_fork_test, basics) {
+  std::vector<uint64_t> state(1 << 16, 1);
+  ASSERT_TRUE(forker.start([&state]() {
+    std::ofstream out(path);
+    uint64_t sum = 0;
+    for (auto v : state)
+      sum += v;
+    out << sum;
+    return 0;
+  }));
+  EXPECT_LT(0, forker.child_pid());
+  EXPECT_FALSE(forker.start([]() { return 0; }));
+  // the parent keeps mutating its copy while the child serializes
+  for (auto &v : state)
+    v = 2;
+  EXPECT_TRUE(forker.wait());
+  EXPECT_FALSE(forker.in_progress());
+
+  std::ifstream in(path);
+  uint64_t sum = 0;
+  in >> sum;
+  EXPECT_EQ(uint64_t(1 << 16), sum);
+
+  proto::ServerStats::StateMachine stats;
+  forker.update_server_stats(stats);
+  EXPECT_FALSE(stats.snapshotting());
+  EXPECT_EQ(1U, stats.num_snapshots_attempted());
+  EXPECT_EQ(0U, stats.num_snapshots_failed());
+  EXPECT_LT(0U, stats.snapshot_fork_nanos());
+}
+
+TEST_F(snapshot_fork_test, cow_bytes) {
+  constexpr size_t BYTES = 16 << 20;
+  std::vector<char> state(BYTES, 'a');
+  int go[2];
+  ASSERT_EQ(0, pipe(go));
+  ASSERT_TRUE(forker.start([&go]() {
+    // finish only once the parent has rewritten its state
+    char c;
+    return read(go[0], &c, 1) == 1 ? 0 : 1;
+  }));
+  for (size_t i = 0; i < BYTES; i += 4096)
+    state[i] = 'b';
+  ASSERT_EQ(1, write(go[1], "x", 1));
+  EXPECT_TRUE(forker.wait());
+  close(go[0]);
+  close(go[1]);
+
+  proto::ServerStats::StateMachine stats;
+  forker.update_server_stats(stats);
+  if (access("/proc/self/smaps_rollup", R_OK) != 0)
+    GTEST_SKIP() << "no smaps_rollup";
+  // every page the parent wrote was copied, leaving the child's private
+  EXPECT_LE(uint64_t(BYTES), stats.snapshot_cow_bytes());
+  EXPECT_GT(uint64_t(BYTES) * 2, stats.snapshot_cow_bytes());
+  // and the child itself faulted in far less
+  EXPECT_GT(uint64_t(BYTES) / 2, stats.snapshot_child_fault_bytes());
+}
+
+TEST_F(snapshot_fork_test, child_logs) {
+  std::string log_path = std::string(path) + ".log";
+  unlink(log_path.c_str());
+  utils::log::set_filename(log_path);
+  ASSERT_TRUE(forker.start([]() {
+    ORS_NOTICE("snapshot child {} logging", getpid());
+    return 0;
+  }));
+  pid_t child = forker.child_pid();
+  EXPECT_TRUE(forker.wait());
+  utils::log::set_filename("");
+  std::ifstream in(log_path);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  EXPECT_NE(std::string::npos,
+            ss.str().find("snapshot child " + std::to_string(child) +
+                          " logging"));
+  unlink(log_path.c_str());
+}
+
+TEST_F(snapshot_fork_test, failure) {
+  ASSERT_TRUE(forker.start([]() { return 3; }));
+  EXPECT_FALSE(forker.wait());
+  proto::ServerStats::StateMachine stats;
+  forker.update_server_stats(stats);
+  EXPECT_EQ(1U, stats.num_snapshots_failed());
+}
+
+TEST_F(snapshot_fork_test, stop) {
+  ASSERT_TRUE(forker.start([]() {
+    sleep(60);
+    return 0;
+  }));
+  EXPECT_TRUE(forker.in_progress());
+  forker.stop();
+  EXPECT_FALSE(forker.in_progress());
+  EXPECT_EQ(0, forker.child_pid());
+  proto::ServerStats::StateMachine stats;
+  forker.update_server_stats(stats);
+  EXPECT_EQ(1U, stats.num_snapshots_failed());
+  // a new snapshot may start once the old one is gone
+  ASSERT_TRUE(forker.start([]() { return 0; }));
+  EXPECT_TRUE(forker.wait());
+}
+
+} // namespace state_machine
+} // namespace ors
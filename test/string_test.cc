@@ -0,0 +1,188 @@
+#include <cstring>
+#include <gtest/gtest.h>
+#include <limits>
+#include <thread>
+
+#include <utils/common.h>
+
+namespace ors {
+namespace utils {
+namespace string {
+
+namespace {
+std::vector<std::string> pieces(std::string_view s, char delimiter) {
+  std::vector<std::string> out;
+  for (std::string_view part : split_view(s, delimiter))
+    out.emplace_back(part);
+  return out;
+}
+} // namespace
+
+TEST(string_test, split) {
+  using v = std::vector<std::string>;
+  EXPECT_EQ(v(), split("", ','));
+  EXPECT_EQ(v({"a"}), split("a", ','));
+  EXPECT_EQ(v({"a", "b"}), split("a,b", ','));
+  EXPECT_EQ(v({"a", "b"}), split("a,b,", ','));
+  EXPECT_EQ(v({"", "a", "", "b"}), split(",a,,b", ','));
+  EXPECT_EQ(v({""}), split(",", ','));
+  EXPECT_EQ(v({"", ""}), split(",,", ','));
+}
+
+TEST(string_test, split_view) {
+  for (const char *s : {"", "a", "a,b", "a,b,", ",a,,b", ",", ",,", "/x/y/"})
+    EXPECT_EQ(split(s, ','), pieces(s, ',')) << s;
+
+  std::string path = "/tree/dir/file";
+  split_view parts(path, '/');
+  auto it = parts.begin();
+  EXPECT_EQ("", *it);
+  EXPECT_EQ(path.data(), it->data()); // a view, not a copy
+  ++it;
+  EXPECT_EQ("tree", *it++);
+  EXPECT_EQ("dir", *it);
+  EXPECT_EQ(path.data() + 6, it->data());
+  EXPECT_NE(parts.end(), it);
+  EXPECT_EQ("file", *++it);
+  EXPECT_EQ(parts.end(), ++it);
+  EXPECT_EQ(4, std::distance(parts.begin(), parts.end()));
+}
+
+TEST(string_test, trim) {
+  EXPECT_EQ("", trim(""));
+  EXPECT_EQ("", trim(" \t\n "));
+  EXPECT_EQ("a b", trim("  a b \n"));
+  std::string s = "\tkey = value  ";
+  std::string_view t = trim_view(s);
+  EXPECT_EQ("key = value", t);
+  EXPECT_EQ(s.data() + 1, t.data());
+  // bytes above 127 are not whitespace, whatever the sign of char
+  EXPECT_EQ("\xa0x\xa0", trim_view(" \xa0x\xa0 "));
+}
+
+TEST(string_test, starts_ends_with) {
+  EXPECT_TRUE(starts_with("/tree/a", "/tree"));
+  EXPECT_TRUE(starts_with("abc", ""));
+  EXPECT_FALSE(starts_with("ab", "abc"));
+  EXPECT_FALSE(starts_with("/tre", "/tree"));
+  EXPECT_TRUE(ends_with("file.txt", ".txt"));
+  EXPECT_TRUE(ends_with("abc", ""));
+  EXPECT_FALSE(ends_with("txt", ".txt"));
+  EXPECT_TRUE(starts_with(std::string("xy"), std::string_view("x")));
+}
+
+TEST(string_test, join) {
+  EXPECT_EQ("", join({}, ","));
+  EXPECT_EQ("a", join({"a"}, ", "));
+  EXPECT_EQ("a, b, c", join({"a", "b", "c"}, ", "));
+}
+
+TEST(string_test, fmt) {
+  EXPECT_EQ("", fmt("%s", ""));
+  EXPECT_EQ("x 42 y", fmt("x %d %s", 42, "y"));
+  std::string big(5000, 'b');
+  EXPECT_EQ(big + "!", fmt("%s!", big.c_str()));
+  // the thread's buffer shrinks back, and short results still come out right
+  EXPECT_EQ("short", fmt("%s", "short"));
+  std::string huge(100000, 'h');
+  EXPECT_EQ(huge, fmt("%s", huge.c_str()));
+  EXPECT_EQ("7", fmt("%d", 7));
+}
+
+TEST(string_test, append_fmt) {
+  std::string out = "head:";
+  append_fmt(out, "%d", 1);
+  append_fmt(out, "/%s", "two");
+  EXPECT_EQ("head:1/two", out);
+
+  std::string long_arg(3000, 'z');
+  append_fmt(out, "[%s]", long_arg.c_str());
+  EXPECT_EQ("head:1/two[" + long_arg + "]", out);
+
+  // with room to spare, appending does not reallocate
+  std::string reused;
+  reused.reserve(256);
+  const char *storage = reused.data();
+  for (int i = 0; i < 10; ++i) {
+    reused.clear();
+    append_fmt(reused, "/bench/%010d", i);
+  }
+  EXPECT_EQ("/bench/0000000009", reused);
+  EXPECT_EQ(storage, reused.data());
+}
+
+TEST(string_test, fmt_view) {
+  std::string_view a = fmt_view("%s-%d", "a", 1);
+  EXPECT_EQ("a-1", a);
+  const char *storage = a.data();
+  std::string_view b = fmt_view("%s-%d", "b", 2);
+  EXPECT_EQ("b-2", b);
+  EXPECT_EQ(storage, b.data());
+  // fmt() has its own buffer
+  EXPECT_EQ("c", fmt("c"));
+  EXPECT_EQ("b-2", b);
+
+  std::string other;
+  std::thread([&other] { other = std::string(fmt_view("%d", 99)); }).join();
+  EXPECT_EQ("99", other);
+  EXPECT_EQ("b-2", b);
+
+  std::string long_arg(2000, 'q');
+  EXPECT_EQ(long_arg, fmt_view("%s", long_arg.c_str()));
+}
+
+TEST(string_test, to_string) {
+  EXPECT_EQ("0", to_string(0));
+  EXPECT_EQ("-17", to_string(-17));
+  EXPECT_EQ("18446744073709551615",
+            to_string(std::numeric_limits<uint64_t>::max()));
+  EXPECT_EQ("-9223372036854775808",
+            to_string(std::numeric_limits<int64_t>::min()));
+  EXPECT_EQ("65535", to_string(uint16_t(65535)));
+  // the same as a stream prints them
+  for (double d : {0.0, 0.5, 1.0 / 3, 1e20, -2.5e-7, 123456.0, 1234567.0}) {
+    std::stringstream ss;
+    ss << d;
+    EXPECT_EQ(ss.str(), to_string(d)) << d;
+  }
+  EXPECT_EQ("1", to_string(true));
+  EXPECT_EQ("x", to_string('x'));
+  EXPECT_EQ("abc", to_string(std::string("abc")));
+
+  std::string out = "n=";
+  append_number(out, 12345);
+  append_number(out, ' ' - 32); // an int, not a char
+  EXPECT_EQ("n=123450", out);
+}
+
+TEST(string_test, printable) {
+  EXPECT_TRUE(printable(""));
+  EXPECT_TRUE(printable("hello world ~"));
+  EXPECT_FALSE(printable("tab\there"));
+  EXPECT_FALSE(printable("", 0));
+  EXPECT_FALSE(printable("abc", 3)); // no terminator
+  EXPECT_TRUE(printable("abc", 4));
+
+  // every position and both halves of the vector loop
+  for (size_t length = 1; length < 70; ++length) {
+    std::string s(length - 1, 'a');
+    s.push_back('\0');
+    EXPECT_TRUE(printable(s.data(), s.size())) << length;
+    for (size_t i = 0; i + 1 < length; ++i) {
+      for (char bad : {'\x1f', '\x7f', '\x80', '\xff', '\0'}) {
+        std::string t = s;
+        t[i] = bad;
+        EXPECT_FALSE(printable(t.data(), t.size())) << length << " " << i;
+      }
+      std::string t = s;
+      t[i] = ' ';
+      EXPECT_TRUE(printable(t.data(), t.size()));
+      t[i] = '~';
+      EXPECT_TRUE(printable(t.data(), t.size()));
+    }
+  }
+}
+
+} // namespace string
+} // namespace utils
+} // namespace ors
@@ -0,0 +1,174 @@
+#include <atomic>
+#include <gtest/gtest.h>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <utils/chase_lev_deque.h>
+#include <utils/thread_pool.h>
+#include <utils/tid.h>
+#include <vector>
+
+namespace ors {
+namespace utils {
+
+TEST(chase_lev_deque, owner_lifo_thief_fifo) {
+  chase_lev_deque<intptr_t> d(2);
+  intptr_t v = 0;
+  EXPECT_TRUE(d.empty());
+  EXPECT_FALSE(d.pop(v));
+  EXPECT_FALSE(d.steal(v));
+  // past the initial capacity, to exercise growth
+  for (intptr_t i = 1; i <= 10; ++i)
+    d.push(i);
+  EXPECT_TRUE(d.steal(v));
+  EXPECT_EQ(1, v);
+  EXPECT_TRUE(d.pop(v));
+  EXPECT_EQ(10, v);
+  EXPECT_TRUE(d.steal(v));
+  EXPECT_EQ(2, v);
+  for (intptr_t i = 9; i >= 3; --i) {
+    EXPECT_TRUE(d.pop(v));
+    EXPECT_EQ(i, v);
+  }
+  EXPECT_TRUE(d.empty());
+  EXPECT_FALSE(d.pop(v));
+}
+
+TEST(chase_lev_deque, concurrent_steal_takes_each_once) {
+  constexpr intptr_t N = 100000;
+  chase_lev_deque<intptr_t> d(16);
+  std::atomic<bool> done(false);
+  std::vector<std::vector<intptr_t>> stolen(3);
+  std::vector<std::thread> thieves;
+  for (auto &s : stolen) {
+    thieves.emplace_back([&d, &done, &s] {
+      intptr_t v;
+      while (!done.load() || !d.empty())
+        if (d.steal(v))
+          s.push_back(v);
+    });
+  }
+  std::vector<intptr_t> popped;
+  intptr_t v;
+  for (intptr_t i = 0; i < N; ++i) {
+    d.push(i);
+    if (i % 3 == 0 && d.pop(v))
+      popped.push_back(v);
+  }
+  while (d.pop(v))
+    popped.push_back(v);
+  done = true;
+  for (auto &t : thieves)
+    t.join();
+
+  std::vector<bool> seen(N, false);
+  size_t total = popped.size();
+  for (intptr_t x : popped)
+    seen[x] = true;
+  for (auto &s : stolen) {
+    total += s.size();
+    for (intptr_t x : s) {
+      EXPECT_FALSE(seen[x]) << x;
+      seen[x] = true;
+    }
+  }
+  EXPECT_EQ(size_t(N), total);
+}
+
+TEST(thread_pool, runs_every_task) {
+  thread_pool pool(4, "tp-every");
+  EXPECT_EQ(4U, pool.size());
+  EXPECT_EQ(-1, pool.current_worker());
+  std::atomic<int> count(0);
+  for (int i = 0; i < 1000; ++i)
+    pool.submit([&count] { count++; });
+  pool.wait_idle();
+  EXPECT_EQ(1000, count.load());
+  // the pool is reusable after going idle
+  pool.submit([&count] { count++; });
+  pool.wait_idle();
+  EXPECT_EQ(1001, count.load());
+}
+
+TEST(thread_pool, rounds_from_outside) {
+  // workers park between rounds, so every round races submit() against
+  // the final scan of a parking worker
+  thread_pool pool(2, "tp-rounds");
+  std::atomic<int> count(0);
+  for (int round = 1; round <= 500; ++round) {
+    for (int i = 0; i < 8; ++i)
+      pool.submit([&count] { count++; });
+    pool.wait_idle();
+    ASSERT_EQ(round * 8, count.load());
+  }
+}
+
+TEST(thread_pool, recursive_submit) {
+  thread_pool pool(3, "tp-recursive");
+  std::atomic<int> leaves(0);
+  std::function<void(int)> spawn = [&](int depth) {
+    if (depth == 0) {
+      leaves++;
+      return;
+    }
+    EXPECT_NE(-1, pool.current_worker());
+    pool.submit([&spawn, depth] { spawn(depth - 1); });
+    pool.submit([&spawn, depth] { spawn(depth - 1); });
+  };
+  pool.submit([&spawn] { spawn(10); });
+  pool.wait_idle();
+  EXPECT_EQ(1024, leaves.load());
+}
+
+TEST(thread_pool, async_result_and_exception) {
+  thread_pool pool(2, "tp-async");
+  auto answer = pool.async([] { return 42; });
+  auto failure = pool.async([]() -> int { throw std::runtime_error("no"); });
+  EXPECT_EQ(42, answer.get());
+  EXPECT_THROW(failure.get(), std::runtime_error);
+  // exceptions from submit() are logged and do not kill the worker
+  pool.submit([] { throw std::runtime_error("dropped"); });
+  pool.wait_idle();
+  EXPECT_EQ(7, pool.async([] { return 7; }).get());
+}
+
+TEST(thread_pool, current_worker_and_names) {
+  thread_pool pool(2, "tp-names");
+  std::mutex m;
+  std::set<int> indexes;
+  std::set<std::string> names;
+  for (int i = 0; i < 200; ++i) {
+    pool.submit([&] {
+      std::lock_guard<std::mutex> lg(m);
+      indexes.insert(pool.current_worker());
+      names.insert(tid::name());
+      // keep both workers busy long enough that each gets some tasks
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    });
+  }
+  pool.wait_idle();
+  for (int i : indexes) {
+    EXPECT_LE(0, i);
+    EXPECT_GT(2, i);
+  }
+  for (auto &n : names)
+    EXPECT_TRUE(n == "tp-names-0" || n == "tp-names-1") << n;
+}
+
+TEST(thread_pool, destructor_drains) {
+  std::atomic<int> count(0);
+  {
+    thread_pool pool(2, "tp-drain");
+    for (int i = 0; i < 100; ++i) {
+      pool.submit([&pool, &count] {
+        std::this_thread::sleep_for(std::chrono::microseconds(10));
+        pool.submit([&count] { count++; });
+        count++;
+      });
+    }
+  }
+  EXPECT_EQ(200, count.load());
+}
+
+} // namespace utils
+} // namespace ors
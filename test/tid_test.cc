@@ -1,7 +1,10 @@
+#include <condition_variable>
+#include <pthread.h>
+#include <set>
 #include <string>
 #include <thread>
 #include <unordered_map>
-#include <unordered_set>
+#include <vector>
 #include <mutex>
 #include <utils/tid.h>
 #include <gtest/gtest.h>
@@ -11,11 +14,7 @@ using namespace ors::utils;
 namespace ors {
 namespace utils {
 namespace tid {
-extern __thread uint64_t _tid;
 extern std::atomic<uint64_t> _nextid;
-
-extern std::map<uint64_t, std::string> _tid_name_map;
-extern std::unordered_set<std::string> _tid_name_set;
 } // namespace tid
 } // namespace utils
 } // namespace ors
@@ -25,8 +24,6 @@ public:
   core_tid_test() {
     tid::_tid = 0;
     tid::_nextid = 1;
-    tid::_tid_name_map.clear();
-    tid::_tid_name_set.clear();
   }
 };
 
@@ -54,4 +51,120 @@ TEST_F(core_tid_test, names) {
   EXPECT_EQ("bar", tid::name());
   tid::set_name("");
   EXPECT_EQ("Thread 1", tid::name());
-}
\ No newline at end of file
+}
+TEST_F(core_tid_test, name_is_thread_local) {
+  tid::set_name("main");
+  std::string other;
+  std::thread t([&other] { other = tid::name(); });
+  t.join();
+  EXPECT_EQ("Thread 2", other);
+  EXPECT_STREQ("main", tid::c_name());
+}
+
+TEST_F(core_tid_test, kernel_name) {
+  tid::set_name("a-rather-long-thread-name");
+  EXPECT_EQ("a-rather-long-thread-name", tid::name());
+  char comm[16];
+  ASSERT_EQ(0, pthread_getname_np(pthread_self(), comm, sizeof(comm)));
+  EXPECT_STREQ("a-rather-long-t", comm);
+}
+
+TEST_F(core_tid_test, live_names_are_unique) {
+  tid::set_name("taken");
+  std::string other;
+  std::thread t([&other] {
+    tid::set_name("taken");
+    other = tid::name();
+  });
+  t.join();
+  EXPECT_EQ("Thread 2", other);
+  // names of exited threads are free again
+  std::thread t2([&other] {
+    tid::set_name("free");
+    other = tid::name();
+  });
+  t2.join();
+  tid::set_name("free");
+  EXPECT_EQ("free", tid::name());
+}
+
+TEST_F(core_tid_test, racing_names_are_unique) {
+  for (int round = 0; round < 50; ++round) {
+    std::string wanted = "race-" + std::to_string(round);
+    std::mutex m;
+    std::condition_variable cv;
+    bool go = false;
+    int done = 0;
+    int winners = 0;
+    std::vector<std::thread> racers;
+    for (int i = 0; i < 4; ++i) {
+      racers.emplace_back([&] {
+        {
+          std::unique_lock<std::mutex> ul(m);
+          cv.wait(ul, [&] { return go; });
+        }
+        tid::set_name(wanted);
+        std::unique_lock<std::mutex> ul(m);
+        if (tid::name() == wanted)
+          ++winners;
+        // stay alive, and so keep the name, until everyone has tried
+        ++done;
+        cv.notify_all();
+        cv.wait(ul, [&] { return done == 4; });
+      });
+    }
+    {
+      std::lock_guard<std::mutex> lg(m);
+      go = true;
+    }
+    cv.notify_all();
+    for (auto &t : racers)
+      t.join();
+    EXPECT_EQ(1, winners) << wanted;
+  }
+}
+
+TEST_F(core_tid_test, registry) {
+  tid::set_name("registry-main");
+  std::mutex m;
+  std::condition_variable cv;
+  int ready = 0;
+  bool stop = false;
+  std::vector<std::thread> workers;
+  for (int i = 0; i < 4; ++i) {
+    workers.emplace_back([&, i] {
+      tid::set_name("registry-" + std::to_string(i));
+      std::unique_lock<std::mutex> ul(m);
+      ++ready;
+      cv.notify_all();
+      cv.wait(ul, [&] { return stop; });
+    });
+  }
+  {
+    std::unique_lock<std::mutex> ul(m);
+    cv.wait(ul, [&] { return ready == 4; });
+  }
+  // ids are not unique across fixtures, which reset the counter
+  std::multiset<std::string> names;
+  for (auto &t : tid::threads()) {
+    names.insert(t.name);
+    if (t.name == "registry-main") {
+      EXPECT_EQ(tid::tid(), t.tid);
+    }
+  }
+  EXPECT_EQ(1U, names.count("registry-main"));
+  for (int i = 0; i < 4; ++i)
+    EXPECT_EQ(1U, names.count("registry-" + std::to_string(i)));
+  {
+    std::lock_guard<std::mutex> lg(m);
+    stop = true;
+  }
+  cv.notify_all();
+  for (auto &w : workers)
+    w.join();
+
+  // exited threads leave the registry
+  for (auto &t : tid::threads())
+    EXPECT_TRUE(t.name.find("registry-") != 0 || t.name == "registry-main")
+        << t.name;
+}
@@ -1,7 +1,10 @@
 #include <gtest/gtest.h>
 #include <iostream>
+#include <thread>
+#include <vector>
 // #include <spdlog/spdlog.h>
 #include <stdexcept>
+#include <unistd.h>
 #include <utils/common.h>
 #include <utils/time.h>
 namespace ors {
@@ -249,6 +252,146 @@ TEST(time, converter_nanos) {
                           std::chrono::hours(1)));
 }
 
+TEST(time, tsc_clock_tracks_monotonic) {
+  EXPECT_LT(0.0, time::tsc_clock::ticks_per_nano());
+  for (int i = 0; i < 3; ++i) {
+    int64_t before = time::monotonic_nanos();
+    int64_t tsc = time::tsc_clock::now().time_since_epoch().count();
+    int64_t after = time::monotonic_nanos();
+    // generous: a VM may be descheduled between the reads
+    EXPECT_LT(before - 1000 * 1000, tsc);
+    EXPECT_GT(after + 1000 * 1000, tsc);
+    usleep(20 * 1000); // past a recalibration
+  }
+}
+
+TEST(time, tsc_clock_monotonic) {
+  auto last = time::tsc_clock::now();
+  for (int i = 0; i < 1000000; ++i) {
+    auto now = time::tsc_clock::now();
+    ASSERT_LE(last, now);
+    last = now;
+  }
+}
+
+TEST(time, tsc_clock_nanos_of_old_readings) {
+  uint64_t a = time::rdtsc();
+  int64_t at = time::monotonic_nanos();
+  usleep(30 * 1000);
+  uint64_t b = time::rdtsc();
+  int64_t span = time::tsc_clock::nanos(b) - time::tsc_clock::nanos(a);
+  EXPECT_NEAR(30.0, double(span) / 1e6, 10.0);
+  EXPECT_NEAR(double(at), double(time::tsc_clock::nanos(a)), 1e6);
+  EXPECT_NEAR(double(span), double(time::tsc_clock::to_nanos(b - a)),
+              double(span) / 100);
+}
+
+TEST(time, tsc_clock_fallback) {
+  bool was = time::tsc_clock::enabled();
+  time::tsc_clock::set_enabled(false);
+  EXPECT_FALSE(time::tsc_clock::enabled());
+  int64_t before = time::monotonic_nanos();
+  int64_t now = time::tsc_clock::now().time_since_epoch().count();
+  EXPECT_LE(before, now);
+  time::tsc_clock::set_enabled(was);
+}
+
+TEST(time, tsc_clock_mixes_with_steady_clock) {
+  time::steady_converter conv;
+  time::tsc_clock::time_point tp = time::tsc_clock::now();
+  time::steady_clock::time_point deadline =
+      time::steady_clock::now() + std::chrono::seconds(1);
+  EXPECT_LT(tp, deadline);
+  EXPECT_NEAR(double(conv.nanos(tp)),
+              double(conv.nanos(time::steady_clock::now())), 1e6);
+}
+
+TEST(time, coarse_clock_cached) {
+  time::coarse_clock::set_source(time::coarse_clock::source::CACHED);
+  time::coarse_clock::time_point a = time::coarse_clock::update();
+  usleep(2000);
+  EXPECT_EQ(a, time::coarse_clock::now());
+  time::coarse_clock::time_point b = time::coarse_clock::update();
+  EXPECT_LE(a + std::chrono::milliseconds(2), b);
+  EXPECT_EQ(b, time::coarse_clock::now());
+  EXPECT_GE(time::steady_clock::now(), b);
+  time::coarse_clock::set_source(time::coarse_clock::source::KERNEL);
+}
+
+TEST(time, coarse_clock_kernel) {
+  // the default: nothing in the tree calls update() yet
+  ASSERT_EQ(time::coarse_clock::source::KERNEL,
+            time::coarse_clock::get_source());
+  auto coarse = time::coarse_clock::now();
+  auto precise = time::steady_clock::now();
+  EXPECT_LE(coarse, precise);
+  // a tick or so behind; tickless kernels can lag by more than the
+  // resolution clock_getres() reports
+  EXPECT_GT(coarse + std::chrono::milliseconds(20), precise);
+  usleep(20000);
+  EXPECT_LT(coarse, time::coarse_clock::now());
+}
+
+TEST(time, coarse_clock_mocked) {
+  time::coarse_clock::set_source(time::coarse_clock::source::CACHED);
+  time::coarse_clock::time_point before = time::coarse_clock::update();
+  {
+    time::steady_clock::mocker m(time::steady_clock::time_point() +
+                                 std::chrono::seconds(5));
+    EXPECT_EQ(time::steady_clock::time_point() + std::chrono::seconds(5),
+              time::coarse_clock::now());
+    EXPECT_EQ(time::steady_clock::time_point() + std::chrono::seconds(5),
+              time::coarse_clock::update());
+  }
+  // the mock value did not leak into the cache
+  EXPECT_LE(before, time::coarse_clock::now());
+  EXPECT_LT(time::steady_clock::time_point() + std::chrono::seconds(5),
+            time::coarse_clock::now());
+  time::coarse_clock::set_source(time::coarse_clock::source::KERNEL);
+}
+
+TEST(time, mocked_sleep_follows_mocked_time) {
+  time::steady_clock::mocker mock(time::steady_clock::time_point() +
+                                  std::chrono::hours(2));
+  std::atomic<bool> woke(false);
+  std::thread sleeper([&woke] {
+    time::sleep(std::chrono::hours(1));
+    woke = true;
+  });
+  usleep(10 * 1000);
+  EXPECT_FALSE(woke.load());
+  time::steady_clock::set(time::steady_clock::time_point() +
+                          std::chrono::hours(3));
+  sleeper.join();
+  EXPECT_TRUE(woke.load());
+}
+
+TEST(time, mocked_clock_concurrent_advance) {
+  time::steady_clock::mocker mock{time::steady_clock::time_point()};
+  std::atomic<bool> stop(false);
+  std::thread reader([&stop] {
+    auto last = time::steady_clock::now();
+    while (!stop) {
+      auto now = time::steady_clock::now();
+      ASSERT_LE(last, now);
+      last = now;
+    }
+  });
+  std::vector<std::thread> writers;
+  for (int i = 0; i < 2; ++i) {
+    writers.emplace_back([] {
+      for (int j = 0; j < 10000; ++j)
+        time::steady_clock::advance(std::chrono::microseconds(1));
+    });
+  }
+  for (auto &w : writers)
+    w.join();
+  stop = true;
+  reader.join();
+  EXPECT_EQ(time::steady_clock::time_point() + std::chrono::milliseconds(20),
+            time::steady_clock::now());
+}
+
 TEST(time, pad_fraction) {
   EXPECT_EQ("5 s", to_string(nanoseconds(5000000000)));
   EXPECT_EQ("-5 s", to_string(nanoseconds(-5000000000)));
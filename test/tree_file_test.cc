@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+#include <tree/file.h>
+
+namespace ors {
+namespace tree {
+
+TEST(tree_file, digest) {
+  file f;
+  EXPECT_EQ(0U, f.digest().length);
+  EXPECT_EQ(digest::of(""), f.digest());
+  f.write("hello");
+  EXPECT_EQ("hello", f.contents());
+  EXPECT_EQ(5U, f.digest().length);
+  EXPECT_EQ(digest::of("hello"), f.digest());
+  EXPECT_NE(digest::of("hellp"), f.digest());
+}
+
+TEST(tree_file, check_condition) {
+  condition_stats stats;
+  file f("value");
+  EXPECT_TRUE(check_condition(&f, "value", stats));
+  EXPECT_FALSE(check_condition(&f, "longer value", stats));
+  EXPECT_FALSE(check_condition(&f, "valuf", stats));
+  EXPECT_TRUE(check_condition(nullptr, "", stats));
+  EXPECT_FALSE(check_condition(nullptr, "value", stats));
+
+  // a stale digest from the caller is caught by the full compare
+  EXPECT_FALSE(check_condition(&f, "valuf", digest::of("value"), stats));
+
+  EXPECT_EQ(6U, stats.num_checked);
+  EXPECT_EQ(4U, stats.num_failed);
+  EXPECT_EQ(1U, stats.num_length_rejected);
+  EXPECT_EQ(1U, stats.num_hash_rejected);
+  EXPECT_EQ(2U, stats.num_full_compares);
+
+  proto::ServerStats::Tree tree_stats;
+  stats.update_server_stats(tree_stats);
+  EXPECT_EQ(6U, tree_stats.num_conditions_checked());
+  EXPECT_EQ(4U, tree_stats.num_conditions_failed());
+  EXPECT_EQ(2U, tree_stats.num_conditions_full_compares());
+}
+
+} // namespace tree
+} // namespace ors
@@ -2,9 +2,9 @@
 set_group("test")
 set_default(true)
 
-add_requires("gflags", "glog","gtest","spdlog","protobuf")
+add_requires("gflags", "glog","gtest","spdlog","protobuf","zlib")
 -- add_packages("protobuf", {public = true})
-add_packages("gflags", "glog", "gtest","spdlog","protobuf")
+add_packages("gflags", "glog", "gtest","spdlog","protobuf","zlib")
 add_links("gtest_main")
 add_syslinks("pthread")
 
@@ -12,6 +12,13 @@ if not is_plat("macosx") then
     add_ldflags("-lrt")
 end
 add_files("../src/utils/*.cc")
+add_files("../src/state_machine/*.cc")
+add_files("../src/storage/*.cc")
+add_files("../src/tree/*.cc")
+add_files("../src/sim/*.cc")
+add_files("../proto/server_stats.proto", {rules = "protobuf.cpp", proto_rootdir = "../proto"})
+add_files("../proto/client.proto", {rules = "protobuf.cpp", proto_rootdir = "../proto"})
+add_files("../proto/raft.proto", {rules = "protobuf.cpp", proto_rootdir = "../proto"})
 add_includedirs("../include")
 
 function all_tests()
@@ -49,5 +56,5 @@ target("all-test")
     set_kind("binary")
     -- add_rules("protobuf.cpp")
     -- add_files("*.proto", {proto_rootdir = "./"})
-    add_files("*.cc","../src/utils/*.cc")
+    add_files("*.cc","../src/utils/*.cc","../src/state_machine/*.cc","../src/storage/*.cc","../src/tree/*.cc")
     add_includedirs("../include")
\ No newline at end of file
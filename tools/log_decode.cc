@@ -0,0 +1,32 @@
+#include <fstream>
+#include <iostream>
+
+#include <utils/log.h>
+
+/**
+ * Render a binary log (see utils::log::encoding::BINARY) as text.
+ *
+ * Usage: log_decode [FILE]   reads stdin without FILE.
+ */
+int main(int argc, char *argv[]) {
+  if (argc > 2) {
+    std::cerr << "usage: " << argv[0] << " [FILE]" << std::endl;
+    return 2;
+  }
+  std::ifstream file;
+  if (argc == 2) {
+    file.open(argv[1], std::ios::binary);
+    if (!file) {
+      std::cerr << "could not open " << argv[1] << std::endl;
+      return 1;
+    }
+  }
+  std::string error =
+      ors::utils::log::decode(argc == 2 ? file : std::cin, std::cout);
+  std::cout.flush();
+  if (!error.empty()) {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,14 @@
+-- xmake -g tools 构建离线工具
+set_group("tools")
+set_default(false)
+
+add_requires("spdlog","protobuf")
+add_packages("spdlog","protobuf")
+add_syslinks("pthread")
+add_includedirs("../include")
+
+target("log_decode")
+    set_kind("binary")
+    add_files("log_decode.cc")
+    add_files("../src/utils/*.cc")
+    add_files("../proto/server_stats.proto", {rules = "protobuf.cpp", proto_rootdir = "../proto"})
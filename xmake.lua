@@ -4,7 +4,7 @@ add_rules("mode.debug", "mode.release")
 
 set_languages("c++17")
 -- add_includedirs("/usr/include", "/usr/local/include")
-includes("src", "test")
+includes("src", "test", "bench", "tools")
 
 
 --